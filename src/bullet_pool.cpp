@@ -0,0 +1,138 @@
+#include <cstring>
+
+#include "bullet_pool.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define MX_BULLET_POOL_SSE
+#include <xmmintrin.h>
+#endif
+
+template<class T>
+static void GrowArray( T*& data, unsigned int count, unsigned int new_capacity )
+{
+	T* new_data= new T[ new_capacity ];
+	if( count > 0 )
+		std::memcpy( new_data, data, sizeof(T) * count );
+	delete[] data;
+	data= new_data;
+}
+
+mx_BulletPool::mx_BulletPool()
+	: count_(0), capacity_(0)
+	, positions_(NULL), speeds_(NULL), birth_times_(NULL)
+	, types_(NULL), owners_(NULL), killed_(NULL)
+{
+}
+
+mx_BulletPool::~mx_BulletPool()
+{
+	delete[] positions_;
+	delete[] speeds_;
+	delete[] birth_times_;
+	delete[] types_;
+	delete[] owners_;
+	delete[] killed_;
+}
+
+void mx_BulletPool::Add( BulletType type, mx_Pawn* owner, const float* pos, const float* speed, float birth_time )
+{
+	if( count_ == capacity_ )
+		Grow();
+
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		positions_[ count_ * 3 + j ]= pos[j];
+		speeds_[ count_ * 3 + j ]= speed[j];
+	}
+	birth_times_[ count_ ]= birth_time;
+	types_[ count_ ]= (unsigned char) type;
+	owners_[ count_ ]= owner;
+	killed_[ count_ ]= 0;
+	count_++;
+}
+
+void mx_BulletPool::GetInterpolatedPos( unsigned int index, float dt, float k, float* out_pos ) const
+{
+	// Bullets move linearly, so previous position is known.
+	float back_time= dt * ( 1.0f - k );
+	for( unsigned int j= 0; j < 3; j++ )
+		out_pos[j]= positions_[ index * 3 + j ] - speeds_[ index * 3 + j ] * back_time;
+}
+
+void mx_BulletPool::KillOld( float min_birth_time )
+{
+	unsigned int i= 0;
+#ifdef MX_BULLET_POOL_SSE
+	__m128 min_birth_time4= _mm_set1_ps( min_birth_time );
+	for( ; i + 4 <= count_; i+= 4 )
+	{
+		int old= _mm_movemask_ps( _mm_cmplt_ps( _mm_loadu_ps( birth_times_ + i ), min_birth_time4 ) );
+		if( old == 0 )
+			continue;
+
+		for( unsigned int k= 0; k < 4; k++ )
+			if( ( old & ( 1 << k ) ) != 0 )
+				killed_[ i + k ]= 1;
+	}
+#endif
+	for( ; i < count_; i++ )
+		if( birth_times_[i] < min_birth_time )
+			killed_[i]= 1;
+}
+
+void mx_BulletPool::RemoveKilled()
+{
+	for( unsigned int i= 0; i < count_; )
+	{
+		if( killed_[i] == 0 )
+		{
+			i++;
+			continue;
+		}
+
+		count_--;
+		if( i == count_ )
+			break;
+
+		for( unsigned int j= 0; j < 3; j++ )
+		{
+			positions_[ i * 3 + j ]= positions_[ count_ * 3 + j ];
+			speeds_[ i * 3 + j ]= speeds_[ count_ * 3 + j ];
+		}
+		birth_times_[i]= birth_times_[ count_ ];
+		types_[i]= types_[ count_ ];
+		owners_[i]= owners_[ count_ ];
+		killed_[i]= killed_[ count_ ];
+	}
+}
+
+void mx_BulletPool::Move( float dt )
+{
+	unsigned int float_count= count_ * 3;
+	unsigned int i= 0;
+#ifdef MX_BULLET_POOL_SSE
+	__m128 dt4= _mm_set1_ps( dt );
+	for( ; i + 4 <= float_count; i+= 4 )
+	{
+		__m128 pos= _mm_loadu_ps( positions_ + i );
+		__m128 speed= _mm_loadu_ps( speeds_ + i );
+		_mm_storeu_ps( positions_ + i, _mm_add_ps( pos, _mm_mul_ps( speed, dt4 ) ) );
+	}
+#endif
+	for( ; i < float_count; i++ )
+		positions_[i]+= speeds_[i] * dt;
+}
+
+void mx_BulletPool::Grow()
+{
+	unsigned int new_capacity= capacity_ == 0 ? MX_BULLET_POOL_INITIAL_CAPACITY : capacity_ * 2;
+
+	GrowArray( positions_, count_ * 3, new_capacity * 3 );
+	GrowArray( speeds_, count_ * 3, new_capacity * 3 );
+	GrowArray( birth_times_, count_, new_capacity );
+	GrowArray( types_, count_, new_capacity );
+	GrowArray( owners_, count_, new_capacity );
+	GrowArray( killed_, count_, new_capacity );
+
+	capacity_= new_capacity;
+}
\ No newline at end of file
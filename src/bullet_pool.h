@@ -0,0 +1,86 @@
+#pragma once
+#include "fwd.h"
+#include "game_constants.h"
+
+#define MX_BULLET_POOL_INITIAL_CAPACITY 64
+
+// Bullets in structure of arrays layout, for vectorized processing. Storage grows, if needed.
+// Positions and speeds are stored as xyz triples, so moving of all bullets is one vector operation over floats.
+// Bullets are not removed immediately - they are killed, and removed together later. Removal changes order of bullets.
+class mx_BulletPool
+{
+public:
+	mx_BulletPool();
+	~mx_BulletPool();
+
+	void Add( BulletType type, mx_Pawn* owner, const float* pos, const float* speed, float birth_time );
+
+	unsigned int GetCount() const;
+	BulletType GetType( unsigned int index ) const;
+	mx_Pawn* GetOwner( unsigned int index ) const;
+	const float* GetPos( unsigned int index ) const;
+	const float* GetSpeed( unsigned int index ) const;
+	// Position between positions before and after last Move( dt ) call. k - interpolation factor.
+	void GetInterpolatedPos( unsigned int index, float dt, float k, float* out_pos ) const;
+
+	void Kill( unsigned int index );
+	bool IsKilled( unsigned int index ) const;
+	// Kills bullets, born before min_birth_time.
+	void KillOld( float min_birth_time );
+	void RemoveKilled();
+
+	// Moves all bullets by speed * dt.
+	void Move( float dt );
+
+private:
+	mx_BulletPool( const mx_BulletPool& );
+	mx_BulletPool& operator=( const mx_BulletPool& );
+
+	void Grow();
+
+private:
+	unsigned int count_;
+	unsigned int capacity_;
+
+	float* positions_;
+	float* speeds_;
+	float* birth_times_;
+	unsigned char* types_;
+	mx_Pawn** owners_;
+	unsigned char* killed_;
+};
+
+inline unsigned int mx_BulletPool::GetCount() const
+{
+	return count_;
+}
+
+inline BulletType mx_BulletPool::GetType( unsigned int index ) const
+{
+	return BulletType( types_[ index ] );
+}
+
+inline mx_Pawn* mx_BulletPool::GetOwner( unsigned int index ) const
+{
+	return owners_[ index ];
+}
+
+inline const float* mx_BulletPool::GetPos( unsigned int index ) const
+{
+	return positions_ + index * 3;
+}
+
+inline const float* mx_BulletPool::GetSpeed( unsigned int index ) const
+{
+	return speeds_ + index * 3;
+}
+
+inline void mx_BulletPool::Kill( unsigned int index )
+{
+	killed_[ index ]= 1;
+}
+
+inline bool mx_BulletPool::IsKilled( unsigned int index ) const
+{
+	return killed_[ index ] != 0;
+}
\ No newline at end of file
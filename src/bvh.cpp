@@ -0,0 +1,369 @@
+#include <cstring>
+
+#include "mx_assert.h"
+#include "mx_math.h"
+
+#include "bvh.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define MX_BVH_SSE
+#include <xmmintrin.h>
+#endif
+
+// After this depth items are split by count, so depth of tree is always less, than MX_BVH_MAX_DEPTH.
+#define MX_BVH_MAX_SPATIAL_SPLIT_DEPTH 32
+
+struct TraverseStackEntry
+{
+	unsigned int node;
+	float enter_distance;
+};
+
+void mxBVHPrepareBeam( mx_BVHBeam& beam )
+{
+	// Big value instead of infinity, to avoid 0 * inf for beam point on box plane.
+	for( unsigned int j= 0; j < 3; j++ )
+		beam.inv_dir[j]= beam.dir[j] == 0.0f ? 1e30f : 1.0f / beam.dir[j];
+}
+
+unsigned int mxBVHBuildTree(
+	const float* items_bb_min, const float* items_bb_max,
+	unsigned int* items_indices, unsigned int first_item, unsigned int item_count, unsigned int max_leaf_items,
+	unsigned int depth, mx_BVHNode* nodes, unsigned int* in_out_node_count )
+{
+	MX_ASSERT( item_count > 0 );
+	MX_ASSERT( depth < MX_BVH_MAX_DEPTH );
+
+	unsigned int node_index= *in_out_node_count;
+	(*in_out_node_count)++;
+	mx_BVHNode& node= nodes[ node_index ];
+
+	unsigned int* indices= items_indices + first_item;
+
+	// Bounds of node and bounds of items centers.
+	float center_min[3], center_max[3];
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		node.bb_min[j]= center_min[j]= mxInf();
+		node.bb_max[j]= center_max[j]= -mxInf();
+	}
+	for( unsigned int i= 0; i < item_count; i++ )
+	{
+		const float* bb_min= items_bb_min + indices[i] * 3;
+		const float* bb_max= items_bb_max + indices[i] * 3;
+		for( unsigned int j= 0; j < 3; j++ )
+		{
+			float center= ( bb_min[j] + bb_max[j] ) * 0.5f;
+			if( bb_min[j] < node.bb_min[j] ) node.bb_min[j]= bb_min[j];
+			if( bb_max[j] > node.bb_max[j] ) node.bb_max[j]= bb_max[j];
+			if( center < center_min[j] ) center_min[j]= center;
+			if( center > center_max[j] ) center_max[j]= center;
+		}
+	}
+
+	if( item_count <= max_leaf_items )
+	{
+		node.first= first_item;
+		node.count= item_count;
+		return node_index;
+	}
+
+	// Split by middle of longest axis of centers bounds.
+	unsigned int axis= 0;
+	for( unsigned int j= 1; j < 3; j++ )
+		if( center_max[j] - center_min[j] > center_max[axis] - center_min[axis] )
+			axis= j;
+	float split_center= ( center_min[axis] + center_max[axis] ) * 0.5f;
+
+	unsigned int left_count= 0;
+	if( depth < MX_BVH_MAX_SPATIAL_SPLIT_DEPTH )
+	{
+		unsigned int right= item_count;
+		while( left_count < right )
+		{
+			unsigned int index= indices[ left_count ];
+			if( ( items_bb_min[ index * 3 + axis ] + items_bb_max[ index * 3 + axis ] ) * 0.5f < split_center )
+				left_count++;
+			else
+			{
+				right--;
+				indices[ left_count ]= indices[ right ];
+				indices[ right ]= index;
+			}
+		}
+	}
+	// All centers on one side, or tree is too deep - split by count.
+	if( left_count == 0 || left_count == item_count )
+		left_count= item_count / 2;
+
+	mxBVHBuildTree(
+		items_bb_min, items_bb_max,
+		items_indices, first_item, left_count, max_leaf_items,
+		depth + 1, nodes, in_out_node_count );
+
+	node.first= mxBVHBuildTree(
+		items_bb_min, items_bb_max,
+		items_indices, first_item + left_count, item_count - left_count, max_leaf_items,
+		depth + 1, nodes, in_out_node_count );
+	node.count= 0;
+
+	return node_index;
+}
+
+unsigned int mxBVHBuildTrianglesTree(
+	const float* triangles_vertices, unsigned int triangle_count,
+	mx_BVHNode* nodes, unsigned int* in_out_node_count,
+	mx_BVHTrianglePack* packs, unsigned int* in_out_pack_count )
+{
+	float* triangles_bb_min= new float[ triangle_count * 3 ];
+	float* triangles_bb_max= new float[ triangle_count * 3 ];
+	unsigned int* triangles_indices= new unsigned int[ triangle_count ];
+
+	for( unsigned int t= 0; t < triangle_count; t++ )
+	{
+		const float* v= triangles_vertices + t * 9;
+		float* bb_min= triangles_bb_min + t * 3;
+		float* bb_max= triangles_bb_max + t * 3;
+		VEC3_CPY( bb_min, v );
+		VEC3_CPY( bb_max, v );
+		for( unsigned int i= 1; i < 3; i++ )
+		{
+			for( unsigned int j= 0; j < 3; j++ )
+			{
+				if( v[ i * 3 + j ] < bb_min[j] ) bb_min[j]= v[ i * 3 + j ];
+				if( v[ i * 3 + j ] > bb_max[j] ) bb_max[j]= v[ i * 3 + j ];
+			}
+		}
+		triangles_indices[t]= t;
+	}
+
+	unsigned int first_node= *in_out_node_count;
+	unsigned int root= mxBVHBuildTree(
+		triangles_bb_min, triangles_bb_max,
+		triangles_indices, 0, triangle_count, MX_BVH_LEAF_TRIANGLES, 0,
+		nodes, in_out_node_count );
+
+	// Replace triangles ranges in leafs with packs.
+	for( unsigned int n= first_node; n < *in_out_node_count; n++ )
+	{
+		mx_BVHNode& node= nodes[n];
+		if( node.count == 0 )
+			continue;
+
+		mx_BVHTrianglePack& pack= packs[ *in_out_pack_count ];
+		std::memset( &pack, 0, sizeof(mx_BVHTrianglePack) );
+		for( unsigned int i= 0; i < node.count; i++ )
+		{
+			const float* v= triangles_vertices + triangles_indices[ node.first + i ] * 9;
+			for( unsigned int j= 0; j < 3; j++ )
+			{
+				pack.v0[j][i]= v[j];
+				pack.edge1[j][i]= v[ 3 + j ] - v[j];
+				pack.edge2[j][i]= v[ 6 + j ] - v[j];
+			}
+		}
+
+		node.first= *in_out_pack_count;
+		node.count= 1;
+		(*in_out_pack_count)++;
+	}
+
+	delete[] triangles_bb_min;
+	delete[] triangles_bb_max;
+	delete[] triangles_indices;
+
+	return root;
+}
+
+bool mxBVHBeamIntersectBox( const mx_BVHBeam& beam, const float* bb_min, const float* bb_max, float* out_enter_distance )
+{
+	float enter_distance= 0.0f;
+	float exit_distance= beam.max_distance;
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		float t0= ( bb_min[j] - beam.point[j] ) * beam.inv_dir[j];
+		float t1= ( bb_max[j] - beam.point[j] ) * beam.inv_dir[j];
+		if( t0 > t1 )
+		{
+			float tmp= t0; t0= t1; t1= tmp;
+		}
+		if( t0 > enter_distance ) enter_distance= t0;
+		if( t1 < exit_distance ) exit_distance= t1;
+	}
+
+	*out_enter_distance= enter_distance;
+	return enter_distance <= exit_distance;
+}
+
+/*
+---------Beam with triangles pack intersection---------
+Moller-Trumbore algorithm for all triangles of pack together.
+*/
+
+#ifdef MX_BVH_SSE
+
+static inline void Cross4( const __m128* a, const __m128* b, __m128* out )
+{
+	out[0]= _mm_sub_ps( _mm_mul_ps( a[1], b[2] ), _mm_mul_ps( a[2], b[1] ) );
+	out[1]= _mm_sub_ps( _mm_mul_ps( a[2], b[0] ), _mm_mul_ps( a[0], b[2] ) );
+	out[2]= _mm_sub_ps( _mm_mul_ps( a[0], b[1] ), _mm_mul_ps( a[1], b[0] ) );
+}
+
+static inline __m128 Dot4( const __m128* a, const __m128* b )
+{
+	return _mm_add_ps( _mm_add_ps( _mm_mul_ps( a[0], b[0] ), _mm_mul_ps( a[1], b[1] ) ), _mm_mul_ps( a[2], b[2] ) );
+}
+
+#endif
+
+float mxBVHBeamIntersectPack( const mx_BVHBeam& beam, const mx_BVHTrianglePack& pack )
+{
+#ifdef MX_BVH_SSE
+	__m128 edge1[3], edge2[3], dir[3], s[3];
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		edge1[j]= _mm_loadu_ps( pack.edge1[j] );
+		edge2[j]= _mm_loadu_ps( pack.edge2[j] );
+		dir[j]= _mm_set1_ps( beam.dir[j] );
+		s[j]= _mm_sub_ps( _mm_set1_ps( beam.point[j] ), _mm_loadu_ps( pack.v0[j] ) );
+	}
+
+	__m128 p[3], q[3];
+	Cross4( dir, edge2, p );
+	Cross4( s, edge1, q );
+
+	__m128 det= Dot4( edge1, p );
+	__m128 zero= _mm_setzero_ps();
+	__m128 inv_det= _mm_div_ps( _mm_set1_ps( 1.0f ), det );
+	__m128 u= _mm_mul_ps( Dot4( s, p ), inv_det );
+	__m128 v= _mm_mul_ps( Dot4( dir, q ), inv_det );
+	__m128 t= _mm_mul_ps( Dot4( edge2, q ), inv_det );
+
+	// Zero det - beam is parallel to triangle or triangle is unused.
+	__m128 mask= _mm_cmpneq_ps( det, zero );
+	mask= _mm_and_ps( mask, _mm_cmpge_ps( u, zero ) );
+	mask= _mm_and_ps( mask, _mm_cmpge_ps( v, zero ) );
+	mask= _mm_and_ps( mask, _mm_cmple_ps( _mm_add_ps( u, v ), _mm_set1_ps( 1.0f ) ) );
+	mask= _mm_and_ps( mask, _mm_cmpge_ps( t, zero ) );
+	mask= _mm_and_ps( mask, _mm_cmple_ps( t, _mm_set1_ps( beam.max_distance ) ) );
+
+	int hits= _mm_movemask_ps( mask );
+	if( hits == 0 )
+		return mxInf();
+
+	float distances[ MX_BVH_LEAF_TRIANGLES ];
+	_mm_storeu_ps( distances, t );
+	float nearest_distance= mxInf();
+	for( unsigned int i= 0; i < MX_BVH_LEAF_TRIANGLES; i++ )
+		if( ( hits & ( 1 << i ) ) != 0 && distances[i] < nearest_distance )
+			nearest_distance= distances[i];
+	return nearest_distance;
+#else
+	float nearest_distance= mxInf();
+	for( unsigned int i= 0; i < MX_BVH_LEAF_TRIANGLES; i++ )
+	{
+		float edge1[3], edge2[3], s[3];
+		for( unsigned int j= 0; j < 3; j++ )
+		{
+			edge1[j]= pack.edge1[j][i];
+			edge2[j]= pack.edge2[j][i];
+			s[j]= beam.point[j] - pack.v0[j][i];
+		}
+
+		float p[3], q[3];
+		mxVec3Cross( beam.dir, edge2, p );
+		float det= mxVec3Dot( edge1, p );
+		if( det == 0.0f )
+			continue; // beam is parallel to triangle or triangle is unused
+
+		float inv_det= 1.0f / det;
+		float u= mxVec3Dot( s, p ) * inv_det;
+		if( u < 0.0f || u > 1.0f )
+			continue;
+
+		mxVec3Cross( s, edge1, q );
+		float v= mxVec3Dot( beam.dir, q ) * inv_det;
+		if( v < 0.0f || u + v > 1.0f )
+			continue;
+
+		float t= mxVec3Dot( edge2, q ) * inv_det;
+		if( t >= 0.0f && t <= beam.max_distance && t < nearest_distance )
+			nearest_distance= t;
+	}
+	return nearest_distance;
+#endif
+}
+
+bool mxBVHTraverse( mx_BVHBeam& beam, const mx_BVHNode* nodes, unsigned int root, mx_BVHLeafFunc leaf_func, void* context )
+{
+	float enter_distance;
+	if( !mxBVHBeamIntersectBox( beam, nodes[ root ].bb_min, nodes[ root ].bb_max, &enter_distance ) )
+		return false;
+
+	bool hit= false;
+	TraverseStackEntry stack[ MX_BVH_MAX_DEPTH ];
+	unsigned int stack_size= 0;
+	unsigned int current= root;
+	while(true)
+	{
+		const mx_BVHNode& node= nodes[ current ];
+		if( node.count > 0 )
+		{
+			if( leaf_func( context, beam, node ) )
+			{
+				hit= true;
+				if( beam.any_hit ) return true;
+			}
+		}
+		else
+		{
+			// Visit nearest child first, farther child - later, if it is not behind found hit.
+			unsigned int children[2]= { current + 1, node.first };
+			float children_distances[2];
+			bool children_hit[2];
+			for( unsigned int i= 0; i < 2; i++ )
+				children_hit[i]= mxBVHBeamIntersectBox( beam, nodes[ children[i] ].bb_min, nodes[ children[i] ].bb_max, &children_distances[i] );
+
+			if( children_hit[0] && children_hit[1] )
+			{
+				unsigned int nearest= children_distances[1] < children_distances[0] ? 1 : 0;
+				MX_ASSERT( stack_size < MX_BVH_MAX_DEPTH );
+				stack[ stack_size ].node= children[ nearest ^ 1 ];
+				stack[ stack_size ].enter_distance= children_distances[ nearest ^ 1 ];
+				stack_size++;
+				current= children[ nearest ];
+				continue;
+			}
+			if( children_hit[0] || children_hit[1] )
+			{
+				current= children[ children_hit[0] ? 0 : 1 ];
+				continue;
+			}
+		}
+
+		while( stack_size > 0 && stack[ stack_size - 1 ].enter_distance > beam.max_distance )
+			stack_size--;
+		if( stack_size == 0 )
+			break;
+		stack_size--;
+		current= stack[ stack_size ].node;
+	}
+
+	return hit;
+}
+
+static bool BeamIntersectPackLeaf( void* context, mx_BVHBeam& beam, const mx_BVHNode& leaf )
+{
+	const mx_BVHTrianglePack* packs= (const mx_BVHTrianglePack*) context;
+	float distance= mxBVHBeamIntersectPack( beam, packs[ leaf.first ] );
+	if( distance > beam.max_distance )
+		return false;
+
+	beam.max_distance= distance;
+	return true;
+}
+
+bool mxBVHTraverseTrianglesTree( mx_BVHBeam& beam, const mx_BVHNode* nodes, unsigned int root, const mx_BVHTrianglePack* packs )
+{
+	return mxBVHTraverse( beam, nodes, root, BeamIntersectPackLeaf, (void*) packs );
+}
\ No newline at end of file
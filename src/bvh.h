@@ -0,0 +1,64 @@
+#pragma once
+
+// Triangles count in leaf of triangles tree. Leaf triangles are tested together, with SSE.
+#define MX_BVH_LEAF_TRIANGLES 4
+#define MX_BVH_MAX_DEPTH 64
+
+// Bounding volumes hierarchy building blocks, shared by level and models beam casts.
+// Tree is array of nodes in depth-first order.
+
+struct mx_BVHNode
+{
+	float bb_min[3];
+	unsigned int first; // leaf - first item, inner node - second child. First child always follows node.
+	float bb_max[3];
+	unsigned int count; // leaf - count of items, 0 for inner node
+};
+
+// Leaf triangles in SoA layout. Triangle - vertex 0 and two edges from it.
+// Unused triangles have zero edges and never intersected.
+struct mx_BVHTrianglePack
+{
+	float v0[3][MX_BVH_LEAF_TRIANGLES];
+	float edge1[3][MX_BVH_LEAF_TRIANGLES];
+	float edge2[3][MX_BVH_LEAF_TRIANGLES];
+};
+
+struct mx_BVHBeam
+{
+	float point[3];
+	float dir[3];
+	float inv_dir[3];
+	float max_distance;
+	bool any_hit;
+};
+
+// Leaf callback for mxBVHTraverse. Returns true, if hit found, and decreases beam.max_distance to hit distance.
+typedef bool (*mx_BVHLeafFunc)( void* context, mx_BVHBeam& beam, const mx_BVHNode& leaf );
+
+// Sets beam.inv_dir. Call it before traversal. beam.dir must be normalized.
+void mxBVHPrepareBeam( mx_BVHBeam& beam );
+
+// Builds tree for items [first_item; first_item + item_count) of items_indices. Reorders items_indices.
+// Leafs reference ranges of items_indices. Nodes capacity must be enough. Returns index of root node.
+unsigned int mxBVHBuildTree(
+	const float* items_bb_min, const float* items_bb_max,
+	unsigned int* items_indices, unsigned int first_item, unsigned int item_count, unsigned int max_leaf_items,
+	unsigned int depth, mx_BVHNode* nodes, unsigned int* in_out_node_count );
+
+// Builds tree of triangles. Each leaf references one pack. triangles_vertices - 9 floats per triangle.
+// Capacity of nodes must be not less, than 2 * triangle_count, capacity of packs - not less, than triangle_count.
+// Returns index of root node.
+unsigned int mxBVHBuildTrianglesTree(
+	const float* triangles_vertices, unsigned int triangle_count,
+	mx_BVHNode* nodes, unsigned int* in_out_node_count,
+	mx_BVHTrianglePack* packs, unsigned int* in_out_pack_count );
+
+bool mxBVHBeamIntersectBox( const mx_BVHBeam& beam, const float* bb_min, const float* bb_max, float* out_enter_distance );
+// Returns distance to nearest intersection, or infinity.
+float mxBVHBeamIntersectPack( const mx_BVHBeam& beam, const mx_BVHTrianglePack& pack );
+
+// Visits leafs, crossed by beam, nearest first. Returns true, if some leaf callback found hit.
+bool mxBVHTraverse( mx_BVHBeam& beam, const mx_BVHNode* nodes, unsigned int root, mx_BVHLeafFunc leaf_func, void* context );
+// Traverses tree, built by mxBVHBuildTrianglesTree.
+bool mxBVHTraverseTrianglesTree( mx_BVHBeam& beam, const mx_BVHNode* nodes, unsigned int root, const mx_BVHTrianglePack* packs );
\ No newline at end of file
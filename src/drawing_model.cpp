@@ -1,5 +1,7 @@
 #include <cstring>
 
+#include "bvh.h"
+#include "mx_assert.h"
 #include "mx_math.h"
 #include "mx_model.h"
 
@@ -8,6 +10,7 @@
 mx_DrawingModel::mx_DrawingModel()
 	: vertices_(NULL), indeces_(NULL)
 	, vertex_count_(0), index_count_(0)
+	, bvh_nodes_(NULL), bvh_triangle_packs_(NULL)
 {
 }
 
@@ -17,6 +20,8 @@ mx_DrawingModel::~mx_DrawingModel()
 		delete[] vertices_;
 	if( indeces_ != NULL )
 		delete[] indeces_;
+	delete[] bvh_nodes_;
+	delete[] bvh_triangle_packs_;
 }
 
 void mx_DrawingModel::SetVertexData( mx_DrawingModelVertex* vertices, unsigned int vertex_count )
@@ -250,7 +255,7 @@ void mx_DrawingModel::CalculateBoundingBox()
 		for( unsigned int j= 0; j< 3; j++ )
 		{
 			if( vertices_[i].pos[j] > bounding_box_max_[j] ) bounding_box_max_[j]= vertices_[i].pos[j];
-			else if( vertices_[i].pos[j] < bounding_box_min_[j] ) bounding_box_min_[j]= vertices_[i].pos[j];
+			if( vertices_[i].pos[j] < bounding_box_min_[j] ) bounding_box_min_[j]= vertices_[i].pos[j];
 		}
 	}
 	for( unsigned int i= 0; i< 3; i++ )
@@ -259,33 +264,72 @@ void mx_DrawingModel::CalculateBoundingBox()
 	bounding_sphere_radius_= 0.5f * mxDistance( bounding_box_max_, bounding_box_min_ );
 }
 
-bool mx_DrawingModel::BeamIntersectModel( const float* beam_point, const float* beam_dir, float max_distance, float* out_pos_opt ) const
+void mx_DrawingModel::BuildBeamIntersectionTree()
 {
-	float min_distance= 1e24f;
-	bool is_intersection= false;
+	CalculateBoundingBox();
+
+	delete[] bvh_nodes_;
+	delete[] bvh_triangle_packs_;
+	bvh_nodes_= NULL;
+	bvh_triangle_packs_= NULL;
+
+	unsigned int triangle_count= index_count_ / 3;
+	if( triangle_count == 0 )
+		return;
 
-	const unsigned short* ind= indeces_;
-	for( unsigned int i= 0; i< index_count_; i+= 3, ind+= 3 )
+	float* triangles_vertices= new float[ triangle_count * 9 ];
+	for( unsigned int i= 0; i < index_count_; i++ )
 	{
-		float* triangle[3];
-		for( unsigned int j= 0; j < 3; j++ )
-			triangle[j]= vertices_[ind[j]].pos;
+		VEC3_CPY( triangles_vertices + i * 3, vertices_[ indeces_[i] ].pos );
+	}
 
-		float intersection_pos[3];
-		if( mxBeamIntersectTriangle( triangle, beam_point, beam_dir, max_distance, intersection_pos ) )
-		{
-			is_intersection= true;
+	bvh_nodes_= new mx_BVHNode[ triangle_count * 2 ];
+	bvh_triangle_packs_= new mx_BVHTrianglePack[ triangle_count ];
+	unsigned int node_count= 0, pack_count= 0;
+	bvh_root_= mxBVHBuildTrianglesTree(
+		triangles_vertices, triangle_count,
+		bvh_nodes_, &node_count,
+		bvh_triangle_packs_, &pack_count );
 
-			float dist= mxDistance( beam_point, intersection_pos );
-			if( dist < min_distance )
-			{
-				min_distance= dist;
-				if( out_pos_opt )
-				{
-					VEC3_CPY( out_pos_opt, intersection_pos );
-				}
-			}
-		}
+	delete[] triangles_vertices;
+}
+
+bool mx_DrawingModel::BeamIntersectModel( const float* beam_point, const float* beam_dir, float max_distance, float* out_pos_opt ) const
+{
+	if( index_count_ == 0 )
+		return false;
+	MX_ASSERT( bvh_nodes_ != NULL );
+
+	// Reject beam, if nearest to bounding sphere center point of beam is outside sphere.
+	float vec_to_center[3];
+	mxVec3Sub( bounding_sphere_center_, beam_point, vec_to_center );
+	float center_projection= mxVec3Dot( vec_to_center, beam_dir );
+	if( center_projection < 0.0f ) center_projection= 0.0f;
+	else if( center_projection > max_distance ) center_projection= max_distance;
+
+	float vec_to_nearest_point[3];
+	mxVec3Mul( beam_dir, center_projection, vec_to_nearest_point );
+	mxVec3Sub( vec_to_center, vec_to_nearest_point );
+	if( mxVec3Dot( vec_to_center, vec_to_center ) > bounding_sphere_radius_ * bounding_sphere_radius_ )
+		return false;
+
+	mx_BVHBeam beam;
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		beam.point[j]= beam_point[j];
+		beam.dir[j]= beam_dir[j];
+	}
+	beam.max_distance= max_distance;
+	beam.any_hit= out_pos_opt == NULL;
+	mxBVHPrepareBeam( beam );
+
+	if( !mxBVHTraverseTrianglesTree( beam, bvh_nodes_, bvh_root_, bvh_triangle_packs_ ) )
+		return false;
+
+	if( out_pos_opt != NULL )
+	{
+		mxVec3Mul( beam_dir, beam.max_distance, out_pos_opt );
+		mxVec3Add( out_pos_opt, beam_point );
 	}
-	return is_intersection;
+	return true;
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 
+struct mx_BVHNode;
+struct mx_BVHTrianglePack;
+
 // 32-byte GPU vertex
 struct mx_DrawingModelVertex
 {
@@ -46,6 +49,9 @@ public:
 	const float* BoundingSphereCenter() const;
 	float BoundingSphereRadius() const;
 
+	// Calculates bounding box and builds triangles tree for BeamIntersectModel. Call it after last change of vertices.
+	void BuildBeamIntersectionTree();
+	// beam_dir must be normalized. Valid only after BuildBeamIntersectionTree() call.
 	bool BeamIntersectModel( const float* beam_point, const float* beam_dir, float max_distance, float* out_pos_opt ) const;
 
 private:
@@ -58,6 +64,10 @@ private:
 	float bounding_box_max_[3];
 	float bounding_sphere_center_[3];
 	float bounding_sphere_radius_;
+
+	mx_BVHNode* bvh_nodes_;
+	mx_BVHTrianglePack* bvh_triangle_packs_;
+	unsigned int bvh_root_;
 };
 
 inline const mx_DrawingModelVertex* mx_DrawingModel::GetVertexData() const
@@ -0,0 +1,110 @@
+#include <cstring>
+
+#include "monster.h"
+#include "mx_assert.h"
+#include "mx_math.h"
+#include "player.h"
+
+#include "drawing_snapshot.h"
+
+mx_DrawingSnapshot::mx_DrawingSnapshot( const mx_LevelData& level_data )
+	: sectors_(level_data.sectors), sector_count_(level_data.sector_count)
+	, drawing_time_(0.0f)
+	, monster_count_(0)
+	, ammo_boxes_(new AmmoBox[ level_data.sector_count * MX_MAX_SECTOR_AMMO_BOXES ]), ammo_box_count_(0)
+	, icosahedrons_picked_(new bool[ level_data.sector_count ])
+	, health_pack_count_(0)
+	, bullets_(NULL), bullet_count_(0), bullets_capacity_(0)
+	, blast_light_count_(0)
+	, particle_count_(0)
+{
+	std::memset( &camera_, 0, sizeof(Camera) );
+	std::memset( &player_stats_, 0, sizeof(PlayerStats) );
+	for( unsigned int s= 0; s < sector_count_; s++ )
+		icosahedrons_picked_[s]= sectors_[s].icosahedron_picked;
+}
+
+mx_DrawingSnapshot::~mx_DrawingSnapshot()
+{
+	delete[] ammo_boxes_;
+	delete[] icosahedrons_picked_;
+	delete[] bullets_;
+}
+
+void mx_DrawingSnapshot::Fill( const mx_Level& level, const mx_Player& player, float k, float tick_time, float drawing_time )
+{
+	MX_ASSERT( level.GetLevelData().sectors == sectors_ );
+
+	drawing_time_= drawing_time;
+
+	player.GetInterpolatedPos( k, camera_.pos );
+	player.CreateRotationMatrix4( camera_.rotation_mat, false );
+	camera_.fov= player.Fov();
+	// Interpolated camera may be still in previous sector, near portal. Portals culling must start from sector of camera.
+	camera_.sector= level.FindSectorForPoint( camera_.pos, player.GetSector() );
+	if( camera_.sector == NULL )
+		camera_.sector= player.GetSector();
+	camera_.map_mode= player.IsInMapMode();
+
+	player_stats_.health= player.GetHealth();
+	player_stats_.lives= player.GetLives();
+	for( unsigned int i= 0; i < LastBullet; i++ )
+		player_stats_.ammo[i]= player.GetAmmo( BulletType(i) );
+	player_stats_.current_weapon= player.GetCurrentWeapon();
+
+	const mx_Monster* const* monsters= level.GetMonsters();
+	monster_count_= level.GetMonsterCount();
+	for( unsigned int m= 0; m < monster_count_; m++ )
+	{
+		const mx_Monster* monster= monsters[m];
+		Monster& out_monster= monsters_[m];
+
+		monster->GetInterpolatedPos( k, out_monster.pos );
+		monster->CreateInterpolatedRotationMatrix4( k, out_monster.rotation_mat, true );
+		out_monster.type= monster->GetType();
+		out_monster.sector= &monster->GetSector();
+	}
+
+	ammo_box_count_= 0;
+	for( unsigned int s= 0; s < sector_count_; s++ )
+	{
+		const mx_LevelSector& sector= sectors_[s];
+		for( unsigned int a= 0; a < sector.ammo_box_count; a++ )
+		{
+			ammo_boxes_[ ammo_box_count_ ].box= sector.ammo_boxes[a];
+			ammo_boxes_[ ammo_box_count_ ].sector= &sector;
+			ammo_box_count_++;
+		}
+		icosahedrons_picked_[s]= sector.icosahedron_picked;
+	}
+
+	health_pack_count_= level.GetHealthPackCount();
+	std::memcpy( health_packs_, level.GetHealthPacks(), sizeof(mx_HealthPack) * health_pack_count_ );
+
+	const mx_BulletPool& bullets= level.GetBullets();
+	bullet_count_= bullets.GetCount();
+	if( bullet_count_ > bullets_capacity_ )
+	{
+		delete[] bullets_;
+		bullets_capacity_= bullets_capacity_ * 2 > bullet_count_ ? bullets_capacity_ * 2 : bullet_count_;
+		bullets_= new Bullet[ bullets_capacity_ ];
+	}
+	for( unsigned int b= 0; b < bullet_count_; b++ )
+	{
+		bullets.GetInterpolatedPos( b, tick_time, k, bullets_[b].pos );
+		bullets_[b].type= bullets.GetType(b);
+	}
+
+	blast_light_count_= level.GetBlastLightCount();
+	level.PrepareBlastLights( blast_lights_ );
+
+	const mx_ParticlesManager* particles_manager= level.GetParticlesManager();
+	particle_count_= particles_manager->GetParticlesCount();
+	MX_ASSERT( particle_count_ <= MX_MAX_PARTICLES );
+	particles_manager->PrepareParticlesVertices( particles_vertices_, k );
+}
+
+void mx_DrawingSnapshot::UpdateCameraRotation( const mx_Player& player )
+{
+	player.CreateRotationMatrix4( camera_.rotation_mat, false );
+}
\ No newline at end of file
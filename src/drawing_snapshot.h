@@ -0,0 +1,197 @@
+#pragma once
+
+#include "fwd.h"
+#include "game_constants.h"
+#include "level.h"
+#include "particles_manager.h"
+
+// Copy of dynamic level and player state, needed for drawing. Positions are already interpolated.
+// Snapshot filled by simulation thread after ticks, and after that only read by render thread,
+// while simulation of next frame changes level. Static level data (geometry, sectors) not copied.
+class mx_DrawingSnapshot
+{
+public:
+	struct Camera
+	{
+		float pos[3];
+		float rotation_mat[16];
+		float fov;
+		const mx_LevelSector* sector;
+		bool map_mode;
+	};
+
+	struct PlayerStats
+	{
+		int health;
+		unsigned int lives;
+		unsigned int ammo[ LastBullet ];
+		BulletType current_weapon;
+	};
+
+	struct Monster
+	{
+		float pos[3];
+		float rotation_mat[16]; // inverted
+		MonsterType type;
+		const mx_LevelSector* sector;
+	};
+
+	struct AmmoBox
+	{
+		mx_AmmoBox box;
+		const mx_LevelSector* sector;
+	};
+
+	struct Bullet
+	{
+		float pos[3];
+		BulletType type;
+	};
+
+	mx_DrawingSnapshot( const mx_LevelData& level_data );
+	~mx_DrawingSnapshot();
+
+	// k - interpolation factor, drawing_time - time of drawn state.
+	void Fill( const mx_Level& level, const mx_Player& player, float k, float tick_time, float drawing_time );
+	// Camera rotation is not interpolated, so it may be taken from player after mouse input, just before drawing.
+	void UpdateCameraRotation( const mx_Player& player );
+
+	const Camera& GetCamera() const;
+	const PlayerStats& GetPlayerStats() const;
+	float GetDrawingTime() const;
+
+	const Monster* GetMonsters() const;
+	unsigned int GetMonsterCount() const;
+
+	const AmmoBox* GetAmmoBoxes() const;
+	unsigned int GetAmmoBoxCount() const;
+
+	// sector_index - index in level sectors.
+	bool IsIcosahedronPicked( unsigned int sector_index ) const;
+
+	const mx_HealthPack* GetHealthPacks() const;
+	unsigned int GetHealthPackCount() const;
+
+	const Bullet* GetBullets() const;
+	unsigned int GetBulletCount() const;
+
+	const mx_Light* GetBlastLights() const;
+	unsigned int GetBlastLightCount() const;
+
+	const mx_ParticleVertex* GetParticlesVertices() const;
+	unsigned int GetParticleCount() const;
+
+private:
+	mx_DrawingSnapshot(const mx_DrawingSnapshot&);
+	mx_DrawingSnapshot& operator=(const mx_DrawingSnapshot&);
+
+private:
+	const mx_LevelSector* sectors_;
+	unsigned int sector_count_;
+
+	Camera camera_;
+	PlayerStats player_stats_;
+	float drawing_time_;
+
+	Monster monsters_[ MX_MAX_MONSTERS ];
+	unsigned int monster_count_;
+
+	AmmoBox* ammo_boxes_; // MX_MAX_SECTOR_AMMO_BOXES per sector
+	unsigned int ammo_box_count_;
+
+	bool* icosahedrons_picked_; // per sector
+
+	mx_HealthPack health_packs_[ MX_MAX_HEALTH_PACKS ];
+	unsigned int health_pack_count_;
+
+	// Bullets count is not limited, storage grows, if needed.
+	Bullet* bullets_;
+	unsigned int bullet_count_;
+	unsigned int bullets_capacity_;
+
+	mx_Light blast_lights_[ MX_MAX_BLAST_LIGHTS ];
+	unsigned int blast_light_count_;
+
+	mx_ParticleVertex particles_vertices_[ MX_MAX_PARTICLES ];
+	unsigned int particle_count_;
+};
+
+inline const mx_DrawingSnapshot::Camera& mx_DrawingSnapshot::GetCamera() const
+{
+	return camera_;
+}
+
+inline const mx_DrawingSnapshot::PlayerStats& mx_DrawingSnapshot::GetPlayerStats() const
+{
+	return player_stats_;
+}
+
+inline float mx_DrawingSnapshot::GetDrawingTime() const
+{
+	return drawing_time_;
+}
+
+inline const mx_DrawingSnapshot::Monster* mx_DrawingSnapshot::GetMonsters() const
+{
+	return monsters_;
+}
+
+inline unsigned int mx_DrawingSnapshot::GetMonsterCount() const
+{
+	return monster_count_;
+}
+
+inline const mx_DrawingSnapshot::AmmoBox* mx_DrawingSnapshot::GetAmmoBoxes() const
+{
+	return ammo_boxes_;
+}
+
+inline unsigned int mx_DrawingSnapshot::GetAmmoBoxCount() const
+{
+	return ammo_box_count_;
+}
+
+inline bool mx_DrawingSnapshot::IsIcosahedronPicked( unsigned int sector_index ) const
+{
+	return icosahedrons_picked_[ sector_index ];
+}
+
+inline const mx_HealthPack* mx_DrawingSnapshot::GetHealthPacks() const
+{
+	return health_packs_;
+}
+
+inline unsigned int mx_DrawingSnapshot::GetHealthPackCount() const
+{
+	return health_pack_count_;
+}
+
+inline const mx_DrawingSnapshot::Bullet* mx_DrawingSnapshot::GetBullets() const
+{
+	return bullets_;
+}
+
+inline unsigned int mx_DrawingSnapshot::GetBulletCount() const
+{
+	return bullet_count_;
+}
+
+inline const mx_Light* mx_DrawingSnapshot::GetBlastLights() const
+{
+	return blast_lights_;
+}
+
+inline unsigned int mx_DrawingSnapshot::GetBlastLightCount() const
+{
+	return blast_light_count_;
+}
+
+inline const mx_ParticleVertex* mx_DrawingSnapshot::GetParticlesVertices() const
+{
+	return particles_vertices_;
+}
+
+inline unsigned int mx_DrawingSnapshot::GetParticleCount() const
+{
+	return particle_count_;
+}
\ No newline at end of file
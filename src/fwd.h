@@ -2,9 +2,12 @@
 
 // Forward declarations of "shared" classes here
 
+class mx_DrawingSnapshot;
 class mx_Level;
 struct mx_LevelData;
+class mx_LevelGenerator;
 struct mx_LevelSector;
+class mx_LevelSnapshot;
 class mx_MainLoop;
 class mx_Monster;
 class mx_ParticlesManager;
@@ -66,6 +66,7 @@ PROCESS_OGL_FUNCTION( PFNGLACTIVETEXTUREPROC, glActiveTexture );
 PROCESS_OGL_FUNCTION( PFNGLGENERATEMIPMAPPROC, glGenerateMipmap );
 PROCESS_OGL_FUNCTION( PFNGLTEXIMAGE3DPROC, glTexImage3D );
 PROCESS_OGL_FUNCTION( PFNGLTEXSUBIMAGE3DPROC, glTexSubImage3D );
+PROCESS_OGL_FUNCTION( PFNGLCOMPRESSEDTEXSUBIMAGE3DPROC, glCompressedTexSubImage3D );
 
 /*FBO*/
 PROCESS_OGL_FUNCTION( PFNGLGENFRAMEBUFFERSPROC, glGenFramebuffers );
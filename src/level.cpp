@@ -1,3 +1,5 @@
+#include <cstring>
+
 #include "main_loop.h"
 #include "models.h"
 #include "monster.h"
@@ -10,6 +12,13 @@
 #include "level.h"
 
 #define MX_BLAST_LIFETIME 1.0f
+#define MX_BULLET_LIFETIME 3.0f
+// End of sector monsters list.
+#define MX_NO_MONSTER 0xFFFFFFFFu
+
+#if MX_STREAMING_MIN_HOPS_TO_BORDER < MX_PVS_MAX_HOPS
+#error "Streamed geometry does not cover all potentially visible sectors"
+#endif
 
 static bool CollideWithEdge( const float* v0, const float* v1, float* in_out_pos, float radius )
 {
@@ -68,12 +77,24 @@ static bool CollideWithEdge( const float* v0, const float* v1, float* in_out_pos
 	}
 }
 
+static bool IsPointInSector( const float* point, const mx_LevelSector* sector )
+{
+	if( sector->planes_count == 0 )
+		return false;
+
+	for( unsigned int j= 0; j < sector->planes_count; j++ )
+		if( mxVec3Dot( sector->planes[j].normal, point ) < sector->planes[j].dist )
+			return false;
+	return true;
+}
+
 mx_Level::mx_Level( const mx_LevelData& level_data, mx_Player& player )
 	: player_(player)
 	, level_data_(level_data)
+	, bvh_(level_data_)
+	, pvs_(level_data_)
 	, monster_count_(0)
 	, health_pack_count_(0)
-	, bullet_count_(0)
 	, blast_count_(0)
 	, particles_manager_(new mx_ParticlesManager)
 {
@@ -88,6 +109,10 @@ mx_Level::mx_Level( const mx_LevelData& level_data, mx_Player& player )
 	// Remove all ammo from this sector
 	player_sector_->ammo_box_count= 0;
 
+	sectors_first_monster_= new unsigned int[ level_data_.sector_count ];
+	for( unsigned int s= 0; s < level_data_.sector_count; s++ )
+		sectors_first_monster_[s]= MX_NO_MONSTER;
+
 	for( unsigned int i= 0; i < level_data_.sector_count && monster_count_ < MX_MAX_MONSTERS; i++ )
 	{
 		const mx_LevelSector& sector= level_data_.sectors[i];
@@ -124,23 +149,53 @@ mx_Level::mx_Level( const mx_LevelData& level_data, mx_Player& player )
 			player_,
 			pos,
 			&path );
+		LinkMonsterToSector( monster_count_ );
 		monster_count_++;
 	}
 
+	monsters_max_radius_= 0.0f;
 	for( unsigned int i= 0; i < LastMonster; i++ )
 	{
 		mx_Models::Model model= mx_Models::monster_to_model_table[i];
 		monsters_models_[i].LoadFromMFMD( mx_Models::models[model] );
 		monsters_models_[i].Scale( mx_Models::models_scale[model] );
+		monsters_models_[i].BuildBeamIntersectionTree();
+
+		const mx_DrawingModelVertex* vertices= monsters_models_[i].GetVertexData();
+		for( unsigned int v= 0; v < monsters_models_[i].GetVertexCount(); v++ )
+		{
+			float r= mxVec3Len( vertices[v].pos );
+			if( r > monsters_max_radius_ ) monsters_max_radius_= r;
+		}
 	}
 
 	icosahedrons_left_= 0;
 	for( unsigned int s= 0; s < level_data_.sector_count; s++ )
 		if( level_data_.sectors[s].has_icosahedron ) icosahedrons_left_++;
+
+	BuildSectorsGrid();
 }
 
 mx_Level::~mx_Level()
 {
+	delete[] sectors_grid_cells_offsets_;
+	delete[] sectors_grid_sectors_;
+	delete[] sectors_first_monster_;
+}
+
+void mx_Level::UpdateGeometry( const mx_LevelData& level_data )
+{
+	MX_ASSERT( level_data.sectors == level_data_.sectors );
+
+	level_data_.vertices= level_data.vertices;
+	level_data_.vertices_capacity= level_data.vertices_capacity;
+	level_data_.vertex_count= level_data.vertex_count;
+
+	level_data_.triangles= level_data.triangles;
+	level_data_.triangles_capacity= level_data.triangles_capacity;
+	level_data_.triangle_count= level_data.triangle_count;
+
+	bvh_.InvalidateGeometry( level_data_ );
 }
 
 void mx_Level::PrepareBlastLights( mx_Light* out_lights ) const
@@ -167,27 +222,62 @@ void mx_Level::PrepareBlastLights( mx_Light* out_lights ) const
 	}
 }
 
-const mx_LevelSector* mx_Level::FindSectorForPoint( const float* point ) const
+const mx_LevelSector* mx_Level::FindSectorForPoint( const float* point, const mx_LevelSector* hint_sector ) const
 {
-	for(const mx_LevelSector* s= level_data_.sectors, *s_end= level_data_.sectors + level_data_.sector_count;
-		s < s_end;
-		s++ )
+	if( hint_sector != NULL )
 	{
-		bool inside= s->planes_count > 0;
-		for( unsigned int j= 0; j < s->planes_count; j++ )
-		{
-			if( mxVec3Dot( s->planes[j].normal, point ) < s->planes[j].dist )
-			{
-				inside= false;
-				break;
-			}
-		}
-		if( inside ) return s;
+		if( IsPointInSector( point, hint_sector ) )
+			return hint_sector;
+		for( unsigned int i= 0; i < hint_sector->connections_count; i++ )
+			if( IsPointInSector( point, hint_sector->connections[i] ) )
+				return hint_sector->connections[i];
+	}
+
+	int cell_coord[3];
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		cell_coord[j]= ( int(std::floor( point[j] )) >> MX_SECTORS_GRID_CELL_SIZE_LOG2 ) - sectors_grid_origin_[j];
+		if( cell_coord[j] < 0 || cell_coord[j] >= sectors_grid_size_[j] )
+			return NULL;
+	}
+
+	unsigned int cell= cell_coord[0] + sectors_grid_size_[0] * ( cell_coord[1] + sectors_grid_size_[1] * cell_coord[2] );
+	for( unsigned int i= sectors_grid_cells_offsets_[ cell ]; i < sectors_grid_cells_offsets_[ cell + 1 ]; i++ )
+	{
+		const mx_LevelSector* sector= level_data_.sectors + sectors_grid_sectors_[i];
+		if( IsPointInSector( point, sector ) )
+			return sector;
 	}
 
 	return NULL;
 }
 
+bool mx_Level::BeamIntersectLevel( const float* pos, const float* normalized_dir, float max_distance, float* out_pos_opt ) const
+{
+	float distance;
+	if( !bvh_.BeamIntersect( pos, normalized_dir, max_distance, &distance ) )
+		return false;
+
+	if( out_pos_opt != NULL )
+	{
+		mxVec3Mul( normalized_dir, distance, out_pos_opt );
+		mxVec3Add( out_pos_opt, pos );
+	}
+	return true;
+}
+
+bool mx_Level::IsLineOfSight( const float* from, const float* to ) const
+{
+	float dir[3];
+	mxVec3Sub( to, from, dir );
+	float distance= mxVec3Len( dir );
+	if( distance == 0.0f )
+		return true;
+
+	mxVec3Mul( dir, 1.0f / distance );
+	return !bvh_.BeamIntersectAny( from, dir, distance );
+}
+
 bool mx_Level::CollideWithSectorTriangles( float* in_out_pos, float radius, const mx_LevelSector* sector ) const
 {
 	bool collided= false;
@@ -287,6 +377,7 @@ void mx_Level::Tick()
 	// Monsters think
 	for( unsigned int m= 0; m < monster_count_; m++ )
 	{
+		monsters_[m]->SavePrevState();
 		monsters_[m]->Exec();
 	}
 
@@ -307,119 +398,22 @@ void mx_Level::Tick()
 	// Process particles. Make this BEFORE after logic, wher we can add particles.
 	particles_manager_->Tick( dt );
 
-	// Process bullets
-	for( unsigned int b= 0; b < bullet_count_; )
+	// Process bullets. Kill old bullets and bullets with collisions, then remove killed and move others together.
+	bullets_.KillOld( total_time - MX_BULLET_LIFETIME );
+	for( unsigned int b= 0; b < bullets_.GetCount(); b++ )
 	{
-		mx_Bullet& bullet= bullets_[b];
-
-		bool dead= false;
-		if( total_time - bullet.birth_time > 3.0f )
-		{
-			dead= true;
-			goto kill;
-		}
-
-		float dir[3];
-		mxVec3Normalize( bullet.speed, dir );
-		float max_dist= mxVec3Len( bullet.speed ) * dt;
-
-		float nearest_hit_dist= mxInf();
-		mx_Monster* hited_monster= NULL;
-		//float nearest_hit_pos[3];
-
-		// Collide with monsters first. Monsters are always inside sector
-		for( unsigned int j= 0; j < monster_count_; j++ )
-		{
-			mx_Monster* monster= monsters_[j];
-			if( bullet.owner == monster )
-				continue;
-
-			float monster_space_pos[3];
-			float monster_space_dir[3];
-			float monster_space_hit_pos[3];
-
-			float pos_relative_monster[3];
-			mxVec3Sub( bullet.pos, monster->Pos(), pos_relative_monster );
-
-			float monster_rot_mat[16];
-			//float monster_rot_mat_invert[16];
-			monster->CreateRotationMatrix4( monster_rot_mat, false );
-			//monster->CreateRotationMatrix4( monster_rot_mat_invert, true );
-			mxVec3Mat4Mul( pos_relative_monster, monster_rot_mat, monster_space_pos );
-			mxVec3Mat4Mul( dir, monster_rot_mat, monster_space_dir );
-	
-			if( monsters_models_[monster->GetType()].BeamIntersectModel( monster_space_pos, monster_space_dir, max_dist, monster_space_hit_pos ) )
-			{
-				float dist= mxDistance( monster_space_hit_pos, monster_space_pos );
-				if( dist < nearest_hit_dist )
-				{
-					nearest_hit_dist= dist;
-					hited_monster= monster;
-					//mxVec3Mat4Mul( monster_space_hit_pos, monster_rot_mat_invert, nearest_hit_pos );
-					//mxVec3Add( nearest_hit_pos, monster->Pos() );
-				}
-				dead= true;
-			}
-		} // for monsters
-
-		if( hited_monster )
-			hited_monster->Hit( mx_GameConstants::bullets_damage[bullet.type] );
-
-		if( bullet.owner != &player_ )
-		{
-			float new_bullet_pos[3];
-			mxVec3Mul( bullet.speed, dt, new_bullet_pos );
-			mxVec3Add( new_bullet_pos, bullet.pos );
-
-			if( mxSquareDistance( new_bullet_pos, player_.Pos() )
-				<= mx_GameConstants::player_radius * mx_GameConstants::player_radius )
-			{
-				player_.Hit( mx_GameConstants::bullets_damage[bullet.type] );
-				dead= true;
-				goto kill;
-			}
-		}
-
-		const mx_LevelSector* sector= FindSectorForPoint( bullet.pos );
-		if( sector )
-		{
-			for( unsigned int i= sector->first_triangle , i_end= sector->first_triangle + sector->triangles_count;
-				i < i_end;
-				i++ )
-			{
-				const float* triangle[3];
-				for( unsigned int j= 0; j < 3; j++ )
-					triangle[j]= level_data_.vertices[ level_data_.triangles[i].vertex_index[j] ].xyz;
-
-				float intersection_pos[3];
-				if( mxBeamIntersectTriangle( triangle, bullet.pos, dir, max_dist, intersection_pos ) )
-				{
-					// TODO - find nearest intersection
-					dead= true;
-					break;
-				}
-			}
-		} // collide with sector
-
-kill:
-		if( dead )
-		{
-			if( bullet.type == Rocket )
-				RocketBlast( bullet.pos );
-
-			if( b != bullet_count_ - 1u )
-				bullets_[b]= bullets_[ bullet_count_ - 1u ];
-			bullet_count_--;
+		if( !bullets_.IsKilled(b) && !CollideBullet( b, dt ) )
 			continue;
-		}
 
-		float d_pos[3];
-		mxVec3Mul( bullet.speed, dt, d_pos );
-		mxVec3Add( bullet.pos, d_pos );
-		particles_manager_->AddBullet( &bullet );
-
-		b++;
+		bullets_.Kill(b);
+		if( bullets_.GetType(b) == Rocket )
+			RocketBlast( bullets_.GetPos(b) );
 	}
+	bullets_.RemoveKilled();
+	bullets_.Move( dt );
+
+	for( unsigned int b= 0; b < bullets_.GetCount(); b++ )
+		particles_manager_->AddBullet( bullets_.GetType(b), bullets_.GetPos(b), bullets_.GetSpeed(b) );
 
 	if( mx_LevelSector* sector= const_cast<mx_LevelSector*>( player_.GetSector() ) )
 	{
@@ -498,10 +492,15 @@ kill:
 			}
 
 			AddBlast( monsters_[m]->Pos() );
+			UnlinkMonsterFromSector( m );
 			delete monsters_[m];
 
 			if( m < monster_count_ - 1 )
+			{
+				UnlinkMonsterFromSector( monster_count_ - 1 );
 				monsters_[m]= monsters_[ monster_count_ - 1 ];
+				LinkMonsterToSector( m );
+			}
 
 			monster_count_--;
 			continue;
@@ -510,28 +509,105 @@ kill:
 	}
 }
 
-void mx_Level::Shot( mx_Pawn* shooter, BulletType bullet_type, const float* pos, const float* normalized_dir )
+bool mx_Level::CollideBullet( unsigned int bullet_index, float dt )
 {
-	MX_ASSERT( bullet_count_ <= MX_MAX_BULLETS );
+	BulletType bullet_type= bullets_.GetType( bullet_index );
+	const mx_Pawn* bullet_owner= bullets_.GetOwner( bullet_index );
+	const float* bullet_pos= bullets_.GetPos( bullet_index );
+	const float* bullet_speed= bullets_.GetSpeed( bullet_index );
 
-	mx_Bullet& bullet= bullets_[bullet_count_];
+	bool dead= false;
 
-	bullet.owner= shooter;
-	bullet.type= bullet_type;
-	bullet.birth_time= mx_MainLoop::Instance()->GetTime();
+	float dir[3];
+	mxVec3Normalize( bullet_speed, dir );
+	float max_dist= mxVec3Len( bullet_speed ) * dt;
 
-	VEC3_CPY( bullet.pos, pos );
+	float nearest_hit_dist= mxInf();
+	mx_Monster* hited_monster= NULL;
+	//float nearest_hit_pos[3];
 
-	mxVec3Mul( normalized_dir, mx_GameConstants::bullets_speed[bullet_type], bullet.speed );
+	// Collide with monsters first. Check only monsters of sectors near bullet path.
+	// Monster models may stick out of sectors, so extend path box.
+	float path_bb_min[3], path_bb_max[3];
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		float path_end= bullet_pos[j] + dir[j] * max_dist;
+		path_bb_min[j]= ( bullet_pos[j] < path_end ? bullet_pos[j] : path_end ) - monsters_max_radius_;
+		path_bb_max[j]= ( bullet_pos[j] > path_end ? bullet_pos[j] : path_end ) + monsters_max_radius_;
+	}
+	mx_Monster* near_monsters[ MX_MAX_MONSTERS ];
+	unsigned int near_monster_count= FindMonstersInBox( path_bb_min, path_bb_max, near_monsters );
+
+	for( unsigned int j= 0; j < near_monster_count; j++ )
+	{
+		mx_Monster* monster= near_monsters[j];
+		if( bullet_owner == monster )
+			continue;
+
+		float monster_space_pos[3];
+		float monster_space_dir[3];
+		float monster_space_hit_pos[3];
+
+		float pos_relative_monster[3];
+		mxVec3Sub( bullet_pos, monster->Pos(), pos_relative_monster );
+
+		float monster_rot_mat[16];
+		//float monster_rot_mat_invert[16];
+		monster->CreateRotationMatrix4( monster_rot_mat, false );
+		//monster->CreateRotationMatrix4( monster_rot_mat_invert, true );
+		mxVec3Mat4Mul( pos_relative_monster, monster_rot_mat, monster_space_pos );
+		mxVec3Mat4Mul( dir, monster_rot_mat, monster_space_dir );
+	
+		if( monsters_models_[monster->GetType()].BeamIntersectModel( monster_space_pos, monster_space_dir, max_dist, monster_space_hit_pos ) )
+		{
+			float dist= mxDistance( monster_space_hit_pos, monster_space_pos );
+			if( dist < nearest_hit_dist )
+			{
+				nearest_hit_dist= dist;
+				hited_monster= monster;
+				//mxVec3Mat4Mul( monster_space_hit_pos, monster_rot_mat_invert, nearest_hit_pos );
+				//mxVec3Add( nearest_hit_pos, monster->Pos() );
+			}
+			dead= true;
+		}
+	} // for monsters
+
+	if( hited_monster )
+		hited_monster->Hit( mx_GameConstants::bullets_damage[bullet_type] );
+
+	if( bullet_owner != &player_ )
+	{
+		float new_bullet_pos[3];
+		mxVec3Mul( bullet_speed, dt, new_bullet_pos );
+		mxVec3Add( new_bullet_pos, bullet_pos );
+
+		if( mxSquareDistance( new_bullet_pos, player_.Pos() )
+			<= mx_GameConstants::player_radius * mx_GameConstants::player_radius )
+		{
+			player_.Hit( mx_GameConstants::bullets_damage[bullet_type] );
+			return true;
+		}
+	}
+
+	// Collide with level geometry of all sectors, crossed by bullet.
+	if( bvh_.BeamIntersectAny( bullet_pos, dir, max_dist ) )
+		dead= true;
+
+	return dead;
+}
+
+void mx_Level::Shot( mx_Pawn* shooter, BulletType bullet_type, const float* pos, const float* normalized_dir )
+{
+	float speed[3];
+	mxVec3Mul( normalized_dir, mx_GameConstants::bullets_speed[bullet_type], speed );
+	bullets_.Add( bullet_type, shooter, pos, speed, mx_MainLoop::Instance()->GetTime() );
 
 	// TODO - remove if, place table
 	mx_SoundType sound_type;
 	if( bullet_type == MachinegunBullet ) sound_type= SoundMachinegunShot;
 	else if( bullet_type == Rocket ) sound_type= SoundAutomaticCannonShot;
 	else sound_type= SoundPlasmagunShot;
-	mx_SoundEngine::Instance()->AddSingleSound( sound_type, 1.0f, 1.0f, bullet.pos );
-
-	bullet_count_++;
+	mx_SoundEngine::Instance()->AddSingleSound( sound_type, 1.0f, 1.0f, pos );
 }
 
 void mx_Level::RespawnPlayer()
@@ -556,17 +632,159 @@ void mx_Level::WarnMonsters()
 	}
 }
 
+void mx_Level::BuildSectorsGrid()
+{
+	// Cells ranges of sectors. Sectors boxes are integer, sector touches cells of both its borders.
+	int* sectors_cells= new int[ level_data_.sector_count * 6 ];
+	int grid_min[3], grid_max[3];
+	for( unsigned int s= 0; s < level_data_.sector_count; s++ )
+	{
+		const mx_LevelSector& sector= level_data_.sectors[s];
+		int* cells= sectors_cells + s * 6;
+		for( unsigned int j= 0; j < 3; j++ )
+		{
+			cells[j]= int(std::floor( sector.bb_min[j] )) >> MX_SECTORS_GRID_CELL_SIZE_LOG2;
+			cells[j+3]= int(std::floor( sector.bb_max[j] )) >> MX_SECTORS_GRID_CELL_SIZE_LOG2;
+			if( s == 0 || cells[j] < grid_min[j] ) grid_min[j]= cells[j];
+			if( s == 0 || cells[j+3] > grid_max[j] ) grid_max[j]= cells[j+3];
+		}
+	}
+
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		sectors_grid_origin_[j]= grid_min[j];
+		sectors_grid_size_[j]= grid_max[j] - grid_min[j] + 1;
+	}
+	unsigned int cell_count= sectors_grid_size_[0] * sectors_grid_size_[1] * sectors_grid_size_[2];
+
+	// Two passes - count sectors of each cell, then write them. Sectors of cell go in order of sectors array.
+	sectors_grid_cells_offsets_= new unsigned int[ cell_count + 1 ];
+	std::memset( sectors_grid_cells_offsets_, 0, sizeof(unsigned int) * ( cell_count + 1 ) );
+	for( unsigned int pass= 0; pass < 2; pass++ )
+	{
+		for( unsigned int s= 0; s < level_data_.sector_count; s++ )
+		{
+			const int* cells= sectors_cells + s * 6;
+			for( int z= cells[2]; z <= cells[5]; z++ )
+			for( int y= cells[1]; y <= cells[4]; y++ )
+			for( int x= cells[0]; x <= cells[3]; x++ )
+			{
+				unsigned int cell=
+					( x - sectors_grid_origin_[0] ) +
+					sectors_grid_size_[0] * ( ( y - sectors_grid_origin_[1] ) + sectors_grid_size_[1] * ( z - sectors_grid_origin_[2] ) );
+				if( pass == 0 )
+					sectors_grid_cells_offsets_[ cell + 1 ]++;
+				else
+				{
+					sectors_grid_sectors_[ sectors_grid_cells_offsets_[ cell ] ]= s;
+					sectors_grid_cells_offsets_[ cell ]++;
+				}
+			}
+		}
+
+		if( pass == 0 )
+		{
+			for( unsigned int c= 0; c < cell_count; c++ )
+				sectors_grid_cells_offsets_[ c + 1 ]+= sectors_grid_cells_offsets_[c];
+			sectors_grid_sectors_= new unsigned int[ sectors_grid_cells_offsets_[ cell_count ] ];
+		}
+	}
+	// After second pass each offset points to end of its cell - begin of next cell. Shift offsets back.
+	for( unsigned int c= cell_count; c > 0; c-- )
+		sectors_grid_cells_offsets_[c]= sectors_grid_cells_offsets_[ c - 1 ];
+	sectors_grid_cells_offsets_[0]= 0;
+
+	delete[] sectors_cells;
+}
+
+void mx_Level::LinkMonsterToSector( unsigned int monster_index )
+{
+	unsigned int sector_index= &monsters_[ monster_index ]->GetSector() - level_data_.sectors;
+	monsters_next_in_sector_[ monster_index ]= sectors_first_monster_[ sector_index ];
+	sectors_first_monster_[ sector_index ]= monster_index;
+}
+
+void mx_Level::UnlinkMonsterFromSector( unsigned int monster_index )
+{
+	unsigned int sector_index= &monsters_[ monster_index ]->GetSector() - level_data_.sectors;
+	unsigned int* link= &sectors_first_monster_[ sector_index ];
+	while( *link != monster_index )
+	{
+		MX_ASSERT( *link != MX_NO_MONSTER );
+		link= &monsters_next_in_sector_[ *link ];
+	}
+	*link= monsters_next_in_sector_[ monster_index ];
+}
+
+unsigned int mx_Level::FindMonstersInBox( const float* bb_min, const float* bb_max, mx_Monster** out_monsters ) const
+{
+	int cells_min[3], cells_max[3];
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		cells_min[j]= ( int(std::floor( bb_min[j] )) >> MX_SECTORS_GRID_CELL_SIZE_LOG2 ) - sectors_grid_origin_[j];
+		cells_max[j]= ( int(std::floor( bb_max[j] )) >> MX_SECTORS_GRID_CELL_SIZE_LOG2 ) - sectors_grid_origin_[j];
+		if( cells_min[j] < 0 ) cells_min[j]= 0;
+		if( cells_max[j] >= sectors_grid_size_[j] ) cells_max[j]= sectors_grid_size_[j] - 1;
+		if( cells_min[j] > cells_max[j] ) return 0;
+	}
+
+	// Sector may touch many cells, so skip duplicates.
+	unsigned int sectors[ MX_MAX_SECTORS_IN_BOX ];
+	unsigned int sector_count= 0;
+	for( int z= cells_min[2]; z <= cells_max[2]; z++ )
+	for( int y= cells_min[1]; y <= cells_max[1]; y++ )
+	for( int x= cells_min[0]; x <= cells_max[0]; x++ )
+	{
+		unsigned int cell= x + sectors_grid_size_[0] * ( y + sectors_grid_size_[1] * z );
+		for( unsigned int i= sectors_grid_cells_offsets_[ cell ]; i < sectors_grid_cells_offsets_[ cell + 1 ]; i++ )
+		{
+			unsigned int sector= sectors_grid_sectors_[i];
+			unsigned int k= 0;
+			while( k < sector_count && sectors[k] != sector ) k++;
+			if( k < sector_count )
+				continue;
+
+			if( sector_count == MX_MAX_SECTORS_IN_BOX )
+			{
+				for( unsigned int m= 0; m < monster_count_; m++ )
+					out_monsters[m]= monsters_[m];
+				return monster_count_;
+			}
+			sectors[ sector_count ]= sector;
+			sector_count++;
+		}
+	}
+
+	unsigned int monster_count= 0;
+	for( unsigned int s= 0; s < sector_count; s++ )
+		for( unsigned int m= sectors_first_monster_[ sectors[s] ]; m != MX_NO_MONSTER; m= monsters_next_in_sector_[m] )
+		{
+			out_monsters[ monster_count ]= monsters_[m];
+			monster_count++;
+		}
+	return monster_count;
+}
+
 void mx_Level::RocketBlast( const float* pos )
 {
 	AddBlast( pos );
 
-	for( unsigned int m= 0; m < monster_count_ + 1; m++ )
+	float bb_min[3], bb_max[3];
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		bb_min[j]= pos[j] - mx_GameConstants::rocket_blast_max_damage_distance;
+		bb_max[j]= pos[j] + mx_GameConstants::rocket_blast_max_damage_distance;
+	}
+	mx_Monster* near_monsters[ MX_MAX_MONSTERS ];
+	unsigned int near_monster_count= FindMonstersInBox( bb_min, bb_max, near_monsters );
+
+	for( unsigned int m= 0; m < near_monster_count + 1; m++ )
 	{
 		mx_Pawn* pawn;
-		if( m == monster_count_ )
+		if( m == near_monster_count )
 			pawn= &player_;
 		else
-			pawn= monsters_[m];
+			pawn= near_monsters[m];
 
 		float square_dist= mxSquareDistance( pos, pawn->Pos() );
 		if( square_dist < mx_GameConstants::rocket_blast_max_damage_distance * mx_GameConstants::rocket_blast_max_damage_distance )
@@ -586,6 +804,10 @@ void mx_Level::AddBlast( const float* pos )
 	mx_SoundEngine::Instance()->AddSingleSound( SoundBlast, 1.0f, 1.0f, pos );
 	particles_manager_->AddBlast( pos );
 
+	// Bullets count is not limited, so blasts may be more, than lights. Extra blasts have no light.
+	if( blast_count_ == MX_MAX_BLAST_LIGHTS )
+		return;
+
 	Blast& blast= blasts_[ blast_count_ ];
 	VEC3_CPY( blast.pos, pos );
 	blast.start_time= mx_MainLoop::Instance()->GetTime();
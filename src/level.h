@@ -1,26 +1,24 @@
 #pragma once
 
+#include "bullet_pool.h"
 #include "drawing_model.h"
 #include "fwd.h"
 #include "game_constants.h"
+#include "level_bvh.h"
 #include "level_generator.h"
+#include "level_pvs.h"
 #include "mx_math.h"
 #include "pawn.h"
 
 #define MX_MAX_MONSTERS 256
-#define MX_MAX_BULLETS 512
 #define MX_MAX_BLAST_LIGHTS 64
 
 #define MX_MAX_HEALTH_PACKS MX_MAX_MONSTERS
 
-struct mx_Bullet
-{
-	BulletType type;
-	mx_Pawn* owner;
-	float pos[3];
-	float speed[3];
-	float birth_time;
-};
+// Cell size of sectors grid for point to sector lookup.
+#define MX_SECTORS_GRID_CELL_SIZE_LOG2 2
+// Sectors limit for local monsters search. If box touches more sectors, all monsters are returned.
+#define MX_MAX_SECTORS_IN_BOX 64
 
 struct mx_HealthPack
 {
@@ -46,8 +44,7 @@ public:
 	const mx_HealthPack* GetHealthPacks() const;
 	unsigned int GetHealthPackCount() const;
 
-	const mx_Bullet* GetBullets() const;
-	unsigned int GetBulletCount() const;
+	const mx_BulletPool& GetBullets() const;
 
 	unsigned int GetBlastLightCount() const;
 	void PrepareBlastLights( mx_Light* out_lights ) const;
@@ -55,8 +52,21 @@ public:
 	const mx_ParticlesManager* GetParticlesManager() const;
 
 	const mx_LevelData& GetLevelData() const;
+	const mx_LevelSector* GetPlayerSpawnSector() const;
+	const mx_LevelPVS& GetPVS() const;
+
+	// Takes new geometry of streamed level. Sectors must be same.
+	void UpdateGeometry( const mx_LevelData& level_data );
+
+	// Hint sector and its connections are checked first. Pass previous sector of moving object as hint.
+	// Callers: player movement and camera of drawing snapshot, both with player sector as hint.
+	// Bullets collide with level through BVH, monsters never leave home sector.
+	const mx_LevelSector* FindSectorForPoint( const float* point, const mx_LevelSector* hint_sector= NULL ) const;
 
-	const mx_LevelSector* FindSectorForPoint( const float* point ) const;
+	// Returns true, if beam hits level geometry not farther, than max_distance. normalized_dir must be normalized.
+	bool BeamIntersectLevel( const float* pos, const float* normalized_dir, float max_distance, float* out_pos_opt= NULL ) const;
+	// Returns true, if there is no level geometry between points.
+	bool IsLineOfSight( const float* from, const float* to ) const;
 
 	bool CollideWithSectorTriangles(
 		float* in_out_pos, float radius,
@@ -82,12 +92,31 @@ private:
 	mx_Level(const mx_Level&);
 	mx_Level& operator=(const mx_Level&);
 
+	void BuildSectorsGrid();
+
+	// Monsters never leave their home sectors, so lists change only on spawn and death.
+	void LinkMonsterToSector( unsigned int monster_index );
+	void UnlinkMonsterFromSector( unsigned int monster_index );
+
+	// Collects monsters of sectors, touching box. Returns monster count.
+	unsigned int FindMonstersInBox( const float* bb_min, const float* bb_max, mx_Monster** out_monsters ) const;
+
+	// Returns true, if bullet hits something on this tick.
+	bool CollideBullet( unsigned int bullet_index, float dt );
 	void RocketBlast( const float* pos );
 	void AddBlast( const float* pos );
 
 private:
 	mx_Player& player_;
-	const mx_LevelData level_data_;
+	mx_LevelData level_data_;
+	mx_LevelBVH bvh_;
+	mx_LevelPVS pvs_;
+
+	// Uniform grid over sectors boxes. Each cell has list of sectors, touching it.
+	int sectors_grid_origin_[3];
+	int sectors_grid_size_[3];
+	unsigned int* sectors_grid_cells_offsets_; // offsets in sectors_grid_sectors_, size - cell count + 1
+	unsigned int* sectors_grid_sectors_;
 
 	mx_Rand randomizer_;
 
@@ -99,11 +128,16 @@ private:
 	unsigned int monster_count_;
 	mx_Monster* monsters_[ MX_MAX_MONSTERS ];
 
+	// Lists of monsters inside each sector. Lists are linked through monster indices.
+	unsigned int* sectors_first_monster_; // size - sector count
+	unsigned int monsters_next_in_sector_[ MX_MAX_MONSTERS ];
+	// Maximum distance from monster position to point of its model.
+	float monsters_max_radius_;
+
 	unsigned int health_pack_count_;
 	mx_HealthPack health_packs_[ MX_MAX_HEALTH_PACKS ];
 
-	unsigned int bullet_count_;
-	mx_Bullet bullets_[ MX_MAX_BULLETS ];
+	mx_BulletPool bullets_;
 
 	unsigned int blast_count_;
 	Blast blasts_[ MX_MAX_BLAST_LIGHTS ];
@@ -151,16 +185,11 @@ inline unsigned int mx_Level::GetHealthPackCount() const
 	return health_pack_count_;
 }
 
-inline const mx_Bullet* mx_Level::GetBullets() const
+inline const mx_BulletPool& mx_Level::GetBullets() const
 {
 	return bullets_;
 }
 
-inline unsigned int mx_Level::GetBulletCount() const
-{
-	return bullet_count_;
-}
-
 inline unsigned int mx_Level::GetBlastLightCount() const
 {
 	return blast_count_;
@@ -174,4 +203,14 @@ inline const mx_ParticlesManager* mx_Level::GetParticlesManager() const
 inline const mx_LevelData& mx_Level::GetLevelData() const
 {
 	return level_data_;
+}
+
+inline const mx_LevelSector* mx_Level::GetPlayerSpawnSector() const
+{
+	return player_sector_;
+}
+
+inline const mx_LevelPVS& mx_Level::GetPVS() const
+{
+	return pvs_;
 }
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include <cmath>
+#include <cstring>
+
+#include "game_constants.h"
+#include "level_generator.h"
+#include "mx_assert.h"
+#include "mx_math.h"
+
+#include "level_bvh.h"
+
+#define MX_BVH_TREE_NOT_BUILT 0xFFFFFFFF
+#define MX_BVH_EMPTY_TREE 0xFFFFFFFE
+
+template<class T>
+static void ReserveArray( T*& data, unsigned int count, unsigned int* in_out_capacity, unsigned int required_capacity )
+{
+	if( required_capacity <= *in_out_capacity )
+		return;
+
+	unsigned int new_capacity= *in_out_capacity * 2;
+	if( new_capacity < required_capacity ) new_capacity= required_capacity;
+
+	T* new_data= new T[ new_capacity ];
+	if( count > 0 )
+		std::memcpy( new_data, data, sizeof(T) * count );
+	delete[] data;
+
+	data= new_data;
+	*in_out_capacity= new_capacity;
+}
+
+mx_LevelBVH::mx_LevelBVH( const mx_LevelData& level_data )
+	: level_data_(&level_data)
+	, sectors_trees_roots_(new unsigned int[ level_data.sector_count ])
+	, nodes_(NULL), node_count_(0), nodes_capacity_(0)
+	, triangle_packs_(NULL), triangle_pack_count_(0), triangle_packs_capacity_(0)
+{
+	unsigned int sector_count= level_data.sector_count;
+	MX_ASSERT( sector_count > 0 );
+
+	float* sectors_bb_min= new float[ sector_count * 3 ];
+	float* sectors_bb_max= new float[ sector_count * 3 ];
+	sectors_indices_= new unsigned int[ sector_count ];
+	sectors_nodes_= new mx_BVHNode[ sector_count * 2 ];
+
+	for( unsigned int s= 0; s < sector_count; s++ )
+	{
+		VEC3_CPY( sectors_bb_min + s * 3, level_data.sectors[s].bb_min );
+		VEC3_CPY( sectors_bb_max + s * 3, level_data.sectors[s].bb_max );
+		sectors_indices_[s]= s;
+		sectors_trees_roots_[s]= MX_BVH_TREE_NOT_BUILT;
+	}
+
+	unsigned int sectors_node_count= 0;
+	sectors_root_= mxBVHBuildTree(
+		sectors_bb_min, sectors_bb_max,
+		sectors_indices_, 0, sector_count, MX_BVH_LEAF_SECTORS, 0,
+		sectors_nodes_, &sectors_node_count );
+
+	delete[] sectors_bb_min;
+	delete[] sectors_bb_max;
+}
+
+mx_LevelBVH::~mx_LevelBVH()
+{
+	delete[] sectors_nodes_;
+	delete[] sectors_indices_;
+	delete[] sectors_trees_roots_;
+	delete[] nodes_;
+	delete[] triangle_packs_;
+}
+
+void mx_LevelBVH::InvalidateGeometry( const mx_LevelData& level_data )
+{
+	MX_ASSERT( level_data.sectors == level_data_->sectors );
+	level_data_= &level_data;
+
+	for( unsigned int s= 0; s < level_data.sector_count; s++ )
+		sectors_trees_roots_[s]= MX_BVH_TREE_NOT_BUILT;
+	node_count_= 0;
+	triangle_pack_count_= 0;
+}
+
+bool mx_LevelBVH::BeamIntersect( const float* beam_point, const float* beam_dir, float max_distance, float* out_distance_opt ) const
+{
+	mx_BVHBeam beam;
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		beam.point[j]= beam_point[j];
+		beam.dir[j]= beam_dir[j];
+	}
+	beam.max_distance= max_distance;
+	beam.any_hit= false;
+
+	if( !BeamIntersectImpl( beam ) )
+		return false;
+
+	if( out_distance_opt != NULL ) *out_distance_opt= beam.max_distance;
+	return true;
+}
+
+void mx_LevelBVH::BuildSectorTree( unsigned int sector_index ) const
+{
+	const mx_LevelSector& sector= level_data_->sectors[ sector_index ];
+	unsigned int triangle_count= sector.triangles_count;
+	if( triangle_count == 0 )
+	{
+		sectors_trees_roots_[ sector_index ]= MX_BVH_EMPTY_TREE;
+		return;
+	}
+
+	// Tree has less, than 2 * triangle_count nodes and not more, than triangle_count leafs.
+	ReserveArray( nodes_, node_count_, &nodes_capacity_, node_count_ + triangle_count * 2 );
+	ReserveArray( triangle_packs_, triangle_pack_count_, &triangle_packs_capacity_, triangle_pack_count_ + triangle_count );
+
+	float* triangles_vertices= new float[ triangle_count * 9 ];
+
+	const mx_LevelTriangle* triangles= level_data_->triangles + sector.first_triangle;
+	const mx_LevelVertex* vertices= level_data_->vertices;
+	for( unsigned int t= 0; t < triangle_count; t++ )
+	{
+		for( unsigned int v= 0; v < 3; v++ )
+		{
+			VEC3_CPY( triangles_vertices + t * 9 + v * 3, vertices[ triangles[t].vertex_index[v] ].xyz );
+		}
+	}
+
+	sectors_trees_roots_[ sector_index ]= mxBVHBuildTrianglesTree(
+		triangles_vertices, triangle_count,
+		nodes_, &node_count_,
+		triangle_packs_, &triangle_pack_count_ );
+
+	delete[] triangles_vertices;
+}
+
+bool mx_LevelBVH::BeamIntersectSectorsLeaf( void* context, mx_BVHBeam& beam, const mx_BVHNode& leaf )
+{
+	const mx_LevelBVH* bvh= (const mx_LevelBVH*) context;
+
+	bool hit= false;
+	for( unsigned int i= leaf.first; i < leaf.first + leaf.count; i++ )
+	{
+		unsigned int sector_index= bvh->sectors_indices_[i];
+		if( bvh->sectors_trees_roots_[ sector_index ] == MX_BVH_TREE_NOT_BUILT )
+			bvh->BuildSectorTree( sector_index );
+
+		unsigned int root= bvh->sectors_trees_roots_[ sector_index ];
+		if( root != MX_BVH_EMPTY_TREE && mxBVHTraverseTrianglesTree( beam, bvh->nodes_, root, bvh->triangle_packs_ ) )
+		{
+			hit= true;
+			if( beam.any_hit ) break;
+		}
+	}
+	return hit;
+}
+
+bool mx_LevelBVH::BeamIntersectImpl( mx_BVHBeam& beam ) const
+{
+	mxBVHPrepareBeam( beam );
+	return mxBVHTraverse( beam, sectors_nodes_, sectors_root_, BeamIntersectSectorsLeaf, (void*) this );
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+#include "bvh.h"
+#include "fwd.h"
+
+// Sectors count in leaf of sectors tree.
+#define MX_BVH_LEAF_SECTORS 2
+
+// Two-level bounding volumes hierarchy of level geometry, for beam casts.
+// Top level - tree of sectors bounding boxes. It built once, because sectors never change.
+// Bottom level - tree of triangles for each sector. Streamed geometry changes, so sector trees
+// are built on demand, at first beam cast into sector after geometry change.
+class mx_LevelBVH
+{
+public:
+	explicit mx_LevelBVH( const mx_LevelData& level_data );
+	~mx_LevelBVH();
+
+	// Call after change of level geometry. Level data must have same sectors.
+	void InvalidateGeometry( const mx_LevelData& level_data );
+
+	// Returns true, if beam hits level triangle on distance not greater, than max_distance. Triangles are two-sided.
+	// beam_dir must be normalized. out_distance_opt - distance to nearest hit.
+	bool BeamIntersect( const float* beam_point, const float* beam_dir, float max_distance, float* out_distance_opt= NULL ) const;
+
+	// Same as BeamIntersect, but stops at any hit. Use it for visibility checks.
+	bool BeamIntersectAny( const float* beam_point, const float* beam_dir, float max_distance ) const;
+
+private:
+	mx_LevelBVH( const mx_LevelBVH& );
+	mx_LevelBVH& operator=( const mx_LevelBVH& );
+
+	// Leaf callback of sectors tree. Traverses trees of leaf sectors. context - this.
+	static bool BeamIntersectSectorsLeaf( void* context, mx_BVHBeam& beam, const mx_BVHNode& leaf );
+
+	void BuildSectorTree( unsigned int sector_index ) const;
+
+	// Returns true, if hit found. beam.max_distance decreased to hit distance.
+	bool BeamIntersectImpl( mx_BVHBeam& beam ) const;
+
+private:
+	const mx_LevelData* level_data_;
+
+	mx_BVHNode* sectors_nodes_;
+	unsigned int* sectors_indices_;
+	unsigned int sectors_root_;
+
+	// Trees of sectors. Storage grows, if needed, and cleared in geometry invalidation.
+	mutable unsigned int* sectors_trees_roots_;
+	mutable mx_BVHNode* nodes_;
+	mutable unsigned int node_count_;
+	mutable unsigned int nodes_capacity_;
+	mutable mx_BVHTrianglePack* triangle_packs_;
+	mutable unsigned int triangle_pack_count_;
+	mutable unsigned int triangle_packs_capacity_;
+};
+
+inline bool mx_LevelBVH::BeamIntersectAny( const float* beam_point, const float* beam_dir, float max_distance ) const
+{
+	mx_BVHBeam beam;
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		beam.point[j]= beam_point[j];
+		beam.dir[j]= beam_dir[j];
+	}
+	beam.max_distance= max_distance;
+	beam.any_hit= true;
+	return BeamIntersectImpl( beam );
+}
\ No newline at end of file
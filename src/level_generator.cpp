@@ -1,6 +1,8 @@
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 
+#include "mesh_optimization.h"
 #include "mx_assert.h"
 #include "textures_generation.h"
 
@@ -35,14 +37,6 @@ unsigned int mxGenSectorGraphTraverseId()
 	return id;
 }
 
-static bool IsPointOutsideMap( int* coord )
-{
-	return
-	coord[0] < 0 || coord[0] >= MX_MAX_LEVEL_SIZE_CELLS ||
-	coord[1] < 0 || coord[1] >= MX_MAX_LEVEL_SIZE_CELLS ||
-	coord[2] < 0 || coord[2] >= MX_MAX_LEVEL_SIZE_CELLS;;
-}
-
 static void GenQuadIndexation( mx_LevelTriangle* quad_triangles, unsigned int base_vertex )
 {
 	quad_triangles[0].vertex_index[0]= (base_vertex    );
@@ -64,23 +58,50 @@ static const void SwapVertices( float* v0, float* v1 )
 	}
 }
 
-mx_LevelGenerator::mx_LevelGenerator( unsigned int seed )
-	: room_count_(0)
+mx_LevelGenerator::mx_LevelGenerator( unsigned int seed, unsigned int level_size_cells )
+	: level_size_cells_(level_size_cells)
+	, bricks_per_side_( ( level_size_cells + MX_LEVEL_BRICK_SIZE - 1 ) >> MX_LEVEL_BRICK_SIZE_LOG2 )
+	, room_chunks_(NULL)
+	, room_chunk_count_(0)
+	, room_count_(0)
+	, connection_chunks_(NULL)
+	, connection_chunk_count_(0)
 	, connection_count_(0)
+	, sectors_info_(NULL)
 	, rand_(seed)
 {
-	for( unsigned int i= 0; i < MX_MAX_LEVEL_SIZE_CELLS * MX_MAX_LEVEL_SIZE_CELLS * MX_MAX_LEVEL_SIZE_CELLS; i++ )
-		element_map_[i]= NULL;
-
-	for( unsigned int i= 0; i < MX_MAX_ROOMS; i++ )
-		rooms_[i].type= Element::ROOM;
-
-	for( unsigned int i= 0; i < MX_MAX_CONNECTIONS; i++ )
-		connections_[i].type= Element::CONNECTION;
+	MX_ASSERT( level_size_cells_ >= MX_MIN_LEVEL_SIZE_CELLS && level_size_cells_ <= MX_MAX_LEVEL_SIZE_CELLS );
+	MX_ASSERT( level_size_cells_ > MX_MAX_ROOM_SIZE + 2 );
+	MX_ASSERT( level_size_cells_ > MX_CENTRAL_ROOM_HALF_SIZE * 2 );
+
+	double volume_scale=
+		double(level_size_cells) * double(level_size_cells) * double(level_size_cells) /
+		double( MX_DEFAULT_LEVEL_SIZE_CELLS * MX_DEFAULT_LEVEL_SIZE_CELLS * MX_DEFAULT_LEVEL_SIZE_CELLS );
+	max_room_count_= (unsigned int)( double(MX_MAX_ROOMS) * volume_scale );
+	max_connection_count_= (unsigned int)( double(MX_MAX_CONNECTIONS) * volume_scale );
+	if( max_room_count_ < 1 ) max_room_count_= 1;
+
+	unsigned int brick_count= bricks_per_side_ * bricks_per_side_ * bricks_per_side_;
+	bricks_= new Brick*[ brick_count ];
+	for( unsigned int i= 0; i < brick_count; i++ )
+		bricks_[i]= NULL;
 }
 
 mx_LevelGenerator::~mx_LevelGenerator()
 {
+	for( int i= 0; i < bricks_per_side_ * bricks_per_side_ * bricks_per_side_; i++ )
+		delete bricks_[i];
+	delete[] bricks_;
+
+	for( unsigned int i= 0; i < room_chunk_count_; i++ )
+		delete[] room_chunks_[i];
+	delete[] room_chunks_;
+
+	for( unsigned int i= 0; i < connection_chunk_count_; i++ )
+		delete[] connection_chunks_[i];
+	delete[] connection_chunks_;
+
+	delete[] sectors_info_;
 }
 
 void mx_LevelGenerator::Generate()
@@ -92,10 +113,85 @@ void mx_LevelGenerator::Generate()
 	PlaceConnections();
 	CalculateLinkage();
 
-	GenerateMeshes();
-	CalculateNormals();
-	CalculateTextureCoordinates();
-	SetupTextures();
+	out_level_data_.vertices_capacity= room_count_ * 4 * 6 + connection_count_ * 4 * 6;
+	out_level_data_.triangles_capacity= room_count_ * 2 * 6 + connection_count_ * 2 * 6;
+	out_level_data_.vertices= new mx_LevelVertex[ out_level_data_.vertices_capacity ];
+	out_level_data_.triangles= new mx_LevelTriangle[ out_level_data_.triangles_capacity ];
+
+	CreateSectors();
+	SetupSectorsTextures();
+
+	for( unsigned int s= 0; s < out_level_data_.sector_count; s++ )
+		sectors_info_[s].hops= 0;
+	BuildGeometry();
+}
+
+void mx_LevelGenerator::GenerateLayout()
+{
+	MX_ASSERT( room_count_ == 0 );
+	MX_ASSERT( connection_count_ == 0 );
+
+	PlaceRooms();
+	PlaceConnections();
+	CalculateLinkage();
+
+	out_level_data_.vertices_capacity= 0;
+	out_level_data_.triangles_capacity= 0;
+	out_level_data_.vertices= NULL;
+	out_level_data_.triangles= NULL;
+
+	CreateSectors();
+	SetupSectorsTextures();
+
+	for( unsigned int s= 0; s < out_level_data_.sector_count; s++ )
+		sectors_info_[s].hops= MX_SECTOR_WITHOUT_GEOMETRY;
+	BuildGeometry();
+}
+
+bool mx_LevelGenerator::UpdateGeometry( const mx_LevelSector* sector )
+{
+	if( sector == NULL )
+		return false;
+
+	unsigned int sector_index= sector - out_level_data_.sectors;
+	MX_ASSERT( sector_index < out_level_data_.sector_count );
+
+	// Enough geometry around sector.
+	if( sectors_info_[ sector_index ].hops <= MX_STREAMING_GEOMETRY_HOPS - MX_STREAMING_MIN_HOPS_TO_BORDER )
+		return false;
+
+	// Breadth-first search in sectors graph, starting from new center.
+	for( unsigned int s= 0; s < out_level_data_.sector_count; s++ )
+		sectors_info_[s].hops= MX_SECTOR_WITHOUT_GEOMETRY;
+
+	unsigned int* queue= new unsigned int[ out_level_data_.sector_count ];
+	unsigned int queue_begin= 0, queue_end= 0;
+
+	sectors_info_[ sector_index ].hops= 0;
+	queue[ queue_end++ ]= sector_index;
+	while( queue_begin < queue_end )
+	{
+		unsigned int s= queue[ queue_begin++ ];
+		unsigned int hops= sectors_info_[s].hops;
+		if( hops == MX_STREAMING_GEOMETRY_HOPS )
+			continue;
+
+		const mx_LevelSector& current_sector= out_level_data_.sectors[s];
+		for( unsigned int i= 0; i < current_sector.connections_count; i++ )
+		{
+			unsigned int next= current_sector.connections[i] - out_level_data_.sectors;
+			if( sectors_info_[ next ].hops == MX_SECTOR_WITHOUT_GEOMETRY )
+			{
+				sectors_info_[ next ].hops= hops + 1;
+				queue[ queue_end++ ]= next;
+			}
+		}
+	}
+
+	delete[] queue;
+
+	BuildGeometry();
+	return true;
 }
 
 const mx_LevelData& mx_LevelGenerator::GetLevelData()
@@ -103,81 +199,185 @@ const mx_LevelData& mx_LevelGenerator::GetLevelData()
 	return out_level_data_;
 }
 
-mx_LevelGenerator::Element*& mx_LevelGenerator::ElementMap( int x, int y, int z )
+bool mx_LevelGenerator::IsPointOutsideMap( const int* coord ) const
 {
-	MX_ASSERT( x >= 0 && x < MX_MAX_LEVEL_SIZE_CELLS );
-	MX_ASSERT( y >= 0 && y < MX_MAX_LEVEL_SIZE_CELLS );
-	MX_ASSERT( z >= 0 && z < MX_MAX_LEVEL_SIZE_CELLS );
+	return
+	coord[0] < 0 || coord[0] >= level_size_cells_ ||
+	coord[1] < 0 || coord[1] >= level_size_cells_ ||
+	coord[2] < 0 || coord[2] >= level_size_cells_;
+}
 
-	return element_map_[ x + y * MX_MAX_LEVEL_SIZE_CELLS + z * MX_MAX_LEVEL_SIZE_CELLS * MX_MAX_LEVEL_SIZE_CELLS ];
+mx_LevelGenerator::Brick* mx_LevelGenerator::GetOrCreateBrick( int brick_x, int brick_y, int brick_z )
+{
+	Brick*& brick= bricks_[ brick_x + ( brick_y + brick_z * bricks_per_side_ ) * bricks_per_side_ ];
+	if( brick == NULL )
+	{
+		brick= new Brick;
+		std::memset( brick->occupancy, 0, sizeof(brick->occupancy) );
+		std::memset( brick->elements, 0, sizeof(brick->elements) );
+	}
+	return brick;
+}
+
+void mx_LevelGenerator::SetElement( int x, int y, int z, Element* element )
+{
+	MX_ASSERT( x >= 0 && x < level_size_cells_ );
+	MX_ASSERT( y >= 0 && y < level_size_cells_ );
+	MX_ASSERT( z >= 0 && z < level_size_cells_ );
+	MX_ASSERT( element != NULL );
+
+	Brick* brick= GetOrCreateBrick( x >> MX_LEVEL_BRICK_SIZE_LOG2, y >> MX_LEVEL_BRICK_SIZE_LOG2, z >> MX_LEVEL_BRICK_SIZE_LOG2 );
+
+	const int c_mask= MX_LEVEL_BRICK_SIZE - 1;
+	brick->elements[ BrickCellIndex( x, y, z ) ]= element;
+	brick->occupancy[ z & c_mask ][ y & c_mask ]|= (unsigned char)( 1 << ( x & c_mask ) );
+}
+
+bool mx_LevelGenerator::IsRegionFree( const int* coord_min, const int* coord_max ) const
+{
+	for( int bz= coord_min[2] >> MX_LEVEL_BRICK_SIZE_LOG2; bz <= ( coord_max[2] - 1 ) >> MX_LEVEL_BRICK_SIZE_LOG2; bz++ )
+	for( int by= coord_min[1] >> MX_LEVEL_BRICK_SIZE_LOG2; by <= ( coord_max[1] - 1 ) >> MX_LEVEL_BRICK_SIZE_LOG2; by++ )
+	for( int bx= coord_min[0] >> MX_LEVEL_BRICK_SIZE_LOG2; bx <= ( coord_max[0] - 1 ) >> MX_LEVEL_BRICK_SIZE_LOG2; bx++ )
+	{
+		const Brick* brick= GetBrick( bx, by, bz );
+		if( brick == NULL )
+			continue;
+
+		// Region part inside brick, in brick cells.
+		int brick_min[3], brick_max[3];
+		int brick_coord[3]= { bx, by, bz };
+		for( unsigned int j= 0; j < 3; j++ )
+		{
+			brick_min[j]= std::max( coord_min[j] - ( brick_coord[j] << MX_LEVEL_BRICK_SIZE_LOG2 ), 0 );
+			brick_max[j]= std::min( coord_max[j] - ( brick_coord[j] << MX_LEVEL_BRICK_SIZE_LOG2 ), MX_LEVEL_BRICK_SIZE );
+		}
+
+		unsigned char row_mask= (unsigned char)( ( ( 1 << brick_max[0] ) - 1 ) & ~( ( 1 << brick_min[0] ) - 1 ) );
+		for( int z= brick_min[2]; z < brick_max[2]; z++ )
+		for( int y= brick_min[1]; y < brick_max[1]; y++ )
+			if( ( brick->occupancy[z][y] & row_mask ) != 0 )
+				return false;
+	}
+
+	return true;
+}
+
+void mx_LevelGenerator::FillRegion( const int* coord_min, const int* coord_max, Element* element )
+{
+	for( int z= coord_min[2]; z < coord_max[2]; z++ )
+	for( int y= coord_min[1]; y < coord_max[1]; y++ )
+	for( int x= coord_min[0]; x < coord_max[0]; x++ )
+		SetElement( x, y, z, element );
+}
+
+mx_LevelGenerator::Room* mx_LevelGenerator::GetRoom( unsigned int index )
+{
+	unsigned int chunk_index= index / MX_LEVEL_ELEMENTS_CHUNK_SIZE;
+	if( chunk_index >= room_chunk_count_ )
+	{
+		MX_ASSERT( chunk_index == room_chunk_count_ );
+
+		Room** new_chunks= new Room*[ room_chunk_count_ + 1 ];
+		if( room_chunk_count_ > 0 )
+			std::memcpy( new_chunks, room_chunks_, sizeof(Room*) * room_chunk_count_ );
+		delete[] room_chunks_;
+		room_chunks_= new_chunks;
+
+		Room* chunk= new Room[ MX_LEVEL_ELEMENTS_CHUNK_SIZE ];
+		for( unsigned int i= 0; i < MX_LEVEL_ELEMENTS_CHUNK_SIZE; i++ )
+		{
+			chunk[i].type= Element::ROOM;
+			chunk[i].index= room_chunk_count_ * MX_LEVEL_ELEMENTS_CHUNK_SIZE + i;
+		}
+		room_chunks_[ room_chunk_count_++ ]= chunk;
+	}
+
+	return room_chunks_[ chunk_index ] + index % MX_LEVEL_ELEMENTS_CHUNK_SIZE;
+}
+
+mx_LevelGenerator::Connection* mx_LevelGenerator::GetConnection( unsigned int index )
+{
+	unsigned int chunk_index= index / MX_LEVEL_ELEMENTS_CHUNK_SIZE;
+	if( chunk_index >= connection_chunk_count_ )
+	{
+		MX_ASSERT( chunk_index == connection_chunk_count_ );
+
+		Connection** new_chunks= new Connection*[ connection_chunk_count_ + 1 ];
+		if( connection_chunk_count_ > 0 )
+			std::memcpy( new_chunks, connection_chunks_, sizeof(Connection*) * connection_chunk_count_ );
+		delete[] connection_chunks_;
+		connection_chunks_= new_chunks;
+
+		Connection* chunk= new Connection[ MX_LEVEL_ELEMENTS_CHUNK_SIZE ];
+		for( unsigned int i= 0; i < MX_LEVEL_ELEMENTS_CHUNK_SIZE; i++ )
+		{
+			chunk[i].type= Element::CONNECTION;
+			chunk[i].index= connection_chunk_count_ * MX_LEVEL_ELEMENTS_CHUNK_SIZE + i;
+		}
+		connection_chunks_[ connection_chunk_count_++ ]= chunk;
+	}
+
+	return connection_chunks_[ chunk_index ] + index % MX_LEVEL_ELEMENTS_CHUNK_SIZE;
 }
 
 void mx_LevelGenerator::PlaceRooms()
 {
-	Room* room= rooms_;
+	Room* room= GetRoom(0);
 
 	{ // Place central room
 		for( unsigned int j= 0; j < 3; j++ )
 		{
-			room->coord_min[j]= MX_MAX_LEVEL_SIZE_CELLS / 2 - MX_CENTRAL_ROOM_HALF_SIZE;
-			room->coord_max[j]= MX_MAX_LEVEL_SIZE_CELLS / 2 + MX_CENTRAL_ROOM_HALF_SIZE;
+			room->coord_min[j]= level_size_cells_ / 2 - MX_CENTRAL_ROOM_HALF_SIZE;
+			room->coord_max[j]= level_size_cells_ / 2 + MX_CENTRAL_ROOM_HALF_SIZE;
 		}
-		for( int z= room->coord_min[2]; z < room->coord_max[2]; z++ )
-		for( int y= room->coord_min[1]; y < room->coord_max[1]; y++ )
-		for( int x= room->coord_min[0]; x < room->coord_max[0]; x++ )
-			ElementMap( x, y, z )= room;
+		FillRegion( room->coord_min, room->coord_max, room );
 
 		room->connection_count= 0;
-		room++;
 		room_count_++;
 	}
 
-	for( unsigned int i= 1; i < MX_MAX_ROOMS * 2; i++ )
+	if( room_count_ == max_room_count_ ) return;
+
+	for( unsigned int i= 1; i < max_room_count_ * 2; i++ )
 	{
+		room= GetRoom( room_count_ );
+
 		// Create room
 		for( unsigned int j= 0; j < 3; j++ )
 		{
-			room->coord_min[j]= rand_.RandI( 1, MX_MAX_LEVEL_SIZE_CELLS - MX_MAX_ROOM_SIZE - 1 );
+			room->coord_min[j]= rand_.RandI( 1, level_size_cells_ - MX_MAX_ROOM_SIZE - 1 );
 			room->coord_max[j]= room->coord_min[j] + rand_.RandI( MX_MIN_ROOM_SIZE, MX_MAX_ROOM_SIZE + 1 );
 
-			MX_ASSERT( room->coord_min[j] >= 1 && room->coord_min[j] < MX_MAX_LEVEL_SIZE_CELLS - 1 );
-			MX_ASSERT( room->coord_max[j] >= 1 && room->coord_max[j] < MX_MAX_LEVEL_SIZE_CELLS - 1 );
+			MX_ASSERT( room->coord_min[j] >= 1 && room->coord_min[j] < level_size_cells_ - 1 );
+			MX_ASSERT( room->coord_max[j] >= 1 && room->coord_max[j] < level_size_cells_ - 1 );
 		}
 
 		// Check free space
-		for( int z= std::max( 0, room->coord_min[2] - MX_MIN_ROOM_DISTANCE );
-			z < std::min( MX_MAX_LEVEL_SIZE_CELLS, room->coord_max[2] + MX_MIN_ROOM_DISTANCE );
-			z++ )
-		for( int y= std::max( 0, room->coord_min[1] - MX_MIN_ROOM_DISTANCE );
-			y < std::min( MX_MAX_LEVEL_SIZE_CELLS, room->coord_max[1] + MX_MIN_ROOM_DISTANCE );
-			y++ )
-		for( int x= std::max( 0, room->coord_min[0] - MX_MIN_ROOM_DISTANCE );
-			x < std::min( MX_MAX_LEVEL_SIZE_CELLS, room->coord_max[0] + MX_MIN_ROOM_DISTANCE );
-			x++ )
-			if( ElementMap( x, y, z ) != NULL )
-				goto failed;
+		int check_min[3], check_max[3];
+		for( unsigned int j= 0; j < 3; j++ )
+		{
+			check_min[j]= std::max( 0, room->coord_min[j] - MX_MIN_ROOM_DISTANCE );
+			check_max[j]= std::min( level_size_cells_, room->coord_max[j] + MX_MIN_ROOM_DISTANCE );
+		}
+		if( !IsRegionFree( check_min, check_max ) )
+			continue;
 
 		// Mark space for this room
-		for( int z= room->coord_min[2]; z < room->coord_max[2]; z++ )
-		for( int y= room->coord_min[1]; y < room->coord_max[1]; y++ )
-		for( int x= room->coord_min[0]; x < room->coord_max[0]; x++ )
-			ElementMap( x, y, z )= room;
+		FillRegion( room->coord_min, room->coord_max, room );
 
 		room->connection_count= 0;
 
-		room++;
 		room_count_++;
-		if( room_count_ == MX_MAX_ROOMS ) break;
-	failed:;
+		if( room_count_ == max_room_count_ ) break;
 	}
 }
 
 void mx_LevelGenerator::PlaceConnections()
 {
 	// Try place X or Y connections for random room
-	for( unsigned int r=0; r < room_count_ * 256 && connection_count_ < MX_MAX_CONNECTIONS; r++ )
+	for( unsigned int r=0; r < room_count_ * 256 && connection_count_ < max_connection_count_; r++ )
 	{
-		Room* room= rooms_ + rand_.Rand() % room_count_;
+		Room* room= GetRoom( rand_.Rand() % room_count_ );
 		if( room->connection_count == MX_MAX_ROOM_CONNECTIONS ) continue;
 
 		int coord[3];
@@ -231,59 +431,22 @@ void mx_LevelGenerator::PlaceConnections()
 
 bool mx_LevelGenerator::TryPlaceConnection( Room* room, const int* begin_coord, const int* direction )
 {
-	MX_ASSERT( connection_count_ < MX_MAX_CONNECTIONS );
+	MX_ASSERT( connection_count_ < max_connection_count_ );
 	MX_ASSERT( room->connection_count < MX_MAX_ROOM_CONNECTIONS );
 
 	int coord[3]= { begin_coord[0], begin_coord[1], begin_coord[2] };
 
+	unsigned int axis= direction[0] != 0 ? 0 : ( direction[1] != 0 ? 1 : 2 );
+	unsigned int side_axis0= ( axis + 1 ) % 3;
+	unsigned int side_axis1= ( axis + 2 ) % 3;
+	const int c_brick_mask= MX_LEVEL_BRICK_SIZE - 1;
+
+	// Way is checked by segments up to brick border. Cells of segment and their side cells lie in same bricks.
 	while( !IsPointOutsideMap(coord) )
 	{
-		Element* element= ElementMap( coord[0], coord[1], coord[2] );
-		if( element != NULL )
-		{
-			if( element->type == Element::ROOM )
-			{
-				Room* end_room= static_cast<Room*>(element);
-				if( end_room->connection_count == MX_MAX_ROOM_CONNECTIONS ) return false;
-				if( CheckConnection( room, end_room ) ) return false;
-
-				Connection* connection= connections_ + connection_count_;
-				connection_count_++;
-
-				connection->begin= room;
-				connection->end= (Room*) element;
-				for( unsigned int i= 0; i < 3; i++ )
-				{
-					connection->coord_begin[i]= begin_coord[i];
-					connection->coord_end[i]= coord[i] - direction[i];
-				}
-
-				room->connections[ room->connection_count++ ]= connection;
-				end_room->connections[ end_room->connection_count++ ]= connection;
-
-				coord[0]= connection->coord_begin[0];
-				coord[1]= connection->coord_begin[1];
-				coord[2]= connection->coord_begin[2];
-				while( !(
-					coord[0] == connection->coord_end[0] &&
-					coord[1] == connection->coord_end[1] &&
-					coord[2] == connection->coord_end[2] ) )
-				{
-					MX_ASSERT( !IsPointOutsideMap(coord) );
-					ElementMap( coord[0], coord[1], coord[2] )= connection;
-					coord[0]+= direction[0];
-					coord[1]+= direction[1];
-					coord[2]+= direction[2];
-				}
-				ElementMap( connection->coord_end[0], connection->coord_end[1], connection->coord_end[2] )= connection;
-				return true;
-			}
-			else
-			{
-				MX_ASSERT( element->type == Element::CONNECTION );
-				break;
-			}
-		}
+		int segment_last= direction[axis] > 0
+			? std::min( coord[axis] | c_brick_mask, level_size_cells_ - 1 )
+			: coord[axis] & ~c_brick_mask;
 
 		int side_cells[4][3];
 		for( unsigned int i= 0; i < 4; i++ )
@@ -292,55 +455,118 @@ bool mx_LevelGenerator::TryPlaceConnection( Room* room, const int* begin_coord,
 			side_cells[i][1]= coord[1];
 			side_cells[i][2]= coord[2];
 		}
-		if( std::abs(direction[0]) == 1 )
-		{
-			side_cells[0][1] -= 1;
-			side_cells[1][1] += 1;
-			side_cells[2][2] -= 1;
-			side_cells[3][2] += 1;
-		}
-		else if( std::abs(direction[1]) == 1 )
+		side_cells[0][ side_axis0 ] -= 1;
+		side_cells[1][ side_axis0 ] += 1;
+		side_cells[2][ side_axis1 ] -= 1;
+		side_cells[3][ side_axis1 ] += 1;
+
+		const Brick* brick= GetBrick( coord[0] >> MX_LEVEL_BRICK_SIZE_LOG2, coord[1] >> MX_LEVEL_BRICK_SIZE_LOG2, coord[2] >> MX_LEVEL_BRICK_SIZE_LOG2 );
+		const Brick* side_bricks[4];
+		bool segment_is_empty= brick == NULL;
+		for( unsigned int i= 0; i < 4; i++ )
 		{
-			side_cells[0][0] -= 1;
-			side_cells[1][0] += 1;
-			side_cells[2][2] -= 1;
-			side_cells[3][2] += 1;
+			if( IsPointOutsideMap( side_cells[i] ) )
+				side_bricks[i]= NULL;
+			else
+				side_bricks[i]= GetBrick(
+					side_cells[i][0] >> MX_LEVEL_BRICK_SIZE_LOG2,
+					side_cells[i][1] >> MX_LEVEL_BRICK_SIZE_LOG2,
+					side_cells[i][2] >> MX_LEVEL_BRICK_SIZE_LOG2 );
+			segment_is_empty= segment_is_empty && side_bricks[i] == NULL;
 		}
-		else
+
+		if( segment_is_empty )
 		{
-			side_cells[0][0] -= 1;
-			side_cells[1][0] += 1;
-			side_cells[2][1] -= 1;
-			side_cells[3][1] += 1;
+			coord[axis]= segment_last + direction[axis];
+			continue;
 		}
 
-		for( unsigned int i= 0; i< 4; i++ )
+		while(true)
 		{
-			if( IsPointOutsideMap( side_cells[i] ) )
-				continue;
-			if( ElementMap( side_cells[i][0], side_cells[i][1], side_cells[i][2] ) != NULL )
-				return false;
+			Element* element= brick == NULL ? NULL : brick->elements[ BrickCellIndex( coord[0], coord[1], coord[2] ) ];
+			if( element != NULL )
+			{
+				if( element->type == Element::ROOM )
+				{
+					Room* end_room= static_cast<Room*>(element);
+					if( end_room->connection_count == MX_MAX_ROOM_CONNECTIONS ) return false;
+					if( CheckConnection( room, end_room ) ) return false;
+
+					int end_coord[3];
+					for( unsigned int i= 0; i < 3; i++ )
+						end_coord[i]= coord[i] - direction[i];
+					AddConnection( room, end_room, begin_coord, end_coord, direction );
+					return true;
+				}
+				else
+				{
+					MX_ASSERT( element->type == Element::CONNECTION );
+					return false;
+				}
+			}
+
+			for( unsigned int i= 0; i< 4; i++ )
+			{
+				if( side_bricks[i] != NULL &&
+					side_bricks[i]->elements[ BrickCellIndex( side_cells[i][0], side_cells[i][1], side_cells[i][2] ) ] != NULL )
+					return false;
+			}
+
+			if( coord[axis] == segment_last )
+				break;
+			coord[axis]+= direction[axis];
+			for( unsigned int i= 0; i < 4; i++ )
+				side_cells[i][axis]+= direction[axis];
 		}
 
+		coord[axis]+= direction[axis];
+	}
+
+	return false;
+}
+
+void mx_LevelGenerator::AddConnection( Room* begin_room, Room* end_room, const int* begin_coord, const int* end_coord, const int* direction )
+{
+	Connection* connection= GetConnection( connection_count_ );
+	connection_count_++;
+
+	connection->begin= begin_room;
+	connection->end= end_room;
+	for( unsigned int i= 0; i < 3; i++ )
+	{
+		connection->coord_begin[i]= begin_coord[i];
+		connection->coord_end[i]= end_coord[i];
+	}
+
+	begin_room->connections[ begin_room->connection_count++ ]= connection;
+	end_room->connections[ end_room->connection_count++ ]= connection;
+
+	int coord[3]= { begin_coord[0], begin_coord[1], begin_coord[2] };
+	while( !(
+		coord[0] == end_coord[0] &&
+		coord[1] == end_coord[1] &&
+		coord[2] == end_coord[2] ) )
+	{
+		MX_ASSERT( !IsPointOutsideMap(coord) );
+		SetElement( coord[0], coord[1], coord[2], connection );
 		coord[0]+= direction[0];
 		coord[1]+= direction[1];
 		coord[2]+= direction[2];
 	}
-
-	return false;
+	SetElement( end_coord[0], end_coord[1], end_coord[2], connection );
 }
 
 void mx_LevelGenerator::CalculateLinkage()
 {
 	// Initial state - all rooms unlinked
 	for( unsigned int i= 0; i < room_count_; i++ )
-		rooms_[i].linkage_group_id= 0;
+		GetRoom(i)->linkage_group_id= 0;
 
 	unsigned int linkage_id= 1;
 
 	for( unsigned int i= 0; i < room_count_; i++ )
 	{
-		Room* room= rooms_ + i;
+		Room* room= GetRoom(i);
 
 		if( room->linkage_group_id == 0 )
 		{
@@ -356,7 +582,7 @@ void mx_LevelGenerator::CalculateLinkage()
 		linkage_groups[i]= 0;
 
 	for( unsigned int i= 0; i < room_count_; i++ )
-		linkage_groups[ rooms_[i].linkage_group_id ] ++;
+		linkage_groups[ GetRoom(i)->linkage_group_id ] ++;
 
 	MX_ASSERT( linkage_groups[0] == 0 );
 
@@ -399,20 +625,15 @@ bool mx_LevelGenerator::CheckConnection( const Room* room0, const Room* room1 )
 	return false;
 }
 
-void mx_LevelGenerator::GenerateMeshes()
+void mx_LevelGenerator::CreateSectors()
 {
 	out_level_data_.vertex_count= 0;
 	out_level_data_.triangle_count= 0;
 
-	out_level_data_.vertices_capacity= room_count_ * 4 * 6 + connection_count_ * 4 * 6;
-	out_level_data_.triangles_capacity= room_count_ * 2 * 6 + connection_count_ * 2 * 6;
-
-	out_level_data_.vertices= new mx_LevelVertex[ out_level_data_.vertices_capacity ];
-	out_level_data_.triangles= new mx_LevelTriangle[ out_level_data_.triangles_capacity ];
-
 	out_level_data_.icosahedron_count= 0;
 	out_level_data_.sector_count= 0;
 	out_level_data_.sectors= new mx_LevelSector[ room_count_ + connection_count_ ];
+	sectors_info_= new SectorInfo[ room_count_ + connection_count_ ];
 
 	unsigned int* room_to_sector_index= new unsigned int[ room_count_ ];
 	unsigned int* connection_to_sector_index= new unsigned int[ connection_count_ ];
@@ -420,15 +641,13 @@ void mx_LevelGenerator::GenerateMeshes()
 	mx_LevelSector* sector= out_level_data_.sectors;
 	for( unsigned int i= 0; i < room_count_; i++ )
 	{
+		const Room* room= GetRoom(i);
 		// Discard unlinked level parts
-		if( rooms_[i].linkage_group_id == max_linkage_group_id_ )
+		if( room->linkage_group_id == max_linkage_group_id_ )
 		{
-			SetupRoomSector( rooms_ + i, sector );
-
+			SetupRoomSector( room, sector );
 			sector->type= mx_LevelSector::ROOM;
-			sector->first_triangle= out_level_data_.triangle_count;
-			AddRoomCube( rooms_ + i );
-			sector->triangles_count= out_level_data_.triangle_count - sector->first_triangle;
+			sectors_info_[ out_level_data_.sector_count ].element= room;
 
 			room_to_sector_index[i]= out_level_data_.sector_count;
 
@@ -439,16 +658,14 @@ void mx_LevelGenerator::GenerateMeshes()
 
 	for( unsigned int i= 0; i < connection_count_; i++ )
 	{
+		const Connection* connection= GetConnection(i);
 		// Discard unlinked level parts
-		if( connections_[i].begin->linkage_group_id == max_linkage_group_id_ )
+		if( connection->begin->linkage_group_id == max_linkage_group_id_ )
 		{
-			SetupConnectionSector( connections_ + i, sector );
-
+			SetupConnectionSector( connection, sector );
 			sector->type= mx_LevelSector::CONNECTION;
 			sector->has_icosahedron= false;
-			sector->first_triangle= out_level_data_.triangle_count;
-			AddConnectionCube( connections_ + i );
-			sector->triangles_count= out_level_data_.triangle_count - sector->first_triangle;
+			sectors_info_[ out_level_data_.sector_count ].element= connection;
 
 			connection_to_sector_index[i]= out_level_data_.sector_count;
 
@@ -461,27 +678,27 @@ void mx_LevelGenerator::GenerateMeshes()
 
 	for( unsigned int i= 0; i < room_count_; i++ )
 	{
-		const Room* room= rooms_ + i;
+		const Room* room= GetRoom(i);
 		// Discard unlinked level parts
 		if( room->linkage_group_id == max_linkage_group_id_ )
 		{
 			sector= out_level_data_.sectors + room_to_sector_index[i];
 			sector->connections_count= room->connection_count;
 			for( unsigned int j= 0; j < room->connection_count; j++ )
-				sector->connections[j]= out_level_data_.sectors + connection_to_sector_index[ room->connections[j] - connections_ ];
+				sector->connections[j]= out_level_data_.sectors + connection_to_sector_index[ room->connections[j]->index ];
 		}
 	}
 
 	for( unsigned int i= 0; i < connection_count_; i++ )
 	{
-		const Connection* connection= connections_ + i;
+		const Connection* connection= GetConnection(i);
 		// Discard unlinked level parts
 		if( connection->begin->linkage_group_id == max_linkage_group_id_ )
 		{
 			sector= out_level_data_.sectors + connection_to_sector_index[i];
 			sector->connections_count= 2;
-			sector->connections[0]= out_level_data_.sectors + room_to_sector_index[ connection->begin - rooms_ ];
-			sector->connections[1]= out_level_data_.sectors + room_to_sector_index[ connection->end   - rooms_ ];
+			sector->connections[0]= out_level_data_.sectors + room_to_sector_index[ connection->begin->index ];
+			sector->connections[1]= out_level_data_.sectors + room_to_sector_index[ connection->end  ->index ];
 		}
 	}
 
@@ -492,6 +709,70 @@ void mx_LevelGenerator::GenerateMeshes()
 	delete[] connection_to_sector_index;
 }
 
+void mx_LevelGenerator::BuildGeometry()
+{
+	out_level_data_.vertex_count= 0;
+	out_level_data_.triangle_count= 0;
+
+	for( unsigned int s= 0; s < out_level_data_.sector_count; s++ )
+	{
+		mx_LevelSector& sector= out_level_data_.sectors[s];
+		const SectorInfo& info= sectors_info_[s];
+
+		sector.first_triangle= out_level_data_.triangle_count;
+		sector.first_vertex= out_level_data_.vertex_count;
+		if( info.hops != MX_SECTOR_WITHOUT_GEOMETRY )
+		{
+			if( sector.type == mx_LevelSector::ROOM )
+				AddRoomCube( static_cast<const Room*>( info.element ) );
+			else
+				AddConnectionCube( static_cast<const Connection*>( info.element ) );
+		}
+		sector.triangles_count= out_level_data_.triangle_count - sector.first_triangle;
+		sector.vertex_count= out_level_data_.vertex_count - sector.first_vertex;
+	}
+
+	CalculateNormals();
+	CalculateTextureCoordinates();
+	SetupTextures();
+	OptimizeGeometry();
+}
+
+void mx_LevelGenerator::OptimizeGeometry()
+{
+	unsigned int vertex_count= 0;
+	for( unsigned int s= 0; s < out_level_data_.sector_count; s++ )
+	{
+		mx_LevelSector& sector= out_level_data_.sectors[s];
+
+		unsigned int sector_vertex_count=
+			mxOptimizeLevelMesh(
+				out_level_data_.vertices, sector.first_vertex, sector.vertex_count,
+				out_level_data_.triangles + sector.first_triangle, sector.triangles_count );
+		MX_ASSERT( sector_vertex_count <= 65536 );
+
+		// Move vertices of sector to end of previous sectors vertices.
+		if( vertex_count != sector.first_vertex )
+		{
+			std::memmove(
+				out_level_data_.vertices + vertex_count,
+				out_level_data_.vertices + sector.first_vertex,
+				sizeof(mx_LevelVertex) * sector_vertex_count );
+
+			unsigned int shift= sector.first_vertex - vertex_count;
+			for( unsigned int t= sector.first_triangle; t < sector.first_triangle + sector.triangles_count; t++ )
+				for( unsigned int j= 0; j < 3; j++ )
+					out_level_data_.triangles[t].vertex_index[j]-= shift;
+		}
+
+		sector.first_vertex= vertex_count;
+		sector.vertex_count= sector_vertex_count;
+		vertex_count+= sector_vertex_count;
+	}
+
+	out_level_data_.vertex_count= vertex_count;
+}
+
 void mx_LevelGenerator::SpitTriangle( unsigned int triangle_index, const mx_Plane& plane )
 {
 #define COMPARE(x) ((x) < 0.0f)
@@ -626,10 +907,10 @@ void mx_LevelGenerator::AddRoomCube( const Room* room )
 	for( int y= room->coord_min[1] - 1; y < room->coord_max[1]; y++ )
 	for( int x= room->coord_min[0] - 1; x < room->coord_max[0]; x++ )
 	{
-		Element* element= ElementMap( x, y, z );
-		Element* el_x= ElementMap( x + 1, y, z );
-		Element* el_y= ElementMap( x, y + 1, z );
-		Element* el_z= ElementMap( x, y, z + 1 );
+		Element* element= GetElement( x, y, z );
+		Element* el_x= GetElement( x + 1, y, z );
+		Element* el_y= GetElement( x, y + 1, z );
+		Element* el_z= GetElement( x, y, z + 1 );
 
 		bool is_element= element == NULL;
 		bool is_el_x= el_x == NULL;
@@ -718,7 +999,7 @@ void mx_LevelGenerator::AddConnectionCube( const Connection* connection )
 
 	ReserveTrianglesAndVertices( c_side_count * 2, c_side_count * 4 );
 	MX_ASSERT( out_level_data_.vertex_count + c_side_count * 4 <= out_level_data_.vertices_capacity );
-	MX_ASSERT( out_level_data_.triangle_count + c_side_count * 2 < out_level_data_.triangles_capacity );
+	MX_ASSERT( out_level_data_.triangle_count + c_side_count * 2 <= out_level_data_.triangles_capacity );
 
 	float min_max[2][3]; // 0 - min, 1 - max
 	for( unsigned int i= 0; i < 3; i++ )
@@ -806,7 +1087,7 @@ void mx_LevelGenerator::SetupRoomSector( const Room* room, mx_LevelSector* secto
 	sector->ammo_boxes[0].type= BulletType( rand_.Rand() % LastBullet );
 
 	// Central sector is first
-	sector->is_central_sector= room == rooms_;
+	sector->is_central_sector= room->index == 0;
 	if( sector->is_central_sector )
 	{
 		// Setup lights in corners of sector
@@ -974,26 +1255,44 @@ void mx_LevelGenerator::CalculateTextureCoordinates()
 	} // for vertices
 }
 
-void mx_LevelGenerator::SetupTextures()
+void mx_LevelGenerator::SetupSectorsTextures()
 {
 	for( unsigned int s= 0; s < out_level_data_.sector_count; s++ )
 	{
-		unsigned char common_tex_id= rand_.Rand() % TextureMapScreen;
-
-		mx_LevelSector& sector= out_level_data_.sectors[s];
+		SectorInfo& info= sectors_info_[s];
+		info.tex_id= rand_.Rand() % TextureMapScreen;
 
-		const float c_inf= 100500.0f;
-		bool any_traingle_with_map_screen_placed= false;
+		const mx_LevelSector& sector= out_level_data_.sectors[s];
 
 		if ( sector.type == mx_LevelSector::ROOM && (rand_.Rand() % 3) < 2 )
 		{
 			unsigned int screen_side= rand_.Rand() % 3;
 			for( unsigned int s= 0; s < 3; s++ )
-				sector.map_screen_pos[s]= std::ceilf( ( sector.bb_min[s] + sector.bb_max[s] ) * 0.5f ) + 0.5f;
-			sector.map_screen_pos[screen_side]= (rand_.Rand()&1) ? sector.bb_min[screen_side] : sector.bb_max[screen_side];
+				info.map_screen_pos[s]= std::ceilf( ( sector.bb_min[s] + sector.bb_max[s] ) * 0.5f ) + 0.5f;
+			info.map_screen_pos[screen_side]= (rand_.Rand()&1) ? sector.bb_min[screen_side] : sector.bb_max[screen_side];
 		}
 		else // make map too far
-			sector.map_screen_pos[0]= sector.map_screen_pos[1]= sector.map_screen_pos[2]= c_inf;
+			info.map_screen_pos[0]= info.map_screen_pos[1]= info.map_screen_pos[2]= MX_MAP_SCREEN_INF;
+	}
+}
+
+void mx_LevelGenerator::SetupTextures()
+{
+	for( unsigned int s= 0; s < out_level_data_.sector_count; s++ )
+	{
+		const SectorInfo& info= sectors_info_[s];
+		unsigned char common_tex_id= info.tex_id;
+
+		mx_LevelSector& sector= out_level_data_.sectors[s];
+
+		bool any_traingle_with_map_screen_placed= false;
+
+		VEC3_CPY( sector.map_screen_pos, info.map_screen_pos );
+
+		// Reset ids, because vertices array reused, when geometry rebuilt. Map screen check below reads them.
+		for( unsigned int t= sector.first_triangle; t < sector.first_triangle + sector.triangles_count; t++ )
+			for( unsigned int v= 0; v < 3; v++ )
+				out_level_data_.vertices[ out_level_data_.triangles[t].vertex_index[v] ].tex_id= common_tex_id;
 		
 		for( unsigned int t= sector.first_triangle; t < sector.first_triangle + sector.triangles_count; t++ )
 		{
@@ -1026,7 +1325,7 @@ void mx_LevelGenerator::SetupTextures()
 				out_level_data_.vertices[ triangle.vertex_index[v] ].tex_id= tex_id;
 		}
 
-		if( !any_traingle_with_map_screen_placed ) // Failed to place map
-			sector.map_screen_pos[0]= sector.map_screen_pos[1]= sector.map_screen_pos[2]= c_inf;
+		if( !any_traingle_with_map_screen_placed ) // Failed to place map or sector has no geometry
+			sector.map_screen_pos[0]= sector.map_screen_pos[1]= sector.map_screen_pos[2]= MX_MAP_SCREEN_INF;
 	}
 }
\ No newline at end of file
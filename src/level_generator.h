@@ -1,10 +1,22 @@
 #pragma once
+#include "mx_assert.h"
 #include "mx_math.h"
 
-#define MX_MAX_LEVEL_SIZE_CELLS 40
+#define MX_DEFAULT_LEVEL_SIZE_CELLS 40
+// Range of level size, selectable by user. Smaller levels may have no room for player spawn.
+#define MX_MIN_LEVEL_SIZE_CELLS MX_DEFAULT_LEVEL_SIZE_CELLS
+#define MX_MAX_LEVEL_SIZE_CELLS 128
+// Limits for level of default size. For other sizes limits are scaled by level volume.
 #define MX_MAX_ROOMS 64 * 2
 #define MX_MAX_CONNECTIONS 256 * 4
 
+// Level space is stored sparsely, by bricks of 8x8x8 cells. Bricks are created on first write,
+// so only table of brick pointers is dense.
+#define MX_LEVEL_BRICK_SIZE_LOG2 3
+#define MX_LEVEL_BRICK_SIZE ( 1 << MX_LEVEL_BRICK_SIZE_LOG2 )
+// Rooms and connections are allocated by chunks, so pointers to them stay valid.
+#define MX_LEVEL_ELEMENTS_CHUNK_SIZE 64
+
 #define MX_MAX_ROOM_SIZE 9
 #define MX_MIN_ROOM_SIZE 2
 #define MX_CENTRAL_ROOM_HALF_SIZE 4
@@ -16,6 +28,16 @@
 #define MX_MAX_SECTOR_LIGHTS 16
 #define MX_MAX_SECTOR_AMMO_BOXES 4
 
+// Streaming. Geometry exists only for sectors not farther, than MX_STREAMING_GEOMETRY_HOPS from center sector.
+// Geometry rebuilt, when player comes closer, than MX_STREAMING_MIN_HOPS_TO_BORDER to border of meshed area.
+// Border distance must be not less, than MX_PVS_MAX_HOPS, so all visible sectors have geometry.
+#define MX_STREAMING_GEOMETRY_HOPS 9
+#define MX_STREAMING_MIN_HOPS_TO_BORDER 6
+#define MX_SECTOR_WITHOUT_GEOMETRY 0xFFFFFFFF
+
+// Map screen position for sectors without map screen.
+#define MX_MAP_SCREEN_INF 100500.0f
+
 // 32bit struct
 #pragma pack(push, 1)
 struct mx_LevelVertex
@@ -79,6 +101,10 @@ struct mx_LevelSector
 	unsigned int first_triangle;
 	unsigned int triangles_count;
 
+	// Triangles of sector use only vertices of this range. Vertex count always fits in 16 bits.
+	unsigned int first_vertex;
+	unsigned int vertex_count;
+
 	// Unique number for each sector-graph based algorithms.
 	unsigned int traverse_id;
 
@@ -120,11 +146,18 @@ unsigned int mxGenSectorGraphTraverseId();
 class mx_LevelGenerator
 {
 public:
-	mx_LevelGenerator( unsigned int seed );
+	mx_LevelGenerator( unsigned int seed, unsigned int level_size_cells= MX_DEFAULT_LEVEL_SIZE_CELLS );
 	~mx_LevelGenerator();
 
+	// Generates whole level - layout and geometry of all sectors.
 	void Generate();
 
+	// Generates only layout and sectors. Geometry is built later, around player, in UpdateGeometry().
+	void GenerateLayout();
+	// Rebuilds geometry around sector, if it is close to border of meshed area. Returns true, if geometry changed.
+	// Pointers to vertices and triangles of level data may change after rebuild.
+	bool UpdateGeometry( const mx_LevelSector* sector );
+
 	const mx_LevelData& GetLevelData();
 
 private:
@@ -135,6 +168,7 @@ private:
 			ROOM,
 			CONNECTION,
 		} type;
+		unsigned int index; // in rooms or connections
 	};
 
 	struct Room;
@@ -159,18 +193,53 @@ private:
 		Room* end;
 	};
 
+	struct Brick
+	{
+		// Bit x of occupancy[z][y] is set, if cell has element.
+		unsigned char occupancy[ MX_LEVEL_BRICK_SIZE ][ MX_LEVEL_BRICK_SIZE ];
+		Element* elements[ MX_LEVEL_BRICK_SIZE * MX_LEVEL_BRICK_SIZE * MX_LEVEL_BRICK_SIZE ];
+	};
+
+	// Generator data of output sector, needed for geometry rebuilding.
+	struct SectorInfo
+	{
+		const Element* element;
+		unsigned int hops; // distance from center of meshed area, MX_SECTOR_WITHOUT_GEOMETRY if not meshed
+		float map_screen_pos[3]; // planned position
+		unsigned char tex_id;
+	};
+
 private:
-	Element*& ElementMap( int x, int y, int z );
+	mx_LevelGenerator( const mx_LevelGenerator& );
+	mx_LevelGenerator& operator=( const mx_LevelGenerator& );
+
+	bool IsPointOutsideMap( const int* coord ) const;
+
+	static unsigned int BrickCellIndex( int x, int y, int z );
+	// Returns NULL for empty brick.
+	Brick* GetBrick( int brick_x, int brick_y, int brick_z ) const;
+	Brick* GetOrCreateBrick( int brick_x, int brick_y, int brick_z );
+	Element* GetElement( int x, int y, int z ) const;
+	void SetElement( int x, int y, int z, Element* element );
+	// Region - [coord_min; coord_max).
+	bool IsRegionFree( const int* coord_min, const int* coord_max ) const;
+	void FillRegion( const int* coord_min, const int* coord_max, Element* element );
+
+	// Allocates chunk for index, if needed.
+	Room* GetRoom( unsigned int index );
+	Connection* GetConnection( unsigned int index );
 
 	void PlaceRooms();
 	void PlaceConnections();
 	bool TryPlaceConnection( Room* room, const int* begin_coord, const int* direction );
+	void AddConnection( Room* begin_room, Room* end_room, const int* begin_coord, const int* end_coord, const int* direction );
 	void CalculateLinkage();
 	static void SetRoomLinkage_r( Room* room );
 
 	static bool CheckConnection( const Room* room0, const Room* room1 );
 
-	void GenerateMeshes();
+	void CreateSectors();
+	void BuildGeometry();
 	void SpitTriangle( unsigned int triangle_index, const mx_Plane& plane );
 	void ReserveTrianglesAndVertices( unsigned int new_triangle_count, unsigned int new_vertex_count );
 	void AddRoomCube( const Room* room );
@@ -180,19 +249,60 @@ private:
 	
 	void CalculateNormals();
 	void CalculateTextureCoordinates();
+	// Random textures and map screens selected for all sectors once, so geometry rebuilding gives same result.
+	void SetupSectorsTextures();
 	void SetupTextures();
+	// Welds vertices and reorders triangles of each sector. Sectors vertices are compacted.
+	void OptimizeGeometry();
 
 private:
-	Element* element_map_[ MX_MAX_LEVEL_SIZE_CELLS * MX_MAX_LEVEL_SIZE_CELLS * MX_MAX_LEVEL_SIZE_CELLS ];
+	int level_size_cells_;
+
+	int bricks_per_side_;
+	Brick** bricks_;
 
-	Room rooms_[ MX_MAX_ROOMS ];
+	Room** room_chunks_;
+	unsigned int room_chunk_count_;
 	unsigned int room_count_;
+	unsigned int max_room_count_;
 	unsigned int max_linkage_group_id_;
 
-	Connection connections_[ MX_MAX_CONNECTIONS ];
+	Connection** connection_chunks_;
+	unsigned int connection_chunk_count_;
 	unsigned int connection_count_;
+	unsigned int max_connection_count_;
+
+	SectorInfo* sectors_info_;
 
 	mx_Rand rand_;
 
 	mx_LevelData out_level_data_;
-};
\ No newline at end of file
+};
+
+inline unsigned int mx_LevelGenerator::BrickCellIndex( int x, int y, int z )
+{
+	const int c_mask= MX_LEVEL_BRICK_SIZE - 1;
+	return ( x & c_mask ) + ( ( y & c_mask ) + ( z & c_mask ) * MX_LEVEL_BRICK_SIZE ) * MX_LEVEL_BRICK_SIZE;
+}
+
+inline mx_LevelGenerator::Brick* mx_LevelGenerator::GetBrick( int brick_x, int brick_y, int brick_z ) const
+{
+	MX_ASSERT( brick_x >= 0 && brick_x < bricks_per_side_ );
+	MX_ASSERT( brick_y >= 0 && brick_y < bricks_per_side_ );
+	MX_ASSERT( brick_z >= 0 && brick_z < bricks_per_side_ );
+
+	return bricks_[ brick_x + ( brick_y + brick_z * bricks_per_side_ ) * bricks_per_side_ ];
+}
+
+inline mx_LevelGenerator::Element* mx_LevelGenerator::GetElement( int x, int y, int z ) const
+{
+	MX_ASSERT( x >= 0 && x < level_size_cells_ );
+	MX_ASSERT( y >= 0 && y < level_size_cells_ );
+	MX_ASSERT( z >= 0 && z < level_size_cells_ );
+
+	const Brick* brick= GetBrick( x >> MX_LEVEL_BRICK_SIZE_LOG2, y >> MX_LEVEL_BRICK_SIZE_LOG2, z >> MX_LEVEL_BRICK_SIZE_LOG2 );
+	if( brick == NULL )
+		return NULL;
+
+	return brick->elements[ BrickCellIndex( x, y, z ) ];
+}
\ No newline at end of file
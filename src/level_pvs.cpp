@@ -0,0 +1,285 @@
+#include <cstring>
+
+#include "game_constants.h"
+#include "level_generator.h"
+#include "mx_assert.h"
+
+#include "level_pvs.h"
+
+#define MX_PVS_EPS 0.001f
+
+// Extends out box by bounds of crossing points of lines through boxes a and b with plane axis= plane.
+// Line a + ( b - a ) * t crosses plane after b, so t >= 1, t= ( plane - a[axis] ) / ( b[axis] - a[axis] ).
+// Bounds contain crossing points of all such lines.
+// Returns false, if bounds are infinite.
+static bool mxAddLinesCrossingBounds(
+	const float* a_min, const float* a_max, const float* b_min, const float* b_max,
+	unsigned int axis, float plane,
+	float* out_min, float* out_max )
+{
+	// Lines, almost parallel to plane, may cross it anywhere.
+	float denominator[2]= { b_min[ axis ] - a_max[ axis ], b_max[ axis ] - a_min[ axis ] };
+	if( denominator[0] <= MX_PVS_EPS && denominator[1] >= -MX_PVS_EPS )
+		return false;
+
+	// Denominator sign is same for all lines, so t is monotonic by a[axis] and b[axis] and has extremes in corners.
+	float t[2]= { mxInf(), -mxInf() };
+	for( unsigned int i= 0; i < 4; i++ )
+	{
+		float a= ( i & 1 ) ? a_max[ axis ] : a_min[ axis ];
+		float b= ( i & 2 ) ? b_max[ axis ] : b_min[ axis ];
+		float corner_t= ( plane - a ) / ( b - a );
+		if( corner_t < t[0] ) t[0]= corner_t;
+		if( corner_t > t[1] ) t[1]= corner_t;
+	}
+	if( t[1] < 1.0f - MX_PVS_EPS )
+		return true; // Plane is behind b.
+	if( t[0] < 1.0f - MX_PVS_EPS )
+		t[0]= 1.0f - MX_PVS_EPS;
+
+	// Crossing point is linear by t for fixed a and b, so it has extremes in ends of t range.
+	for( unsigned int i= 0; i < 2; i++ )
+	for( unsigned int c= 0; c < 3; c++ )
+	{
+		if( c == axis ) continue;
+
+		float a_k= 1.0f - t[i];
+		float x_min= ( a_k < 0.0f ? a_max[c] : a_min[c] ) * a_k + b_min[c] * t[i];
+		float x_max= ( a_k < 0.0f ? a_min[c] : a_max[c] ) * a_k + b_max[c] * t[i];
+		if( x_min < out_min[c] ) out_min[c]= x_min;
+		if( x_max > out_max[c] ) out_max[c]= x_max;
+	}
+	return true;
+}
+
+void mxGetSectorsPortal( const mx_LevelSector& sector0, const mx_LevelSector& sector1, float* out_bb_min, float* out_bb_max )
+{
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		out_bb_min[j]= sector0.bb_min[j] > sector1.bb_min[j] ? sector0.bb_min[j] : sector1.bb_min[j];
+		out_bb_max[j]= sector0.bb_max[j] < sector1.bb_max[j] ? sector0.bb_max[j] : sector1.bb_max[j];
+	}
+}
+
+mx_LevelPVS::mx_LevelPVS( const mx_LevelData& level_data )
+	: sectors_(level_data.sectors)
+	, sector_count_(level_data.sector_count)
+	, row_size_( ( level_data.sector_count + 7 ) / 8 )
+{
+	// Portals.
+	sectors_first_portal_= new unsigned int[ sector_count_ + 1 ];
+	sectors_first_portal_[0]= 0;
+	for( unsigned int s= 0; s < sector_count_; s++ )
+		sectors_first_portal_[ s + 1 ]= sectors_first_portal_[s] + sectors_[s].connections_count;
+
+	portals_= new Portal[ sectors_first_portal_[ sector_count_ ] ];
+	for( unsigned int s= 0; s < sector_count_; s++ )
+	{
+		const mx_LevelSector& sector= sectors_[s];
+		for( unsigned int c= 0; c < sector.connections_count; c++ )
+		{
+			const mx_LevelSector& connected_sector= *sector.connections[c];
+			Portal& portal= portals_[ sectors_first_portal_[s] + c ];
+			portal.sector= &connected_sector - sectors_;
+
+			mxGetSectorsPortal( sector, connected_sector, portal.bb_min, portal.bb_max );
+			portal.axis= 0;
+			for( unsigned int j= 1; j < 3; j++ )
+				if( portal.bb_max[j] - portal.bb_min[j] < portal.bb_max[ portal.axis ] - portal.bb_min[ portal.axis ] )
+					portal.axis= j;
+			MX_ASSERT( portal.bb_max[ portal.axis ] - portal.bb_min[ portal.axis ] <= MX_PVS_EPS );
+		}
+	}
+
+	// Visibility rows.
+	unsigned char* rows= new unsigned char[ sector_count_ * row_size_ ];
+	std::memset( rows, 0, sector_count_ * row_size_ );
+	sectors_in_path_= new bool[ sector_count_ ];
+	std::memset( sectors_in_path_, 0, sizeof(bool) * sector_count_ );
+
+	for( unsigned int s= 0; s < sector_count_; s++ )
+		FindVisibleSectors_r( s, 0, rows + s * row_size_ );
+
+	// Real visibility is symmetric. Test is conservative in both directions, so sector is visible only if it sees back.
+	for( unsigned int s= 0; s < sector_count_; s++ )
+	{
+		unsigned char* row= rows + s * row_size_;
+		for( unsigned int v= 0; v < sector_count_; v++ )
+			if( ( rows[ v * row_size_ + ( s >> 3 ) ] & ( 1 << ( s & 7 ) ) ) == 0 )
+				row[ v >> 3 ]&= ~( 1 << ( v & 7 ) );
+	}
+
+	// Compressed row is not bigger, than 1.5 of uncompressed row.
+	unsigned char* rows_data= new unsigned char[ sector_count_ * ( row_size_ + row_size_ / 2 + 1 ) ];
+	rows_offsets_= new unsigned int[ sector_count_ + 1 ];
+	rows_offsets_[0]= 0;
+	for( unsigned int s= 0; s < sector_count_; s++ )
+		rows_offsets_[ s + 1 ]= rows_offsets_[s] + CompressRow( rows + s * row_size_, row_size_, rows_data + rows_offsets_[s] );
+
+	rows_data_= new unsigned char[ rows_offsets_[ sector_count_ ] ];
+	std::memcpy( rows_data_, rows_data, rows_offsets_[ sector_count_ ] );
+
+	delete[] rows;
+	delete[] rows_data;
+	delete[] sectors_in_path_;
+	delete[] portals_;
+	delete[] sectors_first_portal_;
+	sectors_in_path_= NULL;
+	portals_= NULL;
+	sectors_first_portal_= NULL;
+}
+
+mx_LevelPVS::~mx_LevelPVS()
+{
+	delete[] rows_data_;
+	delete[] rows_offsets_;
+}
+
+bool mx_LevelPVS::IsSectorVisible( const mx_LevelSector* from_sector, const mx_LevelSector* sector ) const
+{
+	unsigned int from_sector_index= from_sector - sectors_;
+	unsigned int sector_index= sector - sectors_;
+	MX_ASSERT( from_sector_index < sector_count_ && sector_index < sector_count_ );
+
+	unsigned int byte_index= sector_index >> 3;
+	const unsigned char* data= rows_data_ + rows_offsets_[ from_sector_index ];
+	const unsigned char* data_end= rows_data_ + rows_offsets_[ from_sector_index + 1 ];
+	unsigned int byte= 0;
+	while( data < data_end )
+	{
+		if( *data == 0 )
+		{
+			byte+= data[1];
+			if( byte > byte_index ) return false;
+			data+= 2;
+		}
+		else
+		{
+			if( byte == byte_index ) return ( *data & ( 1 << ( sector_index & 7 ) ) ) != 0;
+			byte++;
+			data++;
+		}
+	}
+	return false;
+}
+
+void mx_LevelPVS::MarkVisibleSectors( const mx_LevelSector* from_sector, unsigned int traverse_id ) const
+{
+	unsigned int from_sector_index= from_sector - sectors_;
+	MX_ASSERT( from_sector_index < sector_count_ );
+
+	const unsigned char* data= rows_data_ + rows_offsets_[ from_sector_index ];
+	const unsigned char* data_end= rows_data_ + rows_offsets_[ from_sector_index + 1 ];
+	unsigned int byte= 0;
+	while( data < data_end )
+	{
+		if( *data == 0 )
+		{
+			byte+= data[1];
+			data+= 2;
+			continue;
+		}
+
+		for( unsigned int i= 0; i < 8; i++ )
+			if( ( *data & ( 1 << i ) ) != 0 )
+				sectors_[ ( byte << 3 ) + i ].traverse_id= traverse_id;
+		byte++;
+		data++;
+	}
+}
+
+void mx_LevelPVS::FindVisibleSectors_r( unsigned int sector, unsigned int path_length, unsigned char* row )
+{
+	row[ sector >> 3 ]|= 1 << ( sector & 7 );
+	if( path_length == MX_PVS_MAX_HOPS )
+		return;
+
+	sectors_in_path_[ sector ]= true;
+
+	for( unsigned int p= sectors_first_portal_[ sector ]; p < sectors_first_portal_[ sector + 1 ]; p++ )
+	{
+		const Portal& portal= portals_[p];
+		if( sectors_in_path_[ portal.sector ] )
+			continue;
+
+		path_[ path_length ]= &portal;
+		if( ClipPathPortal( path_length + 1 ) )
+			FindVisibleSectors_r( portal.sector, path_length + 1, row );
+	}
+
+	sectors_in_path_[ sector ]= false;
+}
+
+bool mx_LevelPVS::ClipPathPortal( unsigned int path_length )
+{
+	unsigned int last= path_length - 1;
+	const Portal& portal= *path_[ last ];
+	float* out_min= clipped_bb_min_[ last ];
+	float* out_max= clipped_bb_max_[ last ];
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		out_min[j]= portal.bb_min[j];
+		out_max[j]= portal.bb_max[j];
+	}
+
+	// Any line between two portals of one convex sector is visible.
+	if( path_length <= 2 )
+		return true;
+
+	// Lines pass through each clipped portal of path. Use lines through every previous portal and portal before this.
+	for( unsigned int i= 0; i + 1 < last; i++ )
+	{
+		float lines_min[3], lines_max[3];
+		for( unsigned int j= 0; j < 3; j++ )
+		{
+			lines_min[j]= mxInf();
+			lines_max[j]= -mxInf();
+		}
+
+		if( !mxAddLinesCrossingBounds(
+			clipped_bb_min_[i], clipped_bb_max_[i],
+			clipped_bb_min_[ last - 1 ], clipped_bb_max_[ last - 1 ],
+			portal.axis, portal.bb_min[ portal.axis ],
+			lines_min, lines_max ) )
+			continue;
+
+		for( unsigned int c= 0; c < 3; c++ )
+		{
+			if( c == portal.axis ) continue;
+
+			if( lines_min[c] - MX_PVS_EPS > out_min[c] ) out_min[c]= lines_min[c] - MX_PVS_EPS;
+			if( lines_max[c] + MX_PVS_EPS < out_max[c] ) out_max[c]= lines_max[c] + MX_PVS_EPS;
+			if( out_min[c] > out_max[c] )
+				return false;
+		}
+	}
+
+	return true;
+}
+
+unsigned int mx_LevelPVS::CompressRow( const unsigned char* row, unsigned int row_size, unsigned char* out_data )
+{
+	// Zero bytes are stored as zero and count of zeros. Other bytes are stored as is.
+	unsigned char* out= out_data;
+	for( unsigned int i= 0; i < row_size; )
+	{
+		if( row[i] != 0 )
+		{
+			*out= row[i];
+			out++;
+			i++;
+			continue;
+		}
+
+		unsigned int zero_count= 0;
+		while( i < row_size && row[i] == 0 && zero_count < 255 )
+		{
+			zero_count++;
+			i++;
+		}
+		out[0]= 0;
+		out[1]= (unsigned char) zero_count;
+		out+= 2;
+	}
+	return out - out_data;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+#include "fwd.h"
+
+// Maximum sectors graph distance of visible sectors.
+// Streamed geometry must exist for all sectors not farther, than this.
+#define MX_PVS_MAX_HOPS 6
+
+// Portal between two connected sectors - intersection of their boxes. Connected sectors touch each other, so portal is flat.
+void mxGetSectorsPortal( const mx_LevelSector& sector0, const mx_LevelSector& sector1, float* out_bb_min, float* out_bb_max );
+
+// Potentially visible set of sectors, calculated at level load time.
+// Sector B is visible from sector A, if some line passes through all portals of some path from A to B.
+// Sectors are convex, so such line does not cross walls. Portal - intersection of boxes of two connected sectors.
+// Test is conservative: each portal of path is clipped to box, containing crossing points of all lines
+// through clipped previous portal and any clipped portal before it. Path is invisible only if clipped portal is empty.
+// Each sector has bitset of visible sectors. Bitsets are compressed - zero bytes are stored as run length.
+class mx_LevelPVS
+{
+public:
+	explicit mx_LevelPVS( const mx_LevelData& level_data );
+	~mx_LevelPVS();
+
+	bool IsSectorVisible( const mx_LevelSector* from_sector, const mx_LevelSector* sector ) const;
+
+	// Sets traverse_id of sectors, visible from given sector. Sector itself is visible too.
+	void MarkVisibleSectors( const mx_LevelSector* from_sector, unsigned int traverse_id ) const;
+
+	unsigned int GetCompressedSize() const;
+
+private:
+	mx_LevelPVS( const mx_LevelPVS& );
+	mx_LevelPVS& operator=( const mx_LevelPVS& );
+
+	struct Portal
+	{
+		float bb_min[3];
+		float bb_max[3];
+		unsigned int axis; // axis of portal plane normal
+		unsigned int sector; // sector behind portal
+	};
+
+	// Recursively walks through portals of path. Marks sectors in uncompressed row.
+	void FindVisibleSectors_r( unsigned int sector, unsigned int path_length, unsigned char* row );
+	// Clips last portal of path by lines through clipped previous portals.
+	// Returns false, if no line passes through all portals of path.
+	bool ClipPathPortal( unsigned int path_length );
+
+	static unsigned int CompressRow( const unsigned char* row, unsigned int row_size, unsigned char* out_data );
+
+private:
+	mx_LevelSector* const sectors_;
+	const unsigned int sector_count_;
+	const unsigned int row_size_;
+
+	// Portals of each sector, in order of sector connections.
+	Portal* portals_;
+	unsigned int* sectors_first_portal_;
+
+	// Build state. Freed after build.
+	const Portal* path_[ MX_PVS_MAX_HOPS ];
+	float clipped_bb_min_[ MX_PVS_MAX_HOPS ][3];
+	float clipped_bb_max_[ MX_PVS_MAX_HOPS ][3];
+	bool* sectors_in_path_;
+
+	unsigned char* rows_data_;
+	unsigned int* rows_offsets_; // size - sector_count + 1
+};
+
+inline unsigned int mx_LevelPVS::GetCompressedSize() const
+{
+	return rows_offsets_[ sector_count_ ];
+}
\ No newline at end of file
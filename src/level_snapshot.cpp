@@ -0,0 +1,177 @@
+#include <cstring>
+
+#include "mx_assert.h"
+
+#include "level_snapshot.h"
+
+#define MX_LEVEL_SNAPSHOT_VERSION 2
+#define MX_LEVEL_SNAPSHOT_ALIGNMENT 16
+
+/*
+In file connections of sectors stored as sector numbers instead of pointers.
+Number written into pointer slot, so sectors array copied into file as is.
+*/
+
+static unsigned int AlignOffset( unsigned int offset )
+{
+	return ( offset + MX_LEVEL_SNAPSHOT_ALIGNMENT - 1 ) & ~( MX_LEVEL_SNAPSHOT_ALIGNMENT - 1 );
+}
+
+mx_LevelSnapshot::mx_LevelSnapshot( const char* file_name )
+	: file_(INVALID_HANDLE_VALUE)
+	, mapping_(NULL)
+	, mapped_data_(NULL)
+	, valid_(false)
+{
+	file_= CreateFile( file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file_ == INVALID_HANDLE_VALUE )
+		return;
+
+	DWORD file_size= GetFileSize( file_, NULL );
+	if( file_size == INVALID_FILE_SIZE || file_size < sizeof(Header) )
+		return;
+
+	// Copy-on-write mapping. Only pages of sectors are copied by fix-up, geometry stays shared with file.
+	mapping_= CreateFileMapping( file_, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+	if( mapping_ == NULL )
+		return;
+	mapped_data_= (unsigned char*) MapViewOfFile( mapping_, FILE_MAP_COPY, 0, 0, 0 );
+	if( mapped_data_ == NULL )
+		return;
+
+	valid_= Load( file_size );
+	if( !valid_ )
+		Close();
+}
+
+mx_LevelSnapshot::~mx_LevelSnapshot()
+{
+	Close();
+}
+
+bool mx_LevelSnapshot::Save( const char* file_name, const mx_LevelData& level_data )
+{
+	Header header;
+	std::memcpy( header.format_code, "MXLS", 4 );
+	header.version= MX_LEVEL_SNAPSHOT_VERSION;
+	header.sector_size= sizeof(mx_LevelSector);
+	header.vertex_size= sizeof(mx_LevelVertex);
+	header.triangle_size= sizeof(mx_LevelTriangle);
+	header.sector_count= level_data.sector_count;
+	header.vertex_count= level_data.vertex_count;
+	header.triangle_count= level_data.triangle_count;
+	header.icosahedron_count= level_data.icosahedron_count;
+
+	header.sectors_offset= AlignOffset( sizeof(Header) );
+	header.vertices_offset= AlignOffset( header.sectors_offset + header.sector_count * sizeof(mx_LevelSector) );
+	header.triangles_offset= AlignOffset( header.vertices_offset + header.vertex_count * sizeof(mx_LevelVertex) );
+	unsigned int file_size= header.triangles_offset + header.triangle_count * sizeof(mx_LevelTriangle);
+
+	unsigned char* file_data= new unsigned char[ file_size ];
+	std::memset( file_data, 0, file_size );
+
+	std::memcpy( file_data, &header, sizeof(Header) );
+
+	mx_LevelSector* sectors= (mx_LevelSector*)( file_data + header.sectors_offset );
+	std::memcpy( sectors, level_data.sectors, header.sector_count * sizeof(mx_LevelSector) );
+	for( unsigned int s= 0; s < header.sector_count; s++ )
+		for( unsigned int i= 0; i < sectors[s].connections_count; i++ )
+		{
+			size_t sector_number= sectors[s].connections[i] - level_data.sectors;
+			sectors[s].connections[i]= (mx_LevelSector*) sector_number;
+		}
+
+	std::memcpy( file_data + header.vertices_offset, level_data.vertices, header.vertex_count * sizeof(mx_LevelVertex) );
+	std::memcpy( file_data + header.triangles_offset, level_data.triangles, header.triangle_count * sizeof(mx_LevelTriangle) );
+
+	bool ok= false;
+	HANDLE file= CreateFile( file_name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file != INVALID_HANDLE_VALUE )
+	{
+		DWORD written;
+		ok= WriteFile( file, file_data, file_size, &written, NULL ) && written == file_size;
+		CloseHandle( file );
+	}
+
+	delete[] file_data;
+	return ok;
+}
+
+bool mx_LevelSnapshot::Load( unsigned int file_size )
+{
+	const Header* header= (const Header*) mapped_data_;
+	if( std::memcmp( header->format_code, "MXLS", 4 ) != 0 ||
+		header->version != MX_LEVEL_SNAPSHOT_VERSION ||
+		header->sector_size != sizeof(mx_LevelSector) ||
+		header->vertex_size != sizeof(mx_LevelVertex) ||
+		header->triangle_size != sizeof(mx_LevelTriangle) ||
+		header->sector_count == 0 ||
+		( header->sectors_offset | header->vertices_offset | header->triangles_offset ) % MX_LEVEL_SNAPSHOT_ALIGNMENT != 0 )
+		return false;
+
+	// Check ranges in 64 bit, because counts in file may be too big.
+	if( header->sectors_offset > file_size ||
+		(unsigned long long)header->sector_count * sizeof(mx_LevelSector) > file_size - header->sectors_offset ||
+		header->vertices_offset > file_size ||
+		(unsigned long long)header->vertex_count * sizeof(mx_LevelVertex) > file_size - header->vertices_offset ||
+		header->triangles_offset > file_size ||
+		(unsigned long long)header->triangle_count * sizeof(mx_LevelTriangle) > file_size - header->triangles_offset )
+		return false;
+
+	level_data_.sectors= (mx_LevelSector*)( mapped_data_ + header->sectors_offset );
+	level_data_.sector_count= header->sector_count;
+	level_data_.vertices= (mx_LevelVertex*)( mapped_data_ + header->vertices_offset );
+	level_data_.vertices_capacity= level_data_.vertex_count= header->vertex_count;
+	level_data_.triangles= (mx_LevelTriangle*)( mapped_data_ + header->triangles_offset );
+	level_data_.triangles_capacity= level_data_.triangle_count= header->triangle_count;
+	level_data_.icosahedron_count= header->icosahedron_count;
+
+	// Vertices are not checked, so pages of vertices are not touched on load.
+	for( unsigned int s= 0; s < level_data_.sector_count; s++ )
+	{
+		mx_LevelSector& sector= level_data_.sectors[s];
+		if( sector.connections_count > MX_MAX_ROOM_CONNECTIONS ||
+			sector.planes_count > MX_MAX_SECTOR_PLANES ||
+			sector.light_count > MX_MAX_SECTOR_LIGHTS ||
+			sector.ammo_box_count > MX_MAX_SECTOR_AMMO_BOXES ||
+			sector.first_triangle > level_data_.triangle_count ||
+			sector.triangles_count > level_data_.triangle_count - sector.first_triangle ||
+			sector.first_vertex > level_data_.vertex_count ||
+			sector.vertex_count > level_data_.vertex_count - sector.first_vertex ||
+			sector.vertex_count > 65536 )
+			return false;
+
+		for( unsigned int i= 0; i < sector.connections_count; i++ )
+		{
+			size_t sector_number= (size_t) sector.connections[i];
+			if( sector_number >= level_data_.sector_count )
+				return false;
+			sector.connections[i]= level_data_.sectors + sector_number;
+		}
+
+		// Renderer and collision code index vertices of sector by triangles.
+		// Unsigned difference rejects indices before first vertex of sector too.
+		const mx_LevelTriangle* triangles= level_data_.triangles + sector.first_triangle;
+		for( unsigned int t= 0; t < sector.triangles_count; t++ )
+			for( unsigned int j= 0; j < 3; j++ )
+				if( triangles[t].vertex_index[j] - sector.first_vertex >= sector.vertex_count )
+					return false;
+	}
+
+	return true;
+}
+
+void mx_LevelSnapshot::Close()
+{
+	if( mapped_data_ != NULL )
+		UnmapViewOfFile( mapped_data_ );
+	if( mapping_ != NULL )
+		CloseHandle( mapping_ );
+	if( file_ != INVALID_HANDLE_VALUE )
+		CloseHandle( file_ );
+
+	mapped_data_= NULL;
+	mapping_= NULL;
+	file_= INVALID_HANDLE_VALUE;
+	valid_= false;
+}
\ No newline at end of file
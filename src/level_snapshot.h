@@ -0,0 +1,61 @@
+#pragma once
+#include <windows.h>
+
+#include "game_constants.h"
+#include "level_generator.h"
+
+// Binary snapshot of generated level. Loading - mapping of file and fix-up of sectors connections.
+// File contains raw structs, so snapshot valid only for same version and same structs layout.
+class mx_LevelSnapshot
+{
+public:
+	// File mapped as copy-on-write, so level may change loaded sectors.
+	mx_LevelSnapshot( const char* file_name );
+	~mx_LevelSnapshot();
+
+	// Returns NULL, if file not exist or invalid. Data valid while snapshot exists.
+	const mx_LevelData* GetLevelData() const;
+
+	static bool Save( const char* file_name, const mx_LevelData& level_data );
+
+private:
+	mx_LevelSnapshot(const mx_LevelSnapshot&);
+	mx_LevelSnapshot& operator=(const mx_LevelSnapshot&);
+
+	struct Header
+	{
+		char format_code[4]; // must be "MXLS" - "Micro-X Level Snapshot"
+		unsigned int version;
+
+		// Sizes of structs, for detection of layout changes.
+		unsigned int sector_size;
+		unsigned int vertex_size;
+		unsigned int triangle_size;
+
+		unsigned int sector_count;
+		unsigned int vertex_count;
+		unsigned int triangle_count;
+		unsigned int icosahedron_count;
+
+		// From file begin.
+		unsigned int sectors_offset;
+		unsigned int vertices_offset;
+		unsigned int triangles_offset;
+	};
+
+	bool Load( unsigned int file_size );
+	void Close();
+
+private:
+	HANDLE file_;
+	HANDLE mapping_;
+	unsigned char* mapped_data_;
+
+	mx_LevelData level_data_;
+	bool valid_;
+};
+
+inline const mx_LevelData* mx_LevelSnapshot::GetLevelData() const
+{
+	return valid_ ? &level_data_ : NULL;
+}
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include <cstdio>
 #include <cstring>
 
+#include "game_constants.h"
+#include "level_generator.h"
 #include "main_loop.h"
 #include "mx_math.h"
 
@@ -16,6 +18,26 @@ static void GetCommandLineParameter( const char* cmd_line, const char* parameter
 	out_parameter= float(std::atof( str ));
 }
 
+// Returns NULL, if there is no parameter. Value - until next space.
+static const char* GetCommandLineString( const char* cmd_line, const char* parameter_name, char* buffer, unsigned int buffer_size )
+{
+	const char* str= std::strstr( cmd_line, parameter_name );
+	if( str == NULL ) return NULL;
+
+	while( *str != 0 && *str != ' ' ) str++;
+	while( *str == ' ' ) str++;
+	if( *str == 0 ) return NULL;
+
+	unsigned int i= 0;
+	while( str[i] != 0 && str[i] != ' ' && i + 1 < buffer_size )
+	{
+		buffer[i]= str[i];
+		i++;
+	}
+	buffer[i]= 0;
+	return buffer;
+}
+
 #ifdef MX_DEBUG
 int main()
 #else
@@ -39,11 +61,22 @@ int WINAPI WinMain(
 	sens_x= mxClamp( 0.1f, 10.0f, sens_x );
 	sens_y= mxClamp( 0.1f, 10.0f, sens_y );
 
+	float level_size= float(MX_DEFAULT_LEVEL_SIZE_CELLS);
+	GetCommandLineParameter( cmd, "--level-size", level_size );
+	level_size= mxClamp( float(MX_MIN_LEVEL_SIZE_CELLS), float(MX_MAX_LEVEL_SIZE_CELLS), level_size );
+
+	char load_level_buffer[ MAX_PATH ];
+	char save_level_buffer[ MAX_PATH ];
+	const char* load_level= GetCommandLineString( cmd, "--load-level", load_level_buffer, sizeof(load_level_buffer) );
+	const char* save_level= GetCommandLineString( cmd, "--save-level", save_level_buffer, sizeof(save_level_buffer) );
+
 	mx_MainLoop::CreateInstance(
 		1024, 768,
 		fullscreen, vsync,
 		invert_mouse,
-		sens_x, sens_y );
+		sens_x, sens_y,
+		load_level, save_level,
+		(unsigned int)level_size );
 
 	mx_MainLoop::Instance()->Loop();
 	mx_MainLoop::DeleteInstance();
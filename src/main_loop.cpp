@@ -1,12 +1,15 @@
 #include <cstdio>
 
+#include "drawing_snapshot.h"
 #include "gl/funcs.h"
 #include "level.h"
 #include "level_generator.h"
+#include "level_snapshot.h"
 #include "mx_assert.h"
 #include "player.h"
 #include "renderer.h"
 #include "sound_engine.h"
+#include "thread_pool.h"
 //#include "text.h"
 
 #include "main_loop.h"
@@ -43,7 +46,9 @@ void mx_MainLoop::CreateInstance(
 	unsigned int viewport_width, unsigned int viewport_height,
 	bool fullscreen, bool vsync,
 	bool invert_mouse_y,
-	float mouse_speed_x, float mouse_speed_y )
+	float mouse_speed_x, float mouse_speed_y,
+	const char* load_level_file_name, const char* save_level_file_name,
+	unsigned int level_size_cells )
 {
 	MX_ASSERT( !instance_ );
 	new
@@ -51,7 +56,9 @@ void mx_MainLoop::CreateInstance(
 			viewport_width, viewport_height,
 			fullscreen, vsync,
 			invert_mouse_y,
-			mouse_speed_x, mouse_speed_y );
+			mouse_speed_x, mouse_speed_y,
+			load_level_file_name, save_level_file_name,
+			level_size_cells );
 }
 
 void mx_MainLoop::DeleteInstance()
@@ -66,7 +73,9 @@ mx_MainLoop::mx_MainLoop(
 	unsigned int viewport_width, unsigned int viewport_height,
 	bool fullscreen, bool vsync,
 	bool invert_mouse_y,
-	float mouse_speed_x, float mouse_speed_y )
+	float mouse_speed_x, float mouse_speed_y,
+	const char* load_level_file_name, const char* save_level_file_name,
+	unsigned int level_size_cells )
 	: viewport_width_(viewport_width), viewport_height_(viewport_height)
 	, mouse_speed_x_( mouse_speed_x )
 	, mouse_speed_y_( invert_mouse_y ? -mouse_speed_y : mouse_speed_y )
@@ -74,8 +83,11 @@ mx_MainLoop::mx_MainLoop(
 	, quit_(false)
 	, prev_cursor_pos_(), mouse_captured_(false)
 	, player_(NULL)
+	, level_generator_(NULL)
+	, level_snapshot_(NULL)
 	, level_(NULL)
 	, renderer_(NULL)
+	, front_snapshot_(0)
 {
 	instance_= this;
 
@@ -175,23 +187,61 @@ mx_MainLoop::mx_MainLoop(
 	fps_calc_.current_calc_frame_count= 0;
 
 	mx_SoundEngine::CreateInstance( hwnd_ );
+	mx_ThreadPool::CreateInstance();
 
-	start_time_ms_= prev_time_ms_= GetTickCount();
+	start_time_ms_= GetTickCount();
+	QueryPerformanceFrequency( &performance_frequency_ );
+	QueryPerformanceCounter( &prev_frame_counter_ );
+	dt_s_= MX_TICK_TIME_S;
 	toatal_time_s_= 0.0f;
+	accumulated_time_s_= 0.0f;
+	scheduled_tick_count_= 0;
 
 	player_= new mx_Player();
 
-	mx_LevelGenerator* generator= new mx_LevelGenerator( GetTickCount() );
-	generator->Generate();
-	level_= new mx_Level( generator->GetLevelData(), *player_ );
-	delete generator;
+	if( load_level_file_name != NULL )
+	{
+		level_snapshot_= new mx_LevelSnapshot( load_level_file_name );
+		if( level_snapshot_->GetLevelData() == NULL )
+		{
+			// Invalid snapshot - generate new level.
+			delete level_snapshot_;
+			level_snapshot_= NULL;
+		}
+	}
+
+	if( level_snapshot_ != NULL )
+		level_= new mx_Level( *level_snapshot_->GetLevelData(), *player_ );
+	else if( save_level_file_name != NULL )
+	{
+		// Snapshot needs geometry of whole level. All sectors are meshed, so geometry never rebuilt.
+		level_generator_= new mx_LevelGenerator( GetTickCount(), level_size_cells );
+		level_generator_->Generate();
+		if( !mx_LevelSnapshot::Save( save_level_file_name, level_generator_->GetLevelData() ) )
+			std::printf( "error, can not save level snapshot to \"%s\"\n", save_level_file_name );
+		level_= new mx_Level( level_generator_->GetLevelData(), *player_ );
+	}
+	else
+	{
+		level_generator_= new mx_LevelGenerator( GetTickCount(), level_size_cells );
+		level_generator_->GenerateLayout();
+		level_= new mx_Level( level_generator_->GetLevelData(), *player_ );
+		// Level selects spawn sector, so build geometry around it only after level creation.
+		level_generator_->UpdateGeometry( level_->GetPlayerSpawnSector() );
+		level_->UpdateGeometry( level_generator_->GetLevelData() );
+	}
 
 	player_->SetLevel(level_);
 	
-	renderer_= new mx_Renderer( *level_, *player_ );
+	renderer_= new mx_Renderer( *level_ );
 
 	// Spawn player after all heavy operations (renderer, world construction )
 	level_->RespawnPlayer();
+
+	for( unsigned int i= 0; i < 2; i++ )
+		drawing_snapshots_[i]= new mx_DrawingSnapshot( level_->GetLevelData() );
+	// First frame is drawn before any simulation.
+	drawing_snapshots_[ front_snapshot_ ]->Fill( *level_, *player_, GetInterpolationFactor(), GetTickTime(), GetDrawingTime() );
 	//text_= new mx_Text();
 
 	need_capture_mouse_= true;
@@ -203,9 +253,15 @@ mx_MainLoop::~mx_MainLoop()
 	mx_SoundEngine::DeleteInstance();
 
 	//delete instance_->text_;
+	delete instance_->drawing_snapshots_[0];
+	delete instance_->drawing_snapshots_[1];
 	delete instance_->renderer_;
 	delete instance_->player_;
 	delete instance_->level_;
+	delete instance_->level_generator_;
+	delete instance_->level_snapshot_;
+
+	mx_ThreadPool::DeleteInstance();
 
 	wglMakeCurrent( NULL, NULL );
 	wglDeleteContext( hrc_ );
@@ -220,6 +276,7 @@ void mx_MainLoop::Loop()
 {
 	while(!quit_)
 	{
+		// Simulation is stopped here, so player and level may be changed.
 		MSG msg;
 		while ( PeekMessage(&msg,NULL,0,0,PM_REMOVE) )
 		{
@@ -237,32 +294,38 @@ void mx_MainLoop::Loop()
 			SetCursorPos( prev_cursor_pos_.x, prev_cursor_pos_.y );
 		}
 
-		static const float c_min_dt= 1.0f / 128.0f;
-		static const float c_max_dt= 1.0f /  16.0f;
-		DWORD current_time_ms= GetTickCount() - start_time_ms_;
-		float dt_s= float( current_time_ms - prev_time_ms_ ) * 0.001f;
-		if( dt_s >= c_min_dt )
+		// Geometry is streamed between frames, because renderer reads sectors geometry while drawing.
+		if( level_generator_ != NULL && level_generator_->UpdateGeometry( player_->GetSector() ) )
 		{
-			prev_time_ms_= current_time_ms;
-			dt_s_= dt_s < c_max_dt ? dt_s : c_max_dt;
-			toatal_time_s_+= dt_s_;
-
-			player_->Tick();
-			level_->Tick();
-			
+			level_->UpdateGeometry( level_generator_->GetLevelData() );
+			renderer_->UpdateWorldGeometry();
 		}
 
-		{ // Sound here
-				float player_mat[16];
-				player_->CreateRotationMatrix4( player_mat, true );
-				mx_SoundEngine::Instance()->SetListenerOrinetation( player_->Pos(),player_mat, player_->GetSpeed() );
-				mx_SoundEngine::Instance()->Tick();
+		mx_DrawingSnapshot& snapshot= *drawing_snapshots_[ front_snapshot_ ];
+		// Show mouse rotation without one frame delay.
+		snapshot.UpdateCameraRotation( *player_ );
+
+		LARGE_INTEGER current_frame_counter;
+		QueryPerformanceCounter( &current_frame_counter );
+		accumulated_time_s_+=
+			float( double( current_frame_counter.QuadPart - prev_frame_counter_.QuadPart ) / double( performance_frequency_.QuadPart ) );
+		prev_frame_counter_= current_frame_counter;
+		if( accumulated_time_s_ > MX_TICK_TIME_S * float(MX_MAX_TICKS_PER_FRAME) )
+			accumulated_time_s_= MX_TICK_TIME_S * float(MX_MAX_TICKS_PER_FRAME);
+
+		scheduled_tick_count_= 0;
+		while( accumulated_time_s_ >= MX_TICK_TIME_S )
+		{
+			accumulated_time_s_-= MX_TICK_TIME_S;
+			scheduled_tick_count_++;
 		}
 
+		mx_ThreadPool::Instance()->Start( SimulationJob, this, 1 );
+
 		glClearColor( 0.0f, 0.0f, 0.0f, 0.0f );
 		glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
-		renderer_->Draw();
+		renderer_->Draw( snapshot );
 		
 		/*
 		{ // texts
@@ -288,9 +351,40 @@ void mx_MainLoop::Loop()
 
 		// HACK. Bandicam disables depth test after SwapBuffers call
 		glEnable( GL_DEPTH_TEST );
+
+		mx_ThreadPool::Instance()->Wait();
+		front_snapshot_^= 1;
 	} // while !quit
 }
 
+void mx_MainLoop::SimulationJob( void* data, unsigned int job_index )
+{
+	(void)job_index;
+	((mx_MainLoop*)data)->Simulate();
+}
+
+void mx_MainLoop::Simulate()
+{
+	for( unsigned int i= 0; i < scheduled_tick_count_; i++ )
+	{
+		toatal_time_s_+= MX_TICK_TIME_S;
+
+		player_->Tick();
+		level_->Tick();
+	}
+
+	{ // Sound here
+		float player_mat[16];
+		player_->CreateRotationMatrix4( player_mat, true );
+		mx_SoundEngine::Instance()->SetListenerOrinetation( player_->Pos(),player_mat, player_->GetSpeed() );
+		mx_SoundEngine::Instance()->Tick();
+	}
+
+	drawing_snapshots_[ front_snapshot_ ^ 1 ]->Fill(
+		*level_, *player_,
+		GetInterpolationFactor(), GetTickTime(), GetDrawingTime() );
+}
+
 LRESULT CALLBACK mx_MainLoop::WindowProc( HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam )
 {
 	mx_Player* player= instance_->player_;
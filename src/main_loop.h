@@ -7,6 +7,14 @@
 #define MX_MIN_VIEWPORT_WIDTH  800
 #define MX_MIN_VIEWPORT_HEIGHT 600
 
+// Simulation runs with fixed time step. Drawing interpolates state between two last ticks.
+#define MX_TICK_TIME_S ( 1.0f / 64.0f )
+// Maximum ticks per frame. If frame is longer, rest of time is dropped and simulation slows down.
+#define MX_MAX_TICKS_PER_FRAME 4
+
+// Simulation and drawing are pipelined. While frame is drawn from snapshot, ticks of next frame run in worker thread
+// and write next snapshot. Input and level geometry streaming are processed between frames, when simulation stopped.
+
 class mx_MainLoop
 {
 public:
@@ -14,7 +22,11 @@ public:
 		unsigned int viewport_width, unsigned int viewport_height,
 		bool fullscreen, bool vsync,
 		bool invert_mouse_y,
-		float mouse_speed_x, float mouse_speed_y );
+		float mouse_speed_x, float mouse_speed_y,
+		// Level snapshot files. May be NULL.
+		const char* load_level_file_name, const char* save_level_file_name,
+		// Size of generated level, in cells. Ignored for loaded level.
+		unsigned int level_size_cells );
 
 	static mx_MainLoop* Instance();
 	static void DeleteInstance();
@@ -26,6 +38,8 @@ public:
 	// Time - in seconds
 	float GetTickTime() const; // time of current tick
 	float GetTime() const; // total time sinse game start, include this tick
+	float GetInterpolationFactor() const; // part of tick time, passed since current tick, in range [0; 1)
+	float GetDrawingTime() const; // time of drawn state - between previous and current ticks
 
 	void Loop();
 	void Quit();
@@ -35,7 +49,9 @@ private:
 		unsigned int viewport_width, unsigned int viewport_height,
 		bool fullscreen, bool vsync,
 		bool invert_mouse_y,
-		float mouse_speed_x, float mouse_speed_y );
+		float mouse_speed_x, float mouse_speed_y,
+		const char* load_level_file_name, const char* save_level_file_name,
+		unsigned int level_size_cells );
 	~mx_MainLoop();
 
 	mx_MainLoop(const mx_MainLoop&){};
@@ -49,6 +65,10 @@ private:
 
 	void CalculateFPS();
 
+	static void SimulationJob( void* data, unsigned int job_index );
+	// Runs scheduled ticks, updates sound and fills back drawing snapshot.
+	void Simulate();
+
 private:
 	static mx_MainLoop* instance_;
 
@@ -67,9 +87,13 @@ private:
 	bool need_capture_mouse_;
 
 	DWORD start_time_ms_;
-	DWORD prev_time_ms_;
+	// Frame time is measured with performance counter. GetTickCount resolution is comparable with tick time.
+	LARGE_INTEGER performance_frequency_;
+	LARGE_INTEGER prev_frame_counter_;
 	float dt_s_;
 	float toatal_time_s_;
+	float accumulated_time_s_; // time, not simulated yet
+	unsigned int scheduled_tick_count_; // ticks for current simulation job
 
 	struct
 	{
@@ -79,8 +103,14 @@ private:
 	}fps_calc_;
 
 	mx_Player* player_;
+	// Alive while game runs, builds level geometry around player. NULL for level from snapshot.
+	mx_LevelGenerator* level_generator_;
+	mx_LevelSnapshot* level_snapshot_;
 	mx_Level* level_;
 	mx_Renderer* renderer_;
+	// Front snapshot is drawn, back snapshot is written by simulation.
+	mx_DrawingSnapshot* drawing_snapshots_[2];
+	unsigned int front_snapshot_;
 	//mx_Text* text_;
 };
 
@@ -117,4 +147,14 @@ inline float mx_MainLoop::GetTickTime() const
 inline float mx_MainLoop::GetTime() const
 {
 	return toatal_time_s_;
+}
+
+inline float mx_MainLoop::GetInterpolationFactor() const
+{
+	return accumulated_time_s_ * ( 1.0f / MX_TICK_TIME_S );
+}
+
+inline float mx_MainLoop::GetDrawingTime() const
+{
+	return toatal_time_s_ - ( MX_TICK_TIME_S - accumulated_time_s_ );
 }
\ No newline at end of file
@@ -0,0 +1,298 @@
+#include <cmath>
+#include <cstring>
+
+#include "mx_assert.h"
+
+#include "mesh_optimization.h"
+
+#define MX_NO_VERTEX 0xFFFFFFFF
+#define MX_NO_TRIANGLE 0xFFFFFFFF
+
+// Size of vertex data, which is compared in welding. Padding bytes are not compared.
+static const unsigned int c_vertex_significant_size= sizeof(mx_LevelVertex) - sizeof(((mx_LevelVertex*)0)->pad);
+
+/*
+---------Vertices welding---------
+*/
+
+static unsigned int HashVertex( const mx_LevelVertex& v )
+{
+	const unsigned char* bytes= (const unsigned char*) &v;
+	unsigned int hash= 2166136261u;
+	for( unsigned int i= 0; i < c_vertex_significant_size; i++ )
+	{
+		hash^= bytes[i];
+		hash*= 16777619u;
+	}
+	return hash;
+}
+
+// Returns new vertex count. Welded vertices placed at begin of array, triangle indices - local.
+static unsigned int WeldVertices( mx_LevelVertex* vertices, unsigned int vertex_count, unsigned int* indices, unsigned int index_count )
+{
+	unsigned int table_size= 1;
+	while( table_size < vertex_count * 2 ) table_size<<= 1;
+
+	unsigned int* table= new unsigned int[ table_size ];
+	unsigned int* remap= new unsigned int[ vertex_count ];
+	for( unsigned int i= 0; i < table_size; i++ )
+		table[i]= MX_NO_VERTEX;
+
+	unsigned int new_vertex_count= 0;
+	for( unsigned int v= 0; v < vertex_count; v++ )
+	{
+		unsigned int slot= HashVertex( vertices[v] ) & ( table_size - 1 );
+		while( table[slot] != MX_NO_VERTEX &&
+			std::memcmp( &vertices[ table[slot] ], &vertices[v], c_vertex_significant_size ) != 0 )
+			slot= ( slot + 1 ) & ( table_size - 1 );
+
+		if( table[slot] == MX_NO_VERTEX )
+		{
+			// New unique vertex. Unique vertices go in same order, so slot is never before v.
+			if( new_vertex_count != v )
+				vertices[ new_vertex_count ]= vertices[v];
+			table[slot]= new_vertex_count;
+			new_vertex_count++;
+		}
+		remap[v]= table[slot];
+	}
+
+	for( unsigned int i= 0; i < index_count; i++ )
+		indices[i]= remap[ indices[i] ];
+
+	delete[] table;
+	delete[] remap;
+	return new_vertex_count;
+}
+
+/*
+---------Triangles ordering---------
+Tom Forsyth's "Linear-Speed Vertex Cache Optimisation".
+Each step takes triangle with best score. Vertex score depends on position in simulated LRU cache
+and on count of not yet added triangles, which use this vertex.
+*/
+
+static float VertexScore( int cache_position, unsigned int remaining_triangles )
+{
+	if( remaining_triangles == 0 )
+		return -1.0f;
+
+	const float c_last_triangle_score= 0.75f;
+	const float c_cache_decay_power= 1.5f;
+	const float c_valence_boost_scale= 2.0f;
+	const float c_valence_boost_power= 0.5f;
+
+	float score= 0.0f;
+	if( cache_position >= 0 )
+	{
+		if( cache_position < 3 )
+			score= c_last_triangle_score; // vertices of last triangle - fixed score, to not prefer any of them
+		else
+			score= std::powf( 1.0f - float( cache_position - 3 ) / float( MX_VERTEX_CACHE_SIZE - 3 ), c_cache_decay_power );
+	}
+	// Boost vertices with few remaining triangles, to not leave lone triangles.
+	score+= c_valence_boost_scale * std::powf( float(remaining_triangles), -c_valence_boost_power );
+	return score;
+}
+
+static void OrderTriangles( unsigned int* indices, unsigned int triangle_count, unsigned int vertex_count )
+{
+	unsigned int* vertex_triangles_offset= new unsigned int[ vertex_count + 1 ];
+	unsigned int* vertex_remaining_triangles= new unsigned int[ vertex_count ];
+	int* vertex_cache_position= new int[ vertex_count ];
+	float* vertex_score= new float[ vertex_count ];
+	unsigned int* vertex_triangles= new unsigned int[ triangle_count * 3 ];
+	float* triangle_score= new float[ triangle_count ];
+	bool* triangle_added= new bool[ triangle_count ];
+	unsigned int* out_indices= new unsigned int[ triangle_count * 3 ];
+
+	// Triangles of each vertex.
+	std::memset( vertex_remaining_triangles, 0, sizeof(unsigned int) * vertex_count );
+	for( unsigned int i= 0; i < triangle_count * 3; i++ )
+		vertex_remaining_triangles[ indices[i] ]++;
+	vertex_triangles_offset[0]= 0;
+	for( unsigned int v= 0; v < vertex_count; v++ )
+		vertex_triangles_offset[ v + 1 ]= vertex_triangles_offset[v] + vertex_remaining_triangles[v];
+	std::memset( vertex_remaining_triangles, 0, sizeof(unsigned int) * vertex_count );
+	for( unsigned int i= 0; i < triangle_count * 3; i++ )
+	{
+		unsigned int v= indices[i];
+		vertex_triangles[ vertex_triangles_offset[v] + vertex_remaining_triangles[v] ]= i / 3;
+		vertex_remaining_triangles[v]++;
+	}
+
+	for( unsigned int v= 0; v < vertex_count; v++ )
+	{
+		vertex_cache_position[v]= -1;
+		vertex_score[v]= VertexScore( -1, vertex_remaining_triangles[v] );
+	}
+
+	unsigned int best_triangle= MX_NO_TRIANGLE;
+	float best_score= -1.0f;
+	for( unsigned int t= 0; t < triangle_count; t++ )
+	{
+		triangle_added[t]= false;
+		triangle_score[t]= vertex_score[ indices[t*3] ] + vertex_score[ indices[t*3+1] ] + vertex_score[ indices[t*3+2] ];
+		if( triangle_score[t] > best_score )
+		{
+			best_score= triangle_score[t];
+			best_triangle= t;
+		}
+	}
+
+	// Extra 3 entries - for vertices, pushed out of cache by new triangle.
+	unsigned int cache[ MX_VERTEX_CACHE_SIZE + 3 ];
+	unsigned int cache_size= 0;
+
+	for( unsigned int i= 0; i < triangle_count; i++ )
+	{
+		if( best_triangle == MX_NO_TRIANGLE )
+		{
+			// No triangles with vertices in cache - search in all triangles.
+			best_score= -1.0f;
+			for( unsigned int t= 0; t < triangle_count; t++ )
+				if( !triangle_added[t] && triangle_score[t] > best_score )
+				{
+					best_score= triangle_score[t];
+					best_triangle= t;
+				}
+		}
+
+		unsigned int t= best_triangle;
+		const unsigned int* triangle_indices= indices + t * 3;
+		std::memcpy( out_indices + i * 3, triangle_indices, sizeof(unsigned int) * 3 );
+		triangle_added[t]= true;
+
+		// Remove triangle from lists of active triangles of its vertices.
+		for( unsigned int j= 0; j < 3; j++ )
+		{
+			unsigned int v= triangle_indices[j];
+			unsigned int* triangles= vertex_triangles + vertex_triangles_offset[v];
+			unsigned int& remaining= vertex_remaining_triangles[v];
+			for( unsigned int k= 0; k < remaining; k++ )
+				if( triangles[k] == t )
+				{
+					triangles[k]= triangles[ remaining - 1 ];
+					remaining--;
+					break;
+				}
+		}
+
+		// Move vertices of triangle to front of cache.
+		unsigned int new_cache[ MX_VERTEX_CACHE_SIZE + 3 ];
+		unsigned int new_cache_size= 0;
+		for( unsigned int j= 0; j < 3; j++ )
+			new_cache[ new_cache_size++ ]= triangle_indices[j];
+		for( unsigned int j= 0; j < cache_size; j++ )
+		{
+			unsigned int v= cache[j];
+			if( v != triangle_indices[0] && v != triangle_indices[1] && v != triangle_indices[2] )
+				new_cache[ new_cache_size++ ]= v;
+		}
+
+		// Update scores of vertices in cache and of vertices, pushed out of cache.
+		for( unsigned int j= 0; j < new_cache_size; j++ )
+		{
+			unsigned int v= new_cache[j];
+			vertex_cache_position[v]= j < MX_VERTEX_CACHE_SIZE ? int(j) : -1;
+			vertex_score[v]= VertexScore( vertex_cache_position[v], vertex_remaining_triangles[v] );
+		}
+
+		best_triangle= MX_NO_TRIANGLE;
+		best_score= -1.0f;
+		for( unsigned int j= 0; j < new_cache_size; j++ )
+		{
+			unsigned int v= new_cache[j];
+			const unsigned int* triangles= vertex_triangles + vertex_triangles_offset[v];
+			for( unsigned int k= 0; k < vertex_remaining_triangles[v]; k++ )
+			{
+				unsigned int tri= triangles[k];
+				const unsigned int* tri_indices= indices + tri * 3;
+				triangle_score[tri]= vertex_score[ tri_indices[0] ] + vertex_score[ tri_indices[1] ] + vertex_score[ tri_indices[2] ];
+				if( triangle_score[tri] > best_score )
+				{
+					best_score= triangle_score[tri];
+					best_triangle= tri;
+				}
+			}
+		}
+
+		cache_size= new_cache_size < MX_VERTEX_CACHE_SIZE ? new_cache_size : MX_VERTEX_CACHE_SIZE;
+		std::memcpy( cache, new_cache, sizeof(unsigned int) * cache_size );
+	}
+
+	std::memcpy( indices, out_indices, sizeof(unsigned int) * triangle_count * 3 );
+
+	delete[] vertex_triangles_offset;
+	delete[] vertex_remaining_triangles;
+	delete[] vertex_cache_position;
+	delete[] vertex_score;
+	delete[] vertex_triangles;
+	delete[] triangle_score;
+	delete[] triangle_added;
+	delete[] out_indices;
+}
+
+// Reorders vertices in order of first use in indices, so vertex fetch goes forward.
+static void OrderVertices( mx_LevelVertex* vertices, unsigned int vertex_count, unsigned int* indices, unsigned int index_count )
+{
+	unsigned int* remap= new unsigned int[ vertex_count ];
+	mx_LevelVertex* new_vertices= new mx_LevelVertex[ vertex_count ];
+	for( unsigned int v= 0; v < vertex_count; v++ )
+		remap[v]= MX_NO_VERTEX;
+
+	unsigned int new_vertex_count= 0;
+	for( unsigned int i= 0; i < index_count; i++ )
+	{
+		unsigned int v= indices[i];
+		if( remap[v] == MX_NO_VERTEX )
+		{
+			new_vertices[ new_vertex_count ]= vertices[v];
+			remap[v]= new_vertex_count;
+			new_vertex_count++;
+		}
+		indices[i]= remap[v];
+	}
+	// Vertices without triangles are dropped.
+
+	std::memcpy( vertices, new_vertices, sizeof(mx_LevelVertex) * new_vertex_count );
+
+	delete[] remap;
+	delete[] new_vertices;
+}
+
+unsigned int mxOptimizeLevelMesh(
+	mx_LevelVertex* vertices, unsigned int first_vertex, unsigned int vertex_count,
+	mx_LevelTriangle* triangles, unsigned int triangle_count )
+{
+	if( triangle_count == 0 )
+		return 0;
+
+	// Work with local indices.
+	unsigned int index_count= triangle_count * 3;
+	unsigned int* indices= new unsigned int[ index_count ];
+	for( unsigned int t= 0; t < triangle_count; t++ )
+		for( unsigned int j= 0; j < 3; j++ )
+		{
+			MX_ASSERT( triangles[t].vertex_index[j] >= first_vertex && triangles[t].vertex_index[j] < first_vertex + vertex_count );
+			indices[ t * 3 + j ]= triangles[t].vertex_index[j] - first_vertex;
+		}
+
+	mx_LevelVertex* sector_vertices= vertices + first_vertex;
+	unsigned int new_vertex_count= WeldVertices( sector_vertices, vertex_count, indices, index_count );
+	OrderTriangles( indices, triangle_count, new_vertex_count );
+	OrderVertices( sector_vertices, new_vertex_count, indices, index_count );
+
+	// Vertices without triangles removed.
+	new_vertex_count= 0;
+	for( unsigned int t= 0; t < triangle_count; t++ )
+		for( unsigned int j= 0; j < 3; j++ )
+		{
+			unsigned int index= indices[ t * 3 + j ];
+			if( index >= new_vertex_count ) new_vertex_count= index + 1;
+			triangles[t].vertex_index[j]= index + first_vertex;
+		}
+
+	delete[] indices;
+	return new_vertex_count;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+#include "game_constants.h"
+#include "level_generator.h"
+
+// Size of post-transform vertex cache, which is simulated for triangles ordering.
+#define MX_VERTEX_CACHE_SIZE 32
+
+// Optimizes mesh of one sector. Triangles must reference only vertices of range [first_vertex; first_vertex + vertex_count).
+// Equal vertices are welded, triangles are reordered for vertex cache (Forsyth algorithm),
+// vertices are reordered in order of first use. Result vertices are placed at begin of range.
+// Returns new vertex count.
+unsigned int mxOptimizeLevelMesh(
+	mx_LevelVertex* vertices, unsigned int first_vertex, unsigned int vertex_count,
+	mx_LevelTriangle* triangles, unsigned int triangle_count );
\ No newline at end of file
@@ -52,6 +52,8 @@ mx_Monster::mx_Monster(
 	{
 		VEC3_CPY( pos_, pos );
 	}
+
+	SavePrevState();
 }
 
 mx_Monster::~mx_Monster()
@@ -27,6 +27,68 @@ inline float mxRound( float x )
 
 #define VEC3_CPY(dst,src) (dst)[0]= (src)[0]; (dst)[1]= (src)[1]; (dst)[2]= src[2];
 
+union mxFloatBits
+{
+	float f;
+	unsigned int u;
+};
+
+// Round to nearest even. Overflow gives infinity, NaN stays NaN.
+inline unsigned short mxFloatToHalf( float f )
+{
+	static const unsigned int c_half_overflow= ( 127 + 16 ) << 23;
+	static const unsigned int c_min_half_normal= ( 127 - 14 ) << 23;
+	mxFloatBits denorm_magic;
+	denorm_magic.u= ( ( 127 - 15 ) + ( 23 - 10 ) + 1 ) << 23;
+
+	mxFloatBits b;
+	b.f= f;
+	unsigned int sign= b.u & 0x80000000;
+	b.u^= sign;
+
+	unsigned int h;
+	if( b.u >= c_half_overflow )
+		h= b.u > 0x7f800000 ? 0x7e00 : 0x7c00;
+	else if( b.u < c_min_half_normal )
+	{
+		// Float addition makes rounding of denormals.
+		b.f+= denorm_magic.f;
+		h= b.u - denorm_magic.u;
+	}
+	else
+	{
+		unsigned int mantissa_odd= ( b.u >> 13 ) & 1;
+		b.u-= ( 127 - 15 ) << 23;
+		b.u+= 0xfff + mantissa_odd;
+		h= b.u >> 13;
+	}
+
+	return (unsigned short)( h | ( sign >> 16 ) );
+}
+
+inline float mxHalfToFloat( unsigned short h )
+{
+	static const unsigned int c_shifted_exp= 0x7c00 << 13;
+	mxFloatBits magic;
+	magic.u= ( 127 - 14 ) << 23;
+
+	mxFloatBits b;
+	b.u= ( h & 0x7fff ) << 13;
+	unsigned int exp= b.u & c_shifted_exp;
+	b.u+= ( 127 - 15 ) << 23;
+
+	if( exp == c_shifted_exp ) // inf or NaN
+		b.u+= ( 128 - 16 ) << 23;
+	else if( exp == 0 ) // zero or denormal
+	{
+		b.u+= 1 << 23;
+		b.f-= magic.f;
+	}
+
+	b.u|= ( h & 0x8000 ) << 16;
+	return b.f;
+}
+
 void mxVec3Mul( const float* v, float s, float* v_out );
 void mxVec3Mul( float* v, float s );
 void mxVec3Mul( const float* v0, const float* v1, float* v_out );
@@ -50,19 +50,19 @@ void mx_ParticlesManager::Tick( float dt )
 	}
 }
 
-void mx_ParticlesManager::AddBullet( const mx_Bullet* bullet )
+void mx_ParticlesManager::AddBullet( BulletType type, const float* pos, const float* speed )
 {
-	switch( bullet->type )
+	switch( type )
 	{
 	case MachinegunBullet:
 		break;
 
 	case Rocket:
-		AddRocketTrail( bullet );
+		AddRocketTrail( pos, speed );
 		break;
 	
 	case PlasmaBall:
-		AddPlasmaBall( bullet );
+		AddPlasmaBall( pos, speed );
 		break;
 
 	default:
@@ -74,9 +74,10 @@ void mx_ParticlesManager::AddBullet( const mx_Bullet* bullet )
 void mx_ParticlesManager::AddBlast( const float* pos )
 {
 	const unsigned int c_particles_count= 768;
+	unsigned int particle_count= ClampNewParticlesCount( c_particles_count );
 
 	Particle* particle= particles_ + particle_count_;
-	for( unsigned int i= 0; i< c_particles_count; )
+	for( unsigned int i= 0; i< particle_count; )
 	{
 		for( unsigned int j= 0; j< 3; j++ )
 			particle->direction[j]= randomizer_.RandF( -1.0f, 1.0f );
@@ -94,15 +95,16 @@ void mx_ParticlesManager::AddBlast( const float* pos )
 
 		i++, particle++;
 	}
-	particle_count_+= c_particles_count;
+	particle_count_+= particle_count;
 }
 
 void mx_ParticlesManager::AddSpawn( const float* pos )
 {
 	const unsigned int c_particles_count= 256;
+	unsigned int particle_count= ClampNewParticlesCount( c_particles_count );
 
 	Particle* particle= particles_ + particle_count_;
-	for( unsigned int i= 0; i< c_particles_count; )
+	for( unsigned int i= 0; i< particle_count; )
 	{
 		for( unsigned int j= 0; j< 3; j++ )
 			particle->direction[j]= randomizer_.RandF( -1.0f, 1.0f );
@@ -121,21 +123,38 @@ void mx_ParticlesManager::AddSpawn( const float* pos )
 
 		i++, particle++;
 	}
-	particle_count_+= c_particles_count;
+	particle_count_+= particle_count;
 }
 
-void mx_ParticlesManager::PrepareParticlesVertices( mx_ParticleVertex* out_vertices ) const
+void mx_ParticlesManager::PrepareParticlesVertices( mx_ParticleVertex* out_vertices, float interpolation_k ) const
 {
+	float back_time= dt_ * ( 1.0f - interpolation_k );
+	float time= current_tick_time_ - back_time;
+
 	const Particle* particle= particles_;
 	mx_ParticleVertex* vertex= out_vertices;
 	for( unsigned int i= 0; i< particle_count_; i++, particle++, vertex++ )
 	{
-		VEC3_CPY( vertex->pos_size, particle->pos );
+		// Move particles back. Particles, spawned in current tick, are not moved yet,
+		// except plasma ball particles, which move together with bullet.
+		float age= current_tick_time_ - particle->spawn_time;
+		float particle_back_time= particle->type == Particle::PlasmaBall || age > back_time ? back_time : age;
+		mxVec3Mul( particle->direction, -particle->velocity * particle_back_time, vertex->pos_size );
+		mxVec3Add( vertex->pos_size, particle->pos );
+
+		// Rocket trail particles, spawned after drawing time, are invisible.
+		if( particle->type == Particle::RocketTrail && particle->spawn_time > time )
+		{
+			vertex->pos_size[3]= 0.0f;
+			vertex->color[0]= vertex->color[1]= vertex->color[2]= 0.0f;
+			continue;
+		}
+
 		switch( particle->type )
 		{
 		case Particle::RocketBlast:
 			{
-				float lifetime_k= ( current_tick_time_ - particle->spawn_time ) * ( 1.0f / MX_BLAST_FIRE_LIFETIME );
+				float lifetime_k= ( time - particle->spawn_time ) * ( 1.0f / MX_BLAST_FIRE_LIFETIME );
 				vertex->pos_size[3]= 0.02f + 0.11f * lifetime_k;
 
 				float luminance= 1.0f - lifetime_k;
@@ -145,7 +164,7 @@ void mx_ParticlesManager::PrepareParticlesVertices( mx_ParticleVertex* out_verti
 			break;
 		case Particle::RocketTrail:
 			{
-				float lifetime_k= ( current_tick_time_ - particle->spawn_time ) * ( 1.0f / MX_ROCKET_TRAIL_PARTICLE_LIFETIME  );
+				float lifetime_k= ( time - particle->spawn_time ) * ( 1.0f / MX_ROCKET_TRAIL_PARTICLE_LIFETIME  );
 				vertex->pos_size[3]= 0.02f + 0.08f * lifetime_k;
 
 				float luminance= std::powf( 1.0f - lifetime_k, 6.0f );
@@ -162,7 +181,7 @@ void mx_ParticlesManager::PrepareParticlesVertices( mx_ParticleVertex* out_verti
 			{
 				vertex->pos_size[3]= 0.03f;
 
-				float lifetime_k= ( current_tick_time_ - particle->spawn_time ) * ( 1.0f / MX_SPAWN_PARTICLE_LIFETIME );
+				float lifetime_k= ( time - particle->spawn_time ) * ( 1.0f / MX_SPAWN_PARTICLE_LIFETIME );
 				static const float c_colors[2][3]=
 				{
 					{ 1.0f, 0.1f, 1.0f },
@@ -177,23 +196,24 @@ void mx_ParticlesManager::PrepareParticlesVertices( mx_ParticleVertex* out_verti
 	}
 }
 
-void mx_ParticlesManager::AddRocketTrail( const mx_Bullet* rocket )
+void mx_ParticlesManager::AddRocketTrail( const float* pos, const float* speed )
 {
 	const float c_particles_per_meter= 40.0f;
 
-	float rocket_speed= mxVec3Len(rocket->speed);
+	float rocket_speed= mxVec3Len(speed);
 	float particles_per_second= c_particles_per_meter * rocket_speed;
 
 	unsigned int particle_count= (unsigned int)
 		( std::floorf(current_tick_time_ * particles_per_second) - std::ceilf(prev_tick_time_ * particles_per_second) )
 		+ 1u;
+	particle_count= ClampNewParticlesCount( particle_count );
 
 	Particle* particle= particles_ + particle_count_;
 	float partice_pos[3];
 	float particle_step[3];
 	float particle_dir[3];
-	VEC3_CPY( partice_pos, rocket->pos );
-	mxVec3Mul( rocket->speed, -1.0f / rocket_speed, particle_dir );
+	VEC3_CPY( partice_pos, pos );
+	mxVec3Mul( speed, -1.0f / rocket_speed, particle_dir );
 	mxVec3Mul( particle_dir, 1.0f / c_particles_per_meter, particle_step );
 	float dt= rocket_speed / c_particles_per_meter;
 	float t= current_tick_time_;
@@ -225,31 +245,48 @@ void mx_ParticlesManager::AddRocketTrail( const mx_Bullet* rocket )
 	particle_count_+= particle_count;
 }
 
-void mx_ParticlesManager::AddPlasmaBall( const mx_Bullet* plasma_ball )
+void mx_ParticlesManager::AddPlasmaBall( const float* pos, const float* speed )
 {
 	const unsigned int c_particles_in_ball= 9;
 	const float c_step= 0.05f;
 
+	// Ball is not drawn partially.
+	if( ClampNewParticlesCount( c_particles_in_ball ) < c_particles_in_ball )
+		return;
+
 	float dir[3];
-	mxVec3Normalize( plasma_ball->speed, dir );
+	mxVec3Normalize( speed, dir );
 
-	float pos[3];
+	float particle_pos[3];
 	float d_pos[3];
-	VEC3_CPY( pos, plasma_ball->pos );
+	VEC3_CPY( particle_pos, pos );
 	mxVec3Mul( dir, c_step * float(c_particles_in_ball) * 0.5f, d_pos );
-	mxVec3Sub( pos, d_pos );
+	mxVec3Sub( particle_pos, d_pos );
 
 	float pos_step[3];
 	mxVec3Mul( dir, c_step, pos_step );
 
+	float bullet_speed= mxVec3Len( speed );
+
 	Particle* p= particles_ + particle_count_;
-	for( unsigned int i= 0; i < c_particles_in_ball; i++, p++, mxVec3Add( pos, pos_step ) )
+	for( unsigned int i= 0; i < c_particles_in_ball; i++, p++, mxVec3Add( particle_pos, pos_step ) )
 	{
 		p->type= Particle::PlasmaBall;
 		p->spawn_time= current_tick_time_;
 		p->life_time= 0.0f;
-		VEC3_CPY( p->pos, pos );
+		VEC3_CPY( p->pos, particle_pos );
+		// Particles move with bullet, for drawing interpolation.
+		VEC3_CPY( p->direction, dir );
+		p->velocity= bullet_speed;
+		p->acceleration= 0.0f;
 	}
 
 	particle_count_+= c_particles_in_ball;
+}
+
+unsigned int mx_ParticlesManager::ClampNewParticlesCount( unsigned int count ) const
+{
+	MX_ASSERT( particle_count_ <= MX_MAX_PARTICLES );
+	unsigned int free_count= MX_MAX_PARTICLES - particle_count_;
+	return count < free_count ? count : free_count;
 }
\ No newline at end of file
@@ -21,12 +21,13 @@ public:
 
 	void Tick( float dt );
 
-	void AddBullet( const mx_Bullet* bullet );
+	void AddBullet( BulletType type, const float* pos, const float* speed );
 	void AddBlast( const float* pos );
 	void AddSpawn( const float* pos );
 
 	unsigned int GetParticlesCount() const;
-	void PrepareParticlesVertices( mx_ParticleVertex* out_vertices ) const;
+	// Prepares particles between previous and current ticks. k - interpolation factor.
+	void PrepareParticlesVertices( mx_ParticleVertex* out_vertices, float interpolation_k ) const;
 
 private:
 	struct Particle
@@ -50,8 +51,10 @@ private:
 	};
 
 private:
-	void AddRocketTrail( const mx_Bullet* rocket );
-	void AddPlasmaBall( const mx_Bullet* plasma_ball );
+	void AddRocketTrail( const float* pos, const float* speed );
+	void AddPlasmaBall( const float* pos, const float* speed );
+	// Returns count of particles, which can be added, but not more, than requested. Effects over limit are cut.
+	unsigned int ClampNewParticlesCount( unsigned int count ) const;
 
 	float prev_tick_time_;
 	float current_tick_time_;
@@ -1,3 +1,5 @@
+#include <cstring>
+
 #include "mx_math.h"
 
 #include "pawn.h"
@@ -11,24 +13,58 @@ mx_Pawn::~mx_Pawn()
 {
 }
 
-void mx_Pawn::CreateRotationMatrix4( float* out_mat, bool invert ) const
+static void AxisToMatrix4( const float (*axis)[3], float* out_mat, bool invert )
 {
 	mxMat4Identity( out_mat );
 	for( unsigned int i= 0; i < 3; i++ )
 	{
-		out_mat[ 4 * i + 0 ]= axis_[0][i];
-		out_mat[ 4 * i + 1 ]= axis_[1][i];
-		out_mat[ 4 * i + 2 ]= axis_[2][i];
+		out_mat[ 4 * i + 0 ]= axis[0][i];
+		out_mat[ 4 * i + 1 ]= axis[1][i];
+		out_mat[ 4 * i + 2 ]= axis[2][i];
 	}
 	if( invert )
 		mxMat4Transpose( out_mat );
 }
 
+static void OrthonormalizeAxis( float (*axis)[3] )
+{
+	mxVec3Cross( axis[0], axis[1], axis[2] );
+	mxVec3Cross( axis[1], axis[2], axis[0] );
+	mxVec3Normalize( axis[0] );
+	mxVec3Normalize( axis[1] );
+	mxVec3Normalize( axis[2] );
+}
+
+void mx_Pawn::CreateRotationMatrix4( float* out_mat, bool invert ) const
+{
+	AxisToMatrix4( axis_, out_mat, invert );
+}
+
+void mx_Pawn::SavePrevState()
+{
+	VEC3_CPY( prev_pos_, pos_ );
+	std::memcpy( prev_axis_, axis_, sizeof(axis_) );
+}
+
+void mx_Pawn::GetInterpolatedPos( float k, float* out_pos ) const
+{
+	for( unsigned int j= 0; j < 3; j++ )
+		out_pos[j]= prev_pos_[j] + ( pos_[j] - prev_pos_[j] ) * k;
+}
+
+void mx_Pawn::CreateInterpolatedRotationMatrix4( float k, float* out_mat, bool invert ) const
+{
+	// Rotation per tick is small, so linear interpolation of axis with orthonormalization is enough.
+	float axis[3][3];
+	for( unsigned int i= 0; i < 3; i++ )
+		for( unsigned int j= 0; j < 3; j++ )
+			axis[i][j]= prev_axis_[i][j] + ( axis_[i][j] - prev_axis_[i][j] ) * k;
+	OrthonormalizeAxis( axis );
+
+	AxisToMatrix4( axis, out_mat, invert );
+}
+
 void mx_Pawn::CorrectAxis()
 {
-	mxVec3Cross( axis_[0], axis_[1], axis_[2] );
-	mxVec3Cross( axis_[1], axis_[2], axis_[0] );
-	mxVec3Normalize( axis_[0] );
-	mxVec3Normalize( axis_[1] );
-	mxVec3Normalize( axis_[2] );
+	OrthonormalizeAxis( axis_ );
 }
\ No newline at end of file
@@ -9,6 +9,12 @@ public:
 	const float* Pos() const;
 	void CreateRotationMatrix4( float* out_mat, bool invert ) const;
 
+	// Saves position and axis for drawing interpolation. Call it at start of tick.
+	void SavePrevState();
+	// State between previous and current ticks. k - interpolation factor, 0 - previous state, 1 - current state.
+	void GetInterpolatedPos( float k, float* out_pos ) const;
+	void CreateInterpolatedRotationMatrix4( float k, float* out_mat, bool invert ) const;
+
 	int GetHealth() const;
 	void Hit( int damage );
 
@@ -20,6 +26,9 @@ protected:
 	float pos_[3];
 	float axis_[3][3];
 
+	float prev_pos_[3];
+	float prev_axis_[3][3];
+
 	int health_;
 };
 
@@ -35,6 +35,7 @@ mx_Player::mx_Player()
 	pos_[0]= pos_[1]= pos_[2]= 0.0f;
 
 	SetupAfterRespawn();
+	SavePrevState();
 }
 
 mx_Player::~mx_Player()
@@ -44,6 +45,8 @@ mx_Player::~mx_Player()
 void mx_Player::SetPos( const float* pos )
 {
 	VEC3_CPY( pos_, pos );
+	// Teleport - do not interpolate from old position.
+	SavePrevState();
 }
 
 void mx_Player::AddHealth( int health )
@@ -58,6 +61,8 @@ void mx_Player::Tick()
 	float dt= mx_MainLoop::Instance()->GetTickTime();
 	float total_time= mx_MainLoop::Instance()->GetTime();
 
+	SavePrevState();
+
 	if( is_dead_ )
 	{
 		if( lives_ != 0 && total_time - death_time_ >= mx_GameConstants::player_respawn_time )
@@ -184,7 +189,7 @@ void mx_Player::Tick()
 	if( !debug_noclip_ )
 #endif
 	{
-		sector_= level_->FindSectorForPoint( pos_ );
+		sector_= level_->FindSectorForPoint( pos_, sector_ );
 		if( sector_ )
 		{
 			CollideWithSector(sector_);
@@ -119,6 +119,7 @@ private:
 inline void mx_Player::SetLevel( mx_Level* level )
 {
 	level_= level;
+	sector_= NULL;
 }
 
 inline void mx_Player::AddAmmo( BulletType type, unsigned int count )
@@ -1,17 +1,26 @@
+#include <cstring>
+
+#include "drawing_snapshot.h"
 #include "level.h"
 #include "main_loop.h"
-#include "monster.h"
 #include "mx_assert.h"
 #include "mx_math.h"
 #include "particles_manager.h"
-#include "player.h"
 #include "shaders.h"
 #include "texture.h"
+#include "texture_cache.h"
+#include "texture_compression.h"
+#include "thread_pool.h"
 
 #include "renderer.h"
 
 #define MX_MAX_GUI_VERTICES 8192
 
+// From EXT_texture_compression_s3tc, absent in core profile header.
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
 struct GuiVertex
 {
 	short pos[2];
@@ -20,6 +29,8 @@ struct GuiVertex
 
 static const float g_texture_aray_coord_eps= 0.1f;
 
+static const char g_texture_cache_file_name[]= "Micro-X.tcache";
+
 static const float g_bullets_light_intensity[LastBullet]=
 {
 	0.05f,
@@ -40,29 +51,153 @@ static const ModelTexture g_ammo_to_texture_table[LastBullet]=
 	TexturePlasmaAmmo,
 };
 
-static void CreateBasisChangeMatrix( float* mat )
+// Texture generation jobs - level textures, level normal maps, models textures.
+#define MX_TEXTURE_JOB_COUNT ( LastLevelTexture * 2 + LastModelTexture )
+
+static const unsigned int g_texture_array_count= 3;
+static const unsigned int g_texture_arrays_size_log2[ g_texture_array_count ]= { 10, 10, 9 };
+static const unsigned int g_texture_arrays_layers[ g_texture_array_count ]= { LastLevelTexture, LastLevelTexture, LastModelTexture };
+// Alpha of albedo textures is emissive factor, so BC3 is used instead of BC1.
+static const mx_TextureCompression g_texture_arrays_compression[ g_texture_array_count ]=
 {
-	mxMat4RotateX( mat, -MX_PI2 );
-	float tmp_mat[16];
-	mxMat4Identity( tmp_mat );
-	tmp_mat[10]= -1.0f;
-	mxMat4Mul( mat, tmp_mat );
+	TextureCompressionBC3, TextureCompressionBC5, TextureCompressionBC3
+};
+static const GLenum g_texture_arrays_internal_format[ g_texture_array_count ]=
+{
+	GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_COMPRESSED_RG_RGTC2, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+};
+
+static void GetTextureJobLayer( unsigned int job_index, unsigned int* out_array_index, unsigned int* out_layer )
+{
+	unsigned int a= 0;
+	while( job_index >= g_texture_arrays_layers[a] )
+	{
+		job_index-= g_texture_arrays_layers[a];
+		a++;
+	}
+	*out_array_index= a;
+	*out_layer= job_index;
 }
 
-static void MarkSectors_r( mx_LevelSector* sector, unsigned int tag, unsigned int depth )
+static unsigned int TextureJobCacheKey( unsigned int job_index )
 {
-	sector->traverse_id= tag;
+	unsigned int array_index, layer;
+	GetTextureJobLayer( job_index, &array_index, &layer );
+	return ( array_index << 16 ) | ( layer << 8 ) | g_texture_arrays_size_log2[ array_index ];
+}
 
-	if( depth == 0 )
-		return;
+// Generators seeds are constants in generators code, so generator version covers them too.
+static unsigned int TextureJobCacheVersion( unsigned int job_index )
+{
+	unsigned int array_index, layer;
+	GetTextureJobLayer( job_index, &array_index, &layer );
+
+	unsigned int generator_version;
+	if( array_index == 0 )
+		generator_version= gen_level_textures_versions[ layer ];
+	else if( array_index == 1 )
+		generator_version= gen_level_textures_height_map_versions[ layer ];
+	else
+		generator_version= gen_models_textures_versions[ layer ];
 
-	for( unsigned int i= 0; i < sector->connections_count; i++ )
+	return ( MX_TEXTURES_GENERATION_VERSION << 16 ) | generator_version;
+}
+
+static unsigned int TextureJobDataSize( unsigned int job_index )
+{
+	unsigned int array_index, layer;
+	GetTextureJobLayer( job_index, &array_index, &layer );
+	return mxCompressedMipChainSize( g_texture_arrays_size_log2[ array_index ] );
+}
+
+struct TextureJobs
+{
+	// Index of texture for each pool job.
+	unsigned int texture_job_index[ MX_TEXTURE_JOB_COUNT ];
+	// Compressed mip chains.
+	unsigned char* textures_data[ MX_TEXTURE_JOB_COUNT ];
+};
+
+static void GenTextureJob( void* data, unsigned int pool_job_index )
+{
+	TextureJobs* jobs= (TextureJobs*)data;
+	unsigned int job_index= jobs->texture_job_index[ pool_job_index ];
+
+	unsigned int array_index, layer;
+	GetTextureJobLayer( job_index, &array_index, &layer );
+
+	mx_Texture* tex= new mx_Texture( g_texture_arrays_size_log2[ array_index ], g_texture_arrays_size_log2[ array_index ] );
+	tex->SetDeferred( true );
+	if( array_index == 0 )
+		gen_level_textures_func_table[ layer ]( tex );
+	else if( array_index == 1 )
+	{
+		gen_level_textures_height_map_func_table[ layer ]( tex );
+		tex->GenNormalMap();
+
+		// map from range [-1; 1] to range [0; 1]
+		static const float k[4]= { 0.5f, 0.5f, 0.5f, 0.5f };
+		tex->Mul(k);
+		tex->Add(k);
+	}
+	else
+		gen_models_textures_func_table[ layer ]( tex );
+
+	tex->LinearNormalization( 1.0f );
+
+	unsigned char* data= new unsigned char[ TextureJobDataSize( job_index ) ];
+	mxCompressMipChain( tex->GetNormalizedData(), data, tex->SizeXLog2(), g_texture_arrays_compression[ array_index ] );
+	delete tex;
+
+	jobs->textures_data[ pool_job_index ]= data;
+}
+
+static void UploadTextureLayer( GLuint texture_array, unsigned int job_index, const unsigned char* data )
+{
+	unsigned int array_index, layer;
+	GetTextureJobLayer( job_index, &array_index, &layer );
+	unsigned int size_log2= g_texture_arrays_size_log2[ array_index ];
+
+	glBindTexture( GL_TEXTURE_2D_ARRAY, texture_array );
+	for( unsigned int level= 0; level <= size_log2; level++ )
 	{
-		if( sector->connections[i]->traverse_id != tag )
-			MarkSectors_r( sector->connections[i], tag, depth - 1 );
+		unsigned int size= 1 << ( size_log2 - level );
+		unsigned int data_size= mxCompressedMipSize( size_log2, level );
+		glCompressedTexSubImage3D(
+			GL_TEXTURE_2D_ARRAY, level,
+			0, 0, layer,
+			size, size, 1,
+			g_texture_arrays_internal_format[ array_index ], data_size, data );
+		data+= data_size;
 	}
 }
 
+// Cache file is placed next to executable, not in working directory.
+// If executable path is too long, working directory is used.
+static void GetTextureCacheFileName( char* out_file_name, unsigned int buffer_size )
+{
+	unsigned int length= GetModuleFileName( NULL, out_file_name, buffer_size );
+	if( length == 0 || length >= buffer_size )
+		length= 0;
+
+	// Remove executable name.
+	while( length > 0 && out_file_name[ length - 1 ] != '\\' && out_file_name[ length - 1 ] != '/' )
+		length--;
+
+	if( length + sizeof(g_texture_cache_file_name) > buffer_size )
+		length= 0;
+	std::memcpy( out_file_name + length, g_texture_cache_file_name, sizeof(g_texture_cache_file_name) );
+}
+
+static void CreateBasisChangeMatrix( float* mat )
+{
+	mxMat4RotateX( mat, -MX_PI2 );
+	float tmp_mat[16];
+	mxMat4Identity( tmp_mat );
+	tmp_mat[10]= -1.0f;
+	mxMat4Mul( mat, tmp_mat );
+}
+
 static GuiVertex* AddGuiQuad( GuiVertex* v, int x, int y, int width, int height, const unsigned char* color )
 {
 	v[0].pos[0]= short(x);
@@ -174,21 +309,30 @@ static void GenFullscreenQuad( mx_DrawingModel* model )
 	model->SetIndexData( indeces, 6 );
 }
 
-mx_Renderer::mx_Renderer( const mx_Level& level, const mx_Player& player )
+mx_Renderer::mx_Renderer( const mx_Level& level )
 	: main_loop_(*mx_MainLoop::Instance())
 	, level_(level)
-	, player_(player)
+	, snapshot_(NULL)
 	, screen_buffers_initialized_(false)
 {
 	{ // World geometry
-		world_vertex_buffer_.VertexData(
-			level_.GetVertices(),
-			sizeof(mx_LevelVertex) * level_.GetVertexCount(),
-			sizeof(mx_LevelVertex) );
-		world_vertex_buffer_.IndexData(
-			level_.GetTriangles(),
-			level_.GetTriangleCount() * sizeof(unsigned int) * 3 );
-
+		unsigned int sector_count= level_.GetLevelData().sector_count;
+		world_sectors_index_count_= new GLsizei[ sector_count ];
+		world_sectors_index_offset_= new const GLvoid*[ sector_count ];
+		world_sectors_base_vertex_= new GLint[ sector_count ];
+		world_visible_sectors_index_count_= new GLsizei[ sector_count ];
+		world_visible_sectors_index_offset_= new const GLvoid*[ sector_count ];
+		world_visible_sectors_base_vertex_= new GLint[ sector_count ];
+		UpdateWorldGeometry();
+
+#ifdef MX_COMPACT_WORLD_VERTICES
+		WorldVertex v;
+		world_vertex_buffer_.VertexAttrib( 0, 3, GL_UNSIGNED_SHORT, false, ((char*)v.xyz) - ((char*)&v) );
+		world_vertex_buffer_.VertexAttrib( 1, 4, GL_BYTE, true, ((char*)v.normal_binormal) - ((char*)&v) );
+		world_vertex_buffer_.VertexAttrib( 2, 1, GL_BYTE, true, ((char*)&v.tangent_sign) - ((char*)&v) );
+		world_vertex_buffer_.VertexAttrib( 4, 2, GL_HALF_FLOAT, false, ((char*)v.tex_coord) - ((char*)&v) );
+		world_vertex_buffer_.VertexAttrib( 5, 1, GL_UNSIGNED_BYTE, false, ((char*)&v.tex_id) - ((char*)&v) );
+#else
 		mx_LevelVertex v;
 		world_vertex_buffer_.VertexAttrib( 0, 3, GL_FLOAT, false, ((char*)v.xyz) - ((char*)&v) );
 		world_vertex_buffer_.VertexAttrib( 1, 3, GL_BYTE, true, ((char*)v.binormal) - ((char*)&v) );
@@ -196,12 +340,18 @@ mx_Renderer::mx_Renderer( const mx_Level& level, const mx_Player& player )
 		world_vertex_buffer_.VertexAttrib( 3, 3, GL_BYTE, true, ((char*)v.normal) - ((char*)&v) );
 		world_vertex_buffer_.VertexAttrib( 4, 2, GL_FLOAT, false, ((char*)v.tex_coord) - ((char*)&v) );
 		world_vertex_buffer_.VertexAttrib( 5, 1, GL_UNSIGNED_BYTE, false, ((char*)&v.tex_id) - ((char*)&v) );
+#endif
 	}
 	{ // World shader
 		world_shader_.SetAttribLocation( "p", 0 );
+#ifdef MX_COMPACT_WORLD_VERTICES
+		world_shader_.SetAttribLocation( "nb", 1 );
+		world_shader_.SetAttribLocation( "ts", 2 );
+#else
 		world_shader_.SetAttribLocation( "b", 1 );
 		world_shader_.SetAttribLocation( "t", 2 );
 		world_shader_.SetAttribLocation( "n", 3 );
+#endif
 		world_shader_.SetAttribLocation( "tc", 4 );
 		world_shader_.SetAttribLocation( "texn", 5 );
 		world_shader_.SetFragDataLocation( "c_", 0 );
@@ -284,76 +434,68 @@ mx_Renderer::mx_Renderer( const mx_Level& level, const mx_Player& player )
 		static const char* const uniforms[]= { "mat", "nmat", "tex", "texn" };
 		models_shader_.FindUniforms( uniforms, sizeof(uniforms) / sizeof(char*) );
 	}
-	{ // level textures
-		mx_Texture tex( 10, 10 );
-
-		for( unsigned int t= 0; t < 2; t++ )
+	{ // level, monsters and amo boxes textures
+		// Textures generated in thread pool, main thread uploads each texture, when it is ready.
+		GLuint* const arrays[ g_texture_array_count ]=
 		{
-			GLuint& tex_id= t == 0 ? world_texture_array_ : world_normal_maps_array_;
+			&world_texture_array_, &world_normal_maps_array_, &monsters_textures_array_id_
+		};
+		for( unsigned int a= 0; a < g_texture_array_count; a++ )
+		{
+			glGenTextures( 1, arrays[a] );
+			glBindTexture( GL_TEXTURE_2D_ARRAY, *arrays[a] );
+
+			for( unsigned int level= 0; level <= g_texture_arrays_size_log2[a]; level++ )
+				glTexImage3D(
+					GL_TEXTURE_2D_ARRAY, level, g_texture_arrays_internal_format[a],
+					1 << ( g_texture_arrays_size_log2[a] - level ), 1 << ( g_texture_arrays_size_log2[a] - level ), g_texture_arrays_layers[a],
+					0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+		}
 
-			glGenTextures( 1, &tex_id );
-			glBindTexture( GL_TEXTURE_2D_ARRAY, tex_id );
+		// Generate only textures, which are not in cache.
+		char cache_file_name[ MAX_PATH ];
+		GetTextureCacheFileName( cache_file_name, sizeof(cache_file_name) );
+		mx_TextureCache cache( cache_file_name );
+		TextureJobs jobs;
+		unsigned int pool_job_count= 0;
+		for( unsigned int i= 0; i < MX_TEXTURE_JOB_COUNT; i++ )
+			if( cache.Find( TextureJobCacheKey(i), TextureJobCacheVersion(i), TextureJobDataSize(i) ) == NULL )
+				jobs.texture_job_index[ pool_job_count++ ]= i;
 
-			glTexImage3D(
-				GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8,
-				tex.SizeX(), tex.SizeY(), LastLevelTexture,
-				0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+		mx_ThreadPool* pool= mx_ThreadPool::Instance();
+		pool->Start( GenTextureJob, &jobs, pool_job_count );
 
-			for( unsigned int i= 0; i < LastLevelTexture; i++ )
+		for( unsigned int i= 0; i < MX_TEXTURE_JOB_COUNT; i++ )
+		{
+			const unsigned char* data= cache.Find( TextureJobCacheKey(i), TextureJobCacheVersion(i), TextureJobDataSize(i) );
+			if( data != NULL )
 			{
-				if( t == 0 )
-				{
-					gen_level_textures_func_table[i]( &tex );
-					tex.LinearNormalization( 1.0f );
-				}
-				else
-				{
-					gen_level_textures_height_map_func_table[i]( &tex );
-					tex.GenNormalMap();
-
-					// map from range [-1; 1] to range [0; 1]
-					static const float k[4]= { 0.5f, 0.5f, 0.5f, 0.5f };
-					tex.Mul(k);
-					tex.Add(k);
-					tex.LinearNormalization(1.0f);
-				}
-
-				glTexSubImage3D(
-					GL_TEXTURE_2D_ARRAY, 0,
-					0, 0, i,
-					tex.SizeX(), tex.SizeY(), 1,
-					GL_RGBA, GL_UNSIGNED_BYTE, tex.GetNormalizedData() );
+				unsigned int array_index, layer;
+				GetTextureJobLayer( i, &array_index, &layer );
+				UploadTextureLayer( *arrays[ array_index ], i, data );
 			}
-			glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-			glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
-			glGenerateMipmap( GL_TEXTURE_2D_ARRAY );
-		} // for diffuse and normal
-	}
-	{ // monsters and amo boxes textures
-		mx_Texture tex( 9, 9 );
-		glGenTextures( 1, &monsters_textures_array_id_ );
-		glBindTexture( GL_TEXTURE_2D_ARRAY, monsters_textures_array_id_ );
-
-		glTexImage3D(
-			GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8,
-			tex.SizeX(), tex.SizeY(), LastModelTexture,
-			0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+		}
 
-		for( unsigned int i= 0; i < LastModelTexture; i++ )
+		unsigned int pool_job_index;
+		while( pool->WaitJob( &pool_job_index ) )
 		{
-			gen_models_textures_func_table[i]( &tex );
-
-			tex.LinearNormalization( 1.0f );
+			unsigned int job_index= jobs.texture_job_index[ pool_job_index ];
+			unsigned int array_index, layer;
+			GetTextureJobLayer( job_index, &array_index, &layer );
+
+			unsigned char* data= jobs.textures_data[ pool_job_index ];
+			UploadTextureLayer( *arrays[ array_index ], job_index, data );
+			cache.Add( TextureJobCacheKey( job_index ), TextureJobCacheVersion( job_index ), data, TextureJobDataSize( job_index ) );
+			delete[] data;
+		}
+		cache.Save();
 
-			glTexSubImage3D(
-				GL_TEXTURE_2D_ARRAY, 0,
-				0, 0, i,
-				tex.SizeX(), tex.SizeY(), 1,
-				GL_RGBA, GL_UNSIGNED_BYTE, tex.GetNormalizedData() );
+		for( unsigned int a= 0; a < g_texture_array_count; a++ )
+		{
+			glBindTexture( GL_TEXTURE_2D_ARRAY, *arrays[a] );
+			glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+			glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
 		}
-		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
-		glGenerateMipmap( GL_TEXTURE_2D_ARRAY );
 	}
 	{ // fullscreen postprocessing shader
 		fullscreen_postprocessing_shader_.Create(
@@ -408,6 +550,12 @@ mx_Renderer::mx_Renderer( const mx_Level& level, const mx_Player& player )
 
 mx_Renderer::~mx_Renderer()
 {
+	delete[] world_sectors_index_count_;
+	delete[] world_sectors_index_offset_;
+	delete[] world_sectors_base_vertex_;
+	delete[] world_visible_sectors_index_count_;
+	delete[] world_visible_sectors_index_offset_;
+	delete[] world_visible_sectors_base_vertex_;
 }
 
 void mx_Renderer::OnFramebufferResize()
@@ -415,17 +563,117 @@ void mx_Renderer::OnFramebufferResize()
 	CreateScreenBuffers();
 }
 
-void mx_Renderer::Draw()
+void mx_Renderer::UpdateWorldGeometry()
+{
+	const mx_LevelData& level_data= level_.GetLevelData();
+
+	unsigned short* indices= new unsigned short[ level_data.triangle_count * 3 ];
+	world_sectors_draw_count_= 0;
+	for( unsigned int s= 0; s < level_data.sector_count; s++ )
+	{
+		const mx_LevelSector& sector= level_data.sectors[s];
+		if( sector.triangles_count == 0 )
+			continue;
+
+		MX_ASSERT( sector.vertex_count <= 65536 );
+		for( unsigned int t= sector.first_triangle; t < sector.first_triangle + sector.triangles_count; t++ )
+			for( unsigned int j= 0; j < 3; j++ )
+				indices[ t * 3 + j ]= (unsigned short)( level_data.triangles[t].vertex_index[j] - sector.first_vertex );
+
+		world_sectors_index_count_[ world_sectors_draw_count_ ]= sector.triangles_count * 3;
+		world_sectors_index_offset_[ world_sectors_draw_count_ ]= (const GLvoid*)( sector.first_triangle * 3 * sizeof(unsigned short) );
+		world_sectors_base_vertex_[ world_sectors_draw_count_ ]= sector.first_vertex;
+		world_sectors_draw_count_++;
+	}
+
+	// Buffer objects stay same, so vertex attributes setup is still valid.
+#ifdef MX_COMPACT_WORLD_VERTICES
+	WorldVertex* vertices= new WorldVertex[ level_data.vertex_count ];
+	for( unsigned int i= 0; i < level_data.vertex_count; i++ )
+		PackWorldVertex( level_data.vertices[i], vertices[i] );
+
+	world_vertex_buffer_.VertexData(
+		vertices,
+		sizeof(WorldVertex) * level_data.vertex_count,
+		sizeof(WorldVertex) );
+
+	delete[] vertices;
+#else
+	world_vertex_buffer_.VertexData(
+		level_.GetVertices(),
+		sizeof(mx_LevelVertex) * level_.GetVertexCount(),
+		sizeof(mx_LevelVertex) );
+#endif
+	world_vertex_buffer_.IndexData(
+		indices,
+		level_data.triangle_count * 3 * sizeof(unsigned short) );
+
+	delete[] indices;
+}
+
+#ifdef MX_COMPACT_WORLD_VERTICES
+
+static void OctahedralEncode( const char* v, char* out_v )
+{
+	float f[3];
+	for( unsigned int i= 0; i < 3; i++ ) f[i]= float(v[i]);
+	float l1_norm= std::fabsf(f[0]) + std::fabsf(f[1]) + std::fabsf(f[2]);
+
+	float x= f[0] / l1_norm, y= f[1] / l1_norm;
+	if( f[2] < 0.0f )
+	{
+		float new_x= ( 1.0f - std::fabsf(y) ) * ( x >= 0.0f ? 1.0f : -1.0f );
+		float new_y= ( 1.0f - std::fabsf(x) ) * ( y >= 0.0f ? 1.0f : -1.0f );
+		x= new_x;
+		y= new_y;
+	}
+	out_v[0]= char( mxRound( x * 127.0f ) );
+	out_v[1]= char( mxRound( y * 127.0f ) );
+}
+
+void mx_Renderer::PackWorldVertex( const mx_LevelVertex& in_vertex, WorldVertex& out_vertex )
 {
-	if( player_.IsInMapMode() )
+	for( unsigned int i= 0; i < 3; i++ )
+	{
+		float pos= mxRound( in_vertex.xyz[i] * MX_WORLD_VERTEX_POS_SCALE );
+		MX_ASSERT( pos >= 0.0f && pos <= 65535.0f );
+		out_vertex.xyz[i]= (unsigned short) pos;
+	}
+	for( unsigned int i= 0; i < 2; i++ )
+		out_vertex.tex_coord[i]= mxFloatToHalf( in_vertex.tex_coord[i] );
+
+	OctahedralEncode( in_vertex.normal, out_vertex.normal_binormal );
+	OctahedralEncode( in_vertex.binormal, out_vertex.normal_binormal + 2 );
+
+	float normal_binormal_cross[3];
+	float normal[3], binormal[3], tangent[3];
+	for( unsigned int i= 0; i < 3; i++ )
+	{
+		normal[i]= float( in_vertex.normal[i] );
+		binormal[i]= float( in_vertex.binormal[i] );
+		tangent[i]= float( in_vertex.tangent[i] );
+	}
+	mxVec3Cross( normal, binormal, normal_binormal_cross );
+	out_vertex.tangent_sign= mxVec3Dot( normal_binormal_cross, tangent ) >= 0.0f ? 127 : -127;
+
+	out_vertex.tex_id= in_vertex.tex_id;
+}
+
+#endif
+
+void mx_Renderer::Draw( const mx_DrawingSnapshot& snapshot )
+{
+	snapshot_= &snapshot;
+
+	if( snapshot_->GetCamera().map_mode )
 	{
 		DrawMap();
 		DrawModels();
 	}
 	else
 	{
-		MarkPotentialyVisibleSectors();
 		CalculateMatrices();
+		MarkVisibleSectors();
 
 		// Bind GBuffer. We do not need clear color
 		glBindFramebuffer( GL_FRAMEBUFFER, g_buffer_.fbo_id );
@@ -449,6 +697,8 @@ void mx_Renderer::Draw()
 	}
 
 	DrawGui();
+
+	snapshot_= NULL;
 }
 
 void mx_Renderer::CreateScreenBuffers()
@@ -517,17 +767,106 @@ void mx_Renderer::CreateScreenBuffers()
 	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
 }
 
-void mx_Renderer::MarkPotentialyVisibleSectors()
+void mx_Renderer::MarkVisibleSectors()
 {
 	visible_sectors_tag_= mxGenSectorGraphTraverseId();
 
-	mx_LevelSector* player_sector= const_cast<mx_LevelSector*>(player_.GetSector());
-	if( player_sector )
+	const mx_LevelSector* player_sector= snapshot_->GetCamera().sector;
+	if( player_sector == NULL )
+		return;
+
+	// Sectors of PVS get own tag. Visible sectors are subset of PVS, so sector is in PVS, if it has any of two tags.
+	pvs_sectors_tag_= mxGenSectorGraphTraverseId();
+	level_.GetPVS().MarkVisibleSectors( player_sector, pvs_sectors_tag_ );
+
+	static const float c_screen_rect[4]= { -1.0f, -1.0f, 1.0f, 1.0f };
+	const mx_LevelSector* path[ MX_PVS_MAX_HOPS ];
+	MarkVisibleSectors_r( player_sector, c_screen_rect, path, 0 );
+}
+
+void mx_Renderer::MarkVisibleSectors_r( const mx_LevelSector* sector, const float* view_rect, const mx_LevelSector** path, unsigned int depth )
+{
+	const_cast<mx_LevelSector*>(sector)->traverse_id= visible_sectors_tag_;
+	if( depth == MX_PVS_MAX_HOPS )
+		return;
+
+	path[ depth ]= sector;
+
+	for( unsigned int i= 0; i < sector->connections_count; i++ )
 	{
-		// We assume, that player can not see through mor tnan "depth" sectors
-		const unsigned int depth= 4;
-		MarkSectors_r( player_sector, visible_sectors_tag_, depth );
+		const mx_LevelSector* next_sector= sector->connections[i];
+		if( next_sector->traverse_id != pvs_sectors_tag_ && next_sector->traverse_id != visible_sectors_tag_ )
+			continue;
+
+		bool in_path= false;
+		for( unsigned int j= 0; j <= depth; j++ )
+			if( path[j] == next_sector ) in_path= true;
+		if( in_path )
+			continue;
+
+		float portal_bb_min[3], portal_bb_max[3];
+		mxGetSectorsPortal( *sector, *next_sector, portal_bb_min, portal_bb_max );
+
+		float portal_rect[4];
+		if( ClipPortalRect( portal_bb_min, portal_bb_max, view_rect, portal_rect ) )
+			MarkVisibleSectors_r( next_sector, portal_rect, path, depth + 1 );
+	}
+}
+
+bool mx_Renderer::ClipPortalRect( const float* portal_bb_min, const float* portal_bb_max, const float* view_rect, float* out_rect ) const
+{
+	const float* m= view_matrix_;
+
+	float rect[4]= { mxInf(), mxInf(), -mxInf(), -mxInf() };
+	unsigned int vertices_behind_near_plane= 0;
+	for( unsigned int v= 0; v < 8; v++ )
+	{
+		float pos[3];
+		pos[0]= ( v & 1 ) ? portal_bb_max[0] : portal_bb_min[0];
+		pos[1]= ( v & 2 ) ? portal_bb_max[1] : portal_bb_min[1];
+		pos[2]= ( v & 4 ) ? portal_bb_max[2] : portal_bb_min[2];
+
+		float w= pos[0] * m[3] + pos[1] * m[7] + pos[2] * m[11] + m[15];
+		if( w < z_near_ )
+		{
+			vertices_behind_near_plane++;
+			continue;
+		}
+
+		float x= ( pos[0] * m[0] + pos[1] * m[4] + pos[2] * m[ 8] + m[12] ) / w;
+		float y= ( pos[0] * m[1] + pos[1] * m[5] + pos[2] * m[ 9] + m[13] ) / w;
+		if( x < rect[0] ) rect[0]= x;
+		if( y < rect[1] ) rect[1]= y;
+		if( x > rect[2] ) rect[2]= x;
+		if( y > rect[3] ) rect[3]= y;
+	}
+
+	if( vertices_behind_near_plane == 8 )
+		return false;
+	if( vertices_behind_near_plane > 0 )
+	{
+		// Portal crosses near plane - it can cover any part of screen.
+		for( unsigned int j= 0; j < 4; j++ )
+			out_rect[j]= view_rect[j];
+		return true;
 	}
+
+	out_rect[0]= rect[0] > view_rect[0] ? rect[0] : view_rect[0];
+	out_rect[1]= rect[1] > view_rect[1] ? rect[1] : view_rect[1];
+	out_rect[2]= rect[2] < view_rect[2] ? rect[2] : view_rect[2];
+	out_rect[3]= rect[3] < view_rect[3] ? rect[3] : view_rect[3];
+	return out_rect[0] < out_rect[2] && out_rect[1] < out_rect[3];
+}
+
+bool mx_Renderer::IsSectorLightVisible( const mx_LevelSector& sector ) const
+{
+	if( sector.traverse_id == visible_sectors_tag_ )
+		return true;
+
+	for( unsigned int i= 0; i < sector.connections_count; i++ )
+		if( sector.connections[i]->traverse_id == visible_sectors_tag_ )
+			return true;
+	return false;
 }
 
 void mx_Renderer::DrawMap()
@@ -537,11 +876,14 @@ void mx_Renderer::DrawMap()
 	float cam_translate_mat[16];
 	float basis_change_mat[16];
 
+	const mx_DrawingSnapshot::Camera& camera= snapshot_->GetCamera();
+
 	float translate_vec[3];
-	mxVec3Mul( player_.Pos(), -1.0f, translate_vec );
+	VEC3_CPY( translate_vec, camera.pos );
+	mxVec3Mul( translate_vec, -1.0f );
 	mxMat4Translate( player_translate_mat, translate_vec );
 
-	player_.CreateRotationMatrix4( rotation_mat, false );
+	std::memcpy( rotation_mat, camera.rotation_mat, sizeof(rotation_mat) );
 
 	static const float cam_translate_vec[3]= { 0.0f, 0.0f, 4.0f };
 	mxMat4Translate( cam_translate_mat, cam_translate_vec );
@@ -552,7 +894,7 @@ void mx_Renderer::DrawMap()
 	z_far_= 24.0f;
 	mxMat4Perspective( perspective_matrix_,
 		float(main_loop_.ViewportWidth())/ float(main_loop_.ViewportHeight()),
-		player_.Fov(),
+		camera.fov,
 		z_near_, z_far_ );
 
 	mxMat4Mul( player_translate_mat, rotation_mat, view_matrix_ );
@@ -567,7 +909,7 @@ void mx_Renderer::DrawMap()
 	world_vertex_buffer_.Bind();
 
 	glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
-	glDrawElements( GL_TRIANGLES, world_vertex_buffer_.IndexDataSize() / sizeof(unsigned int), GL_UNSIGNED_INT, NULL );
+	DrawWorldGeometry( false );
 	glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
 
 	DrawModels();
@@ -579,11 +921,14 @@ void mx_Renderer::CalculateMatrices()
 	float rotation_mat[16];
 	float basis_change_mat[16];
 
+	const mx_DrawingSnapshot::Camera& camera= snapshot_->GetCamera();
+
 	float translate_vec[3];
-	mxVec3Mul( player_.Pos(), -1.0f, translate_vec );
+	VEC3_CPY( translate_vec, camera.pos );
+	mxVec3Mul( translate_vec, -1.0f );
 	mxMat4Translate( translate_mat, translate_vec );
 
-	player_.CreateRotationMatrix4( rotation_mat, false );
+	std::memcpy( rotation_mat, camera.rotation_mat, sizeof(rotation_mat) );
 
 	CreateBasisChangeMatrix( basis_change_mat );
 
@@ -591,7 +936,7 @@ void mx_Renderer::CalculateMatrices()
 	z_far_= 128.0f;
 	mxMat4Perspective( perspective_matrix_,
 		float(main_loop_.ViewportWidth())/ float(main_loop_.ViewportHeight()),
-		player_.Fov(),
+		camera.fov,
 		z_near_, z_far_ );
 	
 	mxMat4Mul( translate_mat, rotation_mat, view_matrix_ );
@@ -616,11 +961,50 @@ void mx_Renderer::DrawWorld()
 	glEnable( GL_CULL_FACE );
 	glCullFace( GL_FRONT );
 	//glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
-	glDrawElements( GL_TRIANGLES, world_vertex_buffer_.IndexDataSize() / sizeof(unsigned int), GL_UNSIGNED_INT, NULL );
+	// Without player sector visible sectors are unknown.
+	DrawWorldGeometry( snapshot_->GetCamera().sector != NULL );
 
 	glDisable (GL_CULL_FACE );
 }
 
+void mx_Renderer::DrawWorldGeometry( bool visible_only )
+{
+	if( !visible_only )
+	{
+		glMultiDrawElementsBaseVertex(
+			GL_TRIANGLES,
+			world_sectors_index_count_,
+			GL_UNSIGNED_SHORT,
+			world_sectors_index_offset_,
+			world_sectors_draw_count_,
+			world_sectors_base_vertex_ );
+		return;
+	}
+
+	// Ranges of sectors can not be merged, because each sector has own base vertex.
+	const mx_LevelData& level_data= level_.GetLevelData();
+	unsigned int draw_count= 0;
+	for( unsigned int s= 0; s < level_data.sector_count; s++ )
+	{
+		const mx_LevelSector& sector= level_data.sectors[s];
+		if( sector.traverse_id != visible_sectors_tag_ || sector.triangles_count == 0 )
+			continue;
+
+		world_visible_sectors_index_count_[ draw_count ]= sector.triangles_count * 3;
+		world_visible_sectors_index_offset_[ draw_count ]= (const GLvoid*)( sector.first_triangle * 3 * sizeof(unsigned short) );
+		world_visible_sectors_base_vertex_[ draw_count ]= sector.first_vertex;
+		draw_count++;
+	}
+
+	glMultiDrawElementsBaseVertex(
+		GL_TRIANGLES,
+		world_visible_sectors_index_count_,
+		GL_UNSIGNED_SHORT,
+		world_visible_sectors_index_offset_,
+		draw_count,
+		world_visible_sectors_base_vertex_ );
+}
+
 void mx_Renderer::DrawModels()
 {
 	glActiveTexture( GL_TEXTURE0 );
@@ -634,7 +1018,7 @@ void mx_Renderer::DrawModels()
 
 	models_vertex_buffer_.Bind();
 
-	if( player_.IsInMapMode() )
+	if( snapshot_->GetCamera().map_mode )
 		DrawIcosahedrons();
 	else
 	{
@@ -660,20 +1044,19 @@ void mx_Renderer::DrawModel( mx_Models::Model model_index, ModelTexture texture_
 
 void mx_Renderer::DrawMonsters()
 {
-	const mx_Monster* const* monsters= level_.GetMonsters();
-	for( unsigned int m= 0, m_end= level_.GetMonsterCount(); m < m_end; m++ )
+	const mx_DrawingSnapshot::Monster* monsters= snapshot_->GetMonsters();
+	for( unsigned int m= 0, m_end= snapshot_->GetMonsterCount(); m < m_end; m++ )
 	{
-		float rotate_mat[16];
 		float normals_mat[16];
 		float translate_mat[16];
 		float result_mat[16];
 
-		const mx_Monster* monster= monsters[m];
-		if( monster->GetSector().traverse_id != visible_sectors_tag_ )
+		const mx_DrawingSnapshot::Monster& monster= monsters[m];
+		if( monster.sector->traverse_id != visible_sectors_tag_ )
 			continue;
 
-		mxMat4Translate( translate_mat, monster->Pos() );
-		monster->CreateRotationMatrix4( rotate_mat, true );
+		const float* rotate_mat= monster.rotation_mat;
+		mxMat4Translate( translate_mat, monster.pos );
 		mxMat4Mul( rotate_mat, translate_mat, result_mat );
 		mxMat4Mul( result_mat, view_matrix_ );
 
@@ -683,43 +1066,39 @@ void mx_Renderer::DrawMonsters()
 		models_shader_.UniformMat3( "nmat", normals_mat );
 
 		DrawModel(
-			mx_Models::monster_to_model_table[  monster->GetType() ],
-			g_monster_to_texture_table[ monster->GetType() ] );
+			mx_Models::monster_to_model_table[  monster.type ],
+			g_monster_to_texture_table[ monster.type ] );
 	}
 }
 
 void mx_Renderer::DrawAmmo()
 {
-	const mx_LevelData& level_data= level_.GetLevelData();
-	for( unsigned int s= 0; s < level_data.sector_count; s++ )
+	const mx_DrawingSnapshot::AmmoBox* ammo_boxes= snapshot_->GetAmmoBoxes();
+	for( unsigned int a= 0, a_end= snapshot_->GetAmmoBoxCount(); a < a_end; a++ )
 	{
-		const mx_LevelSector& sector= level_data.sectors[s];
-		if( sector.traverse_id != visible_sectors_tag_ )
+		if( ammo_boxes[a].sector->traverse_id != visible_sectors_tag_ )
 			continue;
 
-		for( unsigned int a= 0; a < sector.ammo_box_count; a++ )
-		{
-			const mx_AmmoBox& box= sector.ammo_boxes[a];
+		const mx_AmmoBox& box= ammo_boxes[a].box;
 
-			float translate_mat[16];
-			float rotate_mat[16];
-			float result_mat[16];
-			float normals_mat[9];
+		float translate_mat[16];
+		float rotate_mat[16];
+		float result_mat[16];
+		float normals_mat[9];
 
-			MakePowerupsRotationMatrix( rotate_mat, box.pos );
+		MakePowerupsRotationMatrix( rotate_mat, box.pos );
 
-			mxMat4Translate( translate_mat, box.pos );
-			mxMat4Mul( rotate_mat, translate_mat, result_mat );
-			mxMat4Mul( result_mat, view_matrix_ );
+		mxMat4Translate( translate_mat, box.pos );
+		mxMat4Mul( rotate_mat, translate_mat, result_mat );
+		mxMat4Mul( result_mat, view_matrix_ );
 
-			models_shader_.UniformMat4( "mat", result_mat );
+		models_shader_.UniformMat4( "mat", result_mat );
 
-			mxMat4ToMat3( rotate_mat, normals_mat );
-			models_shader_.UniformMat3( "nmat", normals_mat );
+		mxMat4ToMat3( rotate_mat, normals_mat );
+		models_shader_.UniformMat3( "nmat", normals_mat );
 
-			DrawModel( mx_Models::ModelCube, g_ammo_to_texture_table[ box.type ] );
-		} // for ammo boxes
-	} // for sectors
+		DrawModel( mx_Models::ModelCube, g_ammo_to_texture_table[ box.type ] );
+	}
 }
 
 void mx_Renderer::DrawIcosahedrons()
@@ -731,7 +1110,7 @@ void mx_Renderer::DrawIcosahedrons()
 		if( sector.traverse_id != visible_sectors_tag_ )
 			continue;
 
-		if( sector.has_icosahedron && !sector.icosahedron_picked )
+		if( sector.has_icosahedron && !snapshot_->IsIcosahedronPicked(s) )
 		{
 			float translate_mat[16];
 			float rotate_mat[16];
@@ -756,8 +1135,8 @@ void mx_Renderer::DrawIcosahedrons()
 
 void mx_Renderer::DrawHealthPacks()
 {
-	const mx_HealthPack* health_packs= level_.GetHealthPacks();
-	unsigned int health_pack_count= level_.GetHealthPackCount();
+	const mx_HealthPack* health_packs= snapshot_->GetHealthPacks();
+	unsigned int health_pack_count= snapshot_->GetHealthPackCount();
 
 	for( unsigned int i= 0; i < health_pack_count; i++ )
 	{
@@ -787,17 +1166,13 @@ void mx_Renderer::DrawHealthPacks()
 
 void mx_Renderer::DrawParticles()
 {
-	const mx_ParticlesManager* particles_manager= level_.GetParticlesManager();
+	unsigned int particle_count= snapshot_->GetParticleCount();
 
-	mx_ParticleVertex vertices[ MX_MAX_PARTICLES ];
-	particles_manager->PrepareParticlesVertices( vertices );
-	unsigned int particle_count= particles_manager->GetParticlesCount();
-
-	particles_vertex_buffer_.VertexSubData( vertices, particle_count * sizeof(mx_ParticleVertex), 0 );
+	particles_vertex_buffer_.VertexSubData( snapshot_->GetParticlesVertices(), particle_count * sizeof(mx_ParticleVertex), 0 );
 
 	particles_shader_.Bind();
 	particles_shader_.UniformMat4( "mat", view_matrix_ );
-	particles_shader_.UniformFloat( "ss",  float(main_loop_.ViewportHeight()) / std::tanf(player_.Fov()*0.5f) );
+	particles_shader_.UniformFloat( "ss",  float(main_loop_.ViewportHeight()) / std::tanf(snapshot_->GetCamera().fov*0.5f) );
 
 	glDepthMask( 0 );
 	glEnable( GL_PROGRAM_POINT_SIZE );
@@ -855,13 +1230,13 @@ void mx_Renderer::MakeLighting()
 	{
 		const mx_LevelSector& sector= level_data.sectors[s];
 
-		if( sector.traverse_id != visible_sectors_tag_ )
+		if( !IsSectorLightVisible( sector ) )
 			continue;
 
 		for( unsigned int l= 0; l < level_data.sectors[s].light_count; l++ )
 			DrawLightSource( sector.lights[l] );
 
-		if( sector.has_icosahedron && !sector.icosahedron_picked )
+		if( sector.has_icosahedron && !snapshot_->IsIcosahedronPicked(s) )
 		{
 			static const float c_light_intensity= 0.5f;
 
@@ -874,9 +1249,8 @@ void mx_Renderer::MakeLighting()
 		}
 	}
 
-	const mx_Bullet* bullets= level_.GetBullets();
-	unsigned int bullet_count= level_.GetBulletCount();
-	for( unsigned int b= 0; b < bullet_count; b++ )
+	const mx_DrawingSnapshot::Bullet* bullets= snapshot_->GetBullets();
+	for( unsigned int b= 0; b < snapshot_->GetBulletCount(); b++ )
 	{
 		mx_Light light_source;
 
@@ -890,9 +1264,8 @@ void mx_Renderer::MakeLighting()
 		DrawLightSource( light_source );
 	}
 
-	mx_Light blasts_lights[ MX_MAX_BLAST_LIGHTS ];
-	level_.PrepareBlastLights( blasts_lights );
-	for( unsigned int i= 0; i < level_.GetBlastLightCount(); i++ )
+	const mx_Light* blasts_lights= snapshot_->GetBlastLights();
+	for( unsigned int i= 0; i < snapshot_->GetBlastLightCount(); i++ )
 		DrawLightSource( blasts_lights[i] );
 
 	glDepthMask( 1 );
@@ -921,7 +1294,7 @@ void mx_Renderer::DrawLightSource( const mx_Light& light_source )
 	static const float c_lsb_vec[4]= { c_min_valuable_light, c_min_valuable_light, c_min_valuable_light, c_min_valuable_light };
 	postprocessing_shader_.UniformVec4( "lsb", c_lsb_vec );
 	
-	if( mxSquareDistance( light_source.pos, player_.Pos() ) >= ( min_light_distance + z_near_ ) * ( min_light_distance + z_near_ ) )
+	if( mxSquareDistance( light_source.pos, snapshot_->GetCamera().pos ) >= ( min_light_distance + z_near_ ) * ( min_light_distance + z_near_ ) )
 	{
 		mxMat4Scale( scale_mat, min_light_distance );
 		mxMat4Translate( translate_mat, light_source.pos );
@@ -973,6 +1346,8 @@ void mx_Renderer::DrawGui()
 	GuiVertex vertices[ MX_MAX_GUI_VERTICES ];
 	GuiVertex* v= vertices;
 
+	const mx_DrawingSnapshot::PlayerStats& player_stats= snapshot_->GetPlayerStats();
+
 	const int c_screen_border_indent= 20;
 
 	static const unsigned char c_gui_main_color[4]= { 255, 255, 255, 64 };
@@ -1001,10 +1376,10 @@ void mx_Renderer::DrawGui()
 			int(main_loop_.ViewportWidth()) - ( c_screen_border_indent + c_health_bar_border_width + c_health_bar_width ),
 			c_screen_border_indent + c_health_bar_border_width,
 			c_health_bar_width,
-			player_.GetHealth() * c_health_bar_height / mx_GameConstants::player_max_health,
+			player_stats.health * c_health_bar_height / mx_GameConstants::player_max_health,
 			c_health_color );
 
-		for( unsigned int l= 0; l < player_.GetLives(); l++ )
+		for( unsigned int l= 0; l < player_stats.lives; l++ )
 		{
 			v= AddGuiQuad(
 				v,
@@ -1022,7 +1397,7 @@ void mx_Renderer::DrawGui()
 		int y= c_screen_border_indent;
 
 		unsigned char current_weapon_color[4];
-		FloatColorToByte( mx_GameConstants::bullets_colors[ player_.GetCurrentWeapon() ], current_weapon_color );
+		FloatColorToByte( mx_GameConstants::bullets_colors[ player_stats.current_weapon ], current_weapon_color );
 		current_weapon_color[3]= 128;
 		v= AddGuiQuad( v, x0, y, c_current_weapon_quad_size, c_current_weapon_quad_size, current_weapon_color );
 
@@ -1034,7 +1409,7 @@ void mx_Renderer::DrawGui()
 			FloatColorToByte( mx_GameConstants::bullets_colors[a], color );
 			color[3]= 128;
 
-			unsigned int ammo= player_.GetAmmo(BulletType(a));
+			unsigned int ammo= player_stats.ammo[a];
 			unsigned int ammo_x64= ammo / 64;
 			unsigned int ammo_x8 = ammo / 8 % 8;
 			unsigned int ammo_x1 = ammo % 8;
@@ -1150,14 +1525,14 @@ void mx_Renderer::DrawGui()
 			int y= y0 - row * (c_radius + c_border_size - 1) * 2;
 
 			v= AddGuiIcosahedronProjection( v, x, y, c_radius + c_border_size, c_gui_main_color );
-			if( sectors[s].icosahedron_picked )
+			if( snapshot_->IsIcosahedronPicked(s) )
 				v= AddGuiIcosahedronProjection( v, x, y, c_radius, icosahedron_color );
 
 			i++;
 		}
 	}
 	// dead sreen
-	if (player_.GetHealth() <= 0 )
+	if (player_stats.health <= 0 )
 	{
 		static const unsigned char c_blut_farbe[4]= { 0xE0, 0x10, 0x10, 0x70 };
 		static const unsigned char c_total_tot_farbe[4]= { 0x00, 0x00, 0x00, 0x50 };
@@ -1166,7 +1541,7 @@ void mx_Renderer::DrawGui()
 			v,
 			0, 0,
 			main_loop_.ViewportWidth(), main_loop_.ViewportHeight(),
-			player_.GetLives() > 0 ? c_blut_farbe : c_total_tot_farbe );
+			player_stats.lives > 0 ? c_blut_farbe : c_total_tot_farbe );
 	}
 	{ // fps
 		const int c_fps_bar_height= c_screen_border_indent;
@@ -1218,7 +1593,7 @@ void mx_Renderer::MakePowerupsRotationMatrix( float* out_mat, const float* pos )
 {
 	float phase= pos[0] + pos[1] + pos[2];
 
-	float rotation_vector_rotation= phase + mx_MainLoop::Instance()->GetTime();
+	float rotation_vector_rotation= phase + snapshot_->GetDrawingTime();
 	float self_rotation= rotation_vector_rotation * ( 9.0f / 16.0f);
 	float rotation_vec[3];
 	rotation_vec[0]= std::cosf(rotation_vector_rotation);
@@ -5,30 +5,62 @@
 #include "glsl_program.h"
 #include "level_generator.h"
 #include "models.h"
+#include "shaders.h"
 #include "textures_generation.h"
 #include "vertex_buffer.h"
 
 class mx_Renderer
 {
 public:
-	mx_Renderer( const mx_Level& level, const mx_Player& player );
+	mx_Renderer( const mx_Level& level );
 	~mx_Renderer();
 
 	void OnFramebufferResize();
 
-	void Draw();
+	// Level geometry and sectors are taken from level, dynamic objects and camera - from snapshot.
+	void Draw( const mx_DrawingSnapshot& snapshot );
+
+	// Uploads world geometry again. Call it after level geometry changed.
+	void UpdateWorldGeometry();
+
+private:
+#ifdef MX_COMPACT_WORLD_VERTICES
+	// 16 bytes. Level geometry is integer-cell aligned, so fixed point positions and half texture coordinates are exact.
+	// Tangent frame - normal and binormal in octahedral encoding, tangent reconstructed from them and sign.
+	struct WorldVertex
+	{
+		unsigned short xyz[3];
+		unsigned short tex_coord[2]; // half float
+		char normal_binormal[4];
+		unsigned char tex_id;
+		char tangent_sign;
+	};
+#endif
 
 private:
 	mx_Renderer(const mx_Renderer&);
 	mx_Renderer& operator=(const mx_Renderer&);
 
 	void CreateScreenBuffers();
-
-	void MarkPotentialyVisibleSectors();
+#ifdef MX_COMPACT_WORLD_VERTICES
+	static void PackWorldVertex( const mx_LevelVertex& in_vertex, WorldVertex& out_vertex );
+#endif
+
+	// Marks sectors, visible through portals. Uses view matrix, so call it after CalculateMatrices.
+	void MarkVisibleSectors();
+	// view_rect - min x, min y, max x, max y of visible part of screen in normalized device coordinates.
+	// path - sectors of current portals path. Only sectors of PVS of player sector are traversed.
+	void MarkVisibleSectors_r( const mx_LevelSector* sector, const float* view_rect, const mx_LevelSector** path, unsigned int depth );
+	// Returns false, if portal is not visible inside view_rect. Else returns screen rect of portal, clipped by view_rect.
+	bool ClipPortalRect( const float* portal_bb_min, const float* portal_bb_max, const float* view_rect, float* out_rect ) const;
+	// Lights of sectors, touching visible sectors, may light them too.
+	bool IsSectorLightVisible( const mx_LevelSector& sector ) const;
 
 	void DrawMap();
 	void CalculateMatrices();
 	void DrawWorld();
+	// Draws triangles of world with bound shader. If visible_only is true, only ranges of visible sectors are submitted.
+	void DrawWorldGeometry( bool visible_only );
 
 	void DrawModels();
 	void DrawModel( mx_Models::Model model_index, ModelTexture texture_index );
@@ -49,11 +81,21 @@ private:
 private:
 	const mx_MainLoop& main_loop_;
 	const mx_Level& level_;
-	const mx_Player& player_;
+	// Snapshot of current Draw call.
+	const mx_DrawingSnapshot* snapshot_;
 
 	mx_GLSLProgram world_shader_;
 	mx_GLSLProgram world_map_shader_;
 	mx_VertexBuffer world_vertex_buffer_;
+	// 16 bit indices, local for each sector. Sectors drawn with base vertex.
+	GLsizei* world_sectors_index_count_;
+	const GLvoid** world_sectors_index_offset_;
+	GLint* world_sectors_base_vertex_;
+	unsigned int world_sectors_draw_count_;
+	// Draw ranges of visible sectors, filled each frame.
+	GLsizei* world_visible_sectors_index_count_;
+	const GLvoid** world_visible_sectors_index_offset_;
+	GLint* world_visible_sectors_base_vertex_;
 
 	mx_GLSLProgram models_shader_;
 
@@ -104,4 +146,5 @@ private:
 	mx_VertexBuffer light_source_vertex_buffer_;
 
 	unsigned int visible_sectors_tag_;
+	unsigned int pvs_sectors_tag_;
 };
\ No newline at end of file
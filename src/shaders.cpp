@@ -84,6 +84,36 @@ VERSION_HEADER
 ;
 
 // world shader
+#ifdef MX_COMPACT_WORLD_VERTICES
+
+const char world_shader_v[]=
+VERSION_HEADER
+"in vec3 p;" // position, fixed point
+"in vec4 nb;" // normal and binormal, octahedral encoding
+"in float ts;" // tangent sign, tangent= cross(normal,binormal)*sign
+"in float texn;" // texture number
+"in vec2 tc;"
+"uniform mat4 mat;"
+"out mat3 fbtn;"
+"out vec3 ftc;"
+"vec3 od(vec2 e)" // octahedral decode
+"{"
+	"vec3 v=vec3(e,1.0-abs(e.x)-abs(e.y));"
+	"if(v.z<0.0)v.xy=(1.0-abs(v.yx))*vec2(v.x>=0.0?1.0:-1.0,v.y>=0.0?1.0:-1.0);"
+	"return normalize(v);"
+"}"
+"void main()"
+"{"
+	"vec3 n=od(nb.xy);"
+	"vec3 b=od(nb.zw);"
+	"fbtn=mat3(b,cross(n,b)*ts,n);"
+	"ftc=vec3(tc,texn+0.1);"
+	"gl_Position=mat*vec4(p*0.015625,1.0);" // 1 / MX_WORLD_VERTEX_POS_SCALE
+"}"
+;
+
+#else
+
 const char world_shader_v[]=
 VERSION_HEADER
 "in vec3 p;" // position
@@ -103,6 +133,8 @@ VERSION_HEADER
 "}"
 ;
 
+#endif
+
 const char world_shader_f[]=
 VERSION_HEADER
 "uniform sampler2DArray tex;"
@@ -114,7 +146,8 @@ VERSION_HEADER
 "void main()"
 "{"
 	"c_=texture(tex,ftc);"
-	"vec3 n=texture(nmap, ftc).xyz*2.0-vec3(1.0,1.0,1.0);"
+	"vec2 nxy=texture(nmap, ftc).xy*2.0-vec2(1.0,1.0);" // normal map has only x and y
+	"vec3 n=vec3(nxy,sqrt(max(1.0-dot(nxy,nxy),0.0)));"
 	"n_=vec4(normalize(fbtn*n)*0.5+vec3(0.5,0.5,0.5),0.0);"
 "}"
 ;
@@ -125,7 +158,11 @@ VERSION_HEADER
 "uniform mat4 mat;"
 "void main()"
 "{"
+#ifdef MX_COMPACT_WORLD_VERTICES
+	"gl_Position=mat*vec4(p*0.015625,1.0);" // 1 / MX_WORLD_VERTEX_POS_SCALE
+#else
 	"gl_Position=mat*vec4(p,1.0);"
+#endif
 "}"
 ;
 
@@ -1,5 +1,10 @@
 #pragma once
 
+// Compact world vertices - 16 bytes instead of 32. See mx_Renderer::WorldVertex.
+#define MX_COMPACT_WORLD_VERTICES
+// Positions of compact world vertices are fixed point, in 1/64 of cell.
+#define MX_WORLD_VERTEX_POS_SCALE 64.0f
+
 namespace mx_Shaders
 {
 
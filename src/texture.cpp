@@ -3,10 +3,39 @@
 
 #include "mx_assert.h"
 #include "mx_math.h"
+#include "thread_pool.h"
 //#include "text.h"
 
 #include "texture.h"
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define MX_TEXTURE_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static bool mxCpuHasSSE2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid( info, 1 );
+	return ( info[3] & (1<<26) ) != 0;
+#else
+	return __builtin_cpu_supports( "sse2" ) != 0;
+#endif
+}
+
+// Point-wise operations use SSE path, if cpu supports it. Each pixel is one 4float vector.
+// Results of SSE path are same, as results of scalar path.
+static const bool g_use_sse2= mxCpuHasSSE2();
+#endif
+
+#define MX_NOISE_ROWS_PER_JOB 32
+#define MX_DEFERRED_TILE_PIXELS 1024
+#define MX_BLUR_ROWS_PER_JOB 16
+#define MX_BLUR_COLUMNS_PER_JOB 64
+
 void mxMonochromeImageTo8Bit( const unsigned char* in_data, unsigned char* out_data, unsigned int out_data_size )
 {
 	for( unsigned int i= 0; i< out_data_size / 8; i++ )
@@ -26,6 +55,9 @@ void mx8BitImageToWhiteWithAlpha( const unsigned char* in_data, unsigned char* o
 mx_Texture::mx_Texture( unsigned int size_x_log2, unsigned int size_y_log2 )
 	: data_( new float[ 1<<(size_x_log2 + size_y_log2 + 2) ] )
 	, normalized_data_( NULL )
+	, deferred_op_count_(0)
+	, deferred_(false)
+	, deferred_user_(NULL)
 {
 	size_log2_[0]= size_x_log2;
 	size_log2_[1]= size_y_log2;
@@ -35,6 +67,10 @@ mx_Texture::mx_Texture( unsigned int size_x_log2, unsigned int size_y_log2 )
 
 mx_Texture::~mx_Texture()
 {
+	if( deferred_user_ != NULL )
+		deferred_user_->Flush();
+	ReleaseDeferredOps();
+
 	delete[] data_;
 	if( normalized_data_ != NULL )
 		delete[] normalized_data_;
@@ -42,19 +78,20 @@ mx_Texture::~mx_Texture()
 
 void mx_Texture::Noise( unsigned int seed, unsigned int octave_count )
 {
-	static const float c_mul= 1.0f / 65535.0f;
+	PrepareWrite( true );
 
-	float* d= data_;
-	for( unsigned int y= 0; y< size_[1]; y++ )
-		for( unsigned int x= 0; x< size_[0]; x++, d+= 4 )
-		{
-			d[0]= d[1]= d[2]= d[3]=
-				float( FinalNoise( x, y, seed, octave_count ) ) * c_mul;
-		}
+	NoiseJobData job_data;
+	job_data.texture= this;
+	job_data.seed= seed;
+	job_data.octave_count= octave_count;
+
+	mxParallelFor( NoiseRowsJob, &job_data, ( size_[1] + MX_NOISE_ROWS_PER_JOB - 1 ) / MX_NOISE_ROWS_PER_JOB );
 }
 
 void mx_Texture::PoissonDiskPoints( unsigned int min_distanse_div_sqrt2, unsigned int rand_seed  )
 {
+	PrepareWrite( true );
+
 	mx_Rand randomizer(rand_seed);
 
 	const int neighbor_k= 20;
@@ -64,14 +101,15 @@ void mx_Texture::PoissonDiskPoints( unsigned int min_distanse_div_sqrt2, unsigne
 	int size_minus_1[2];
 	size_minus_1[0]= size_[0] - 1;
 	size_minus_1[1]= size_[1] - 1;
+	int size_half[2];
+	size_half[0]= size_[0] >> 1;
+	size_half[1]= size_[1] >> 1;
 
 	int grid_size[2];
-	int grid_cell_size_to_tex_size_k[2];
 	for( unsigned int i= 0; i< 2; i++ )
 	{
 		grid_size[i]= size_[i] / min_distanse_div_sqrt2;
 		if( grid_size[i] * min_distanse_div_sqrt2 < size_[i] ) grid_size[i]++;
-		grid_cell_size_to_tex_size_k[i]= grid_size[i] * min_distanse_div_sqrt2 - size_[i];
 	}
 
 	// coord int grid - in pixels
@@ -114,29 +152,28 @@ void mx_Texture::PoissonDiskPoints( unsigned int min_distanse_div_sqrt2, unsigne
 			grid_pos[0]= pos[0] / min_distanse_div_sqrt2;
 			grid_pos[1]= pos[1] / min_distanse_div_sqrt2;
 
+			// Neighborhood may be wider, than grid, so wrap with true modulo.
 			for( int y= grid_pos[1] - 4; y<= grid_pos[1] + 3; y++ )
+			{
+				int wrap_xy[2];
+				wrap_xy[1]= ( y % grid_size[1] + grid_size[1] ) % grid_size[1];
 				for( int x= grid_pos[0] - 4; x<= grid_pos[0] + 3; x++ )
 				{
-					int wrap_xy[2];
-					wrap_xy[0]= (x + grid_size[0] ) % grid_size[0];
-					wrap_xy[1]= (y + grid_size[1] ) % grid_size[1];
+					wrap_xy[0]= ( x % grid_size[0] + grid_size[0] ) % grid_size[0];
 
 					int* cell= &grid[ (wrap_xy[0] + wrap_xy[1] * grid_size[0]) * 2 ];
 					if( cell[0] != -1 )
 					{
+						// Distance to nearest image of point on tiled texture.
 						int d_dst[2];
-						d_dst[0]= pos[0] - cell[0] + ( wrap_xy[0] - x ) * min_distanse_div_sqrt2;
-						d_dst[1]= pos[1] - cell[1] + ( wrap_xy[1] - y ) * min_distanse_div_sqrt2;
-
-						if( wrap_xy[0] < x ) d_dst[0]+= grid_cell_size_to_tex_size_k[0];
-						else if( wrap_xy[0] > x ) d_dst[0]-= grid_cell_size_to_tex_size_k[0];
-						if( wrap_xy[1] < y ) d_dst[1]+= grid_cell_size_to_tex_size_k[1];
-						else if( wrap_xy[1] > y ) d_dst[1]-= grid_cell_size_to_tex_size_k[1];
+						d_dst[0]= ( ( pos[0] - cell[0] + size_half[0] ) & size_minus_1[0] ) - size_half[0];
+						d_dst[1]= ( ( pos[1] - cell[1] + size_half[1] ) & size_minus_1[1] ) - size_half[1];
 
 						if( float( d_dst[0] * d_dst[0] + d_dst[1] * d_dst[1] ) < min_dst2 )
 							goto xy_loop_break;
 					}
 				}
+			}
 			
 			int* cell= &grid[ (grid_pos[0] + grid_pos[1] * grid_size[0]) * 2 ];
 			MX_ASSERT( cell[0] == -1 );
@@ -149,66 +186,101 @@ void mx_Texture::PoissonDiskPoints( unsigned int min_distanse_div_sqrt2, unsigne
 		} // try place points near
 	} // while 1
 
-	float intencity_multipler= 1.0f / float(min_distanse_div_sqrt2 * 3);
+	PoissonJobData job_data;
+	job_data.texture= this;
+	job_data.grid= grid;
+	job_data.cell_size= min_distanse_div_sqrt2;
+	job_data.intencity_multipler= 1.0f / float(min_distanse_div_sqrt2 * 3);
+	for( unsigned int i= 0; i< 2; i++ )
+		job_data.grid_size[i]= grid_size[i];
+	mxParallelFor( PoissonDistancesJob, &job_data, grid_size[1] );
 
-	float* d= data_;
-	for( int y= 0; y< int(size_[1]); y++ )
+	delete[] processing_stack;
+	delete[] grid;
+}
+
+void mx_Texture::PoissonDistancesJob( void* data, unsigned int job_index )
+{
+	const PoissonJobData& job= *(const PoissonJobData*)data;
+	mx_Texture* tex= job.texture;
+	const int* grid= job.grid;
+	const int* grid_size= job.grid_size;
+	int cell_size= job.cell_size;
+
+	int grid_y= int(job_index);
+	int y_end= ( grid_y + 1 ) * cell_size;
+	if( y_end > int(tex->size_[1]) ) y_end= int(tex->size_[1]);
+
+	for( int grid_x= 0; grid_x < grid_size[0]; grid_x++ )
 	{
-		int grid_pos[2];
-		grid_pos[1]= y / min_distanse_div_sqrt2;
-		for( int x= 0; x< int(size_[0]); x++, d+= 4 )
+		// Points of 7x7 neighbor cells, coordinates unwrapped relative to this cell.
+		int points[ 7 * 7 ][2];
+		int point_number[ 7 * 7 ];
+		unsigned int point_count= 0;
+
+		for( int v= grid_y - 3; v<= grid_y + 3; v++ )
 		{
-			grid_pos[0]= x / min_distanse_div_sqrt2;
+			int grid_uv[2];
+			grid_uv[1]= ( v % grid_size[1] + grid_size[1] ) % grid_size[1];
+			for( int u= grid_x - 3; u <= grid_x + 3; u++ )
+			{
+				grid_uv[0]= ( u % grid_size[0] + grid_size[0] ) % grid_size[0];
+				const int* cell= &grid[ (grid_uv[0] + grid_uv[1] * grid_size[0]) * 2 ];
+				if( cell[0] == -1 )
+					continue;
+
+				// Shift point by whole texture sizes. Neighborhood may wrap around texture more, than once.
+				int* p= points[ point_count ];
+				p[0]= cell[0] + ( u - grid_uv[0] ) / grid_size[0] * int(tex->size_[0]);
+				p[1]= cell[1] + ( v - grid_uv[1] ) / grid_size[1] * int(tex->size_[1]);
+
+				point_number[ point_count ]= int(cell - grid) / 2;
+				point_count++;
+			}
+		}
 
-			int nearest_point_dst2[2]= { 0xfffffff, 0xfffffff };
-			int* nearest_point_cell;
+		int x_end= ( grid_x + 1 ) * cell_size;
+		if( x_end > int(tex->size_[0]) ) x_end= int(tex->size_[0]);
 
-			for( int v= grid_pos[1] - 3; v<= grid_pos[1] + 3; v++ )
+		for( int y= grid_y * cell_size; y < y_end; y++ )
+		{
+			float* d= tex->data_ + ( grid_x * cell_size + ( y << tex->size_log2_[0] ) ) * 4;
+			for( int x= grid_x * cell_size; x < x_end; x++, d+= 4 )
 			{
-				int grid_uv[2];
-				grid_uv[1]= ( v + grid_size[1] ) % grid_size[1];
-				for( int u= grid_pos[0] - 3; u <= grid_pos[0] + 3; u++ )
+				int nearest_point_dst2[2]= { 0xfffffff, 0xfffffff };
+				int nearest_point_number= 0;
+
+				for( unsigned int i= 0; i < point_count; i++ )
 				{
-					grid_uv[0]= ( u + grid_size[0] ) % grid_size[0];
-					int* cell= &grid[ (grid_uv[0] + grid_uv[1] * grid_size[0]) * 2 ];
-					if( cell[0] != -1 )
+					int d_dst[2];
+					d_dst[0]= points[i][0] - x;
+					d_dst[1]= points[i][1] - y;
+
+					int dst2= d_dst[0] * d_dst[0] + d_dst[1] * d_dst[1];
+					if( dst2 < nearest_point_dst2[0] )
 					{
-						int d_dst[2];
-						d_dst[0]= cell[0] - x + ( u - grid_uv[0] ) * min_distanse_div_sqrt2;
-						d_dst[1]= cell[1] - y + ( v - grid_uv[1] ) * min_distanse_div_sqrt2;
-
-						if( grid_uv[0] > u ) d_dst[0]+= grid_cell_size_to_tex_size_k[0];
-						else if( grid_uv[0] < u ) d_dst[0]-= grid_cell_size_to_tex_size_k[0];
-						if( grid_uv[1] > v ) d_dst[1]+= grid_cell_size_to_tex_size_k[1];
-						else if( grid_uv[1] < v ) d_dst[1]-= grid_cell_size_to_tex_size_k[1];
-
-						int dst2= d_dst[0] * d_dst[0] + d_dst[1] * d_dst[1];
-						if( dst2 < nearest_point_dst2[0] )
-						{
-							nearest_point_dst2[1]= nearest_point_dst2[0];
-							nearest_point_dst2[0]= dst2;
-							nearest_point_cell= cell;
-						}
-						else if( dst2 < nearest_point_dst2[1] )
-							nearest_point_dst2[1]= dst2;
+						nearest_point_dst2[1]= nearest_point_dst2[0];
+						nearest_point_dst2[0]= dst2;
+						nearest_point_number= point_number[i];
 					}
-				} // for grid xy
-			} // for grid v
-
-			d[0]= std::sqrtf(float(nearest_point_dst2[0])) * intencity_multipler;
-			d[1]= ( std::sqrtf(float(nearest_point_dst2[1])) - std::sqrtf(float(nearest_point_dst2[0])) )
-				* intencity_multipler;
-			d[2]= std::sqrtf(float(nearest_point_dst2[1])) * intencity_multipler;
-			d[3]= float((nearest_point_cell - grid)/2);
-		} // for x
-	} // for y
+					else if( dst2 < nearest_point_dst2[1] )
+						nearest_point_dst2[1]= dst2;
+				}
 
-	delete[] processing_stack;
-	delete[] grid;
+				d[0]= std::sqrtf(float(nearest_point_dst2[0])) * job.intencity_multipler;
+				d[1]= ( std::sqrtf(float(nearest_point_dst2[1])) - std::sqrtf(float(nearest_point_dst2[0])) )
+					* job.intencity_multipler;
+				d[2]= std::sqrtf(float(nearest_point_dst2[1])) * job.intencity_multipler;
+				d[3]= float( nearest_point_number );
+			} // for x
+		} // for y
+	} // for grid x
 }
 
 void mx_Texture::GenHexagonalGrid( float edge_size, float y_scaler )
 {
+	PrepareWrite( true );
+
 	float inv_step_size= 1.0f / (edge_size * 1.5f);
 
 	const float c_hexagon_y_scale= 1.1547005383792515290182975610039f;
@@ -246,6 +318,8 @@ void mx_Texture::GenHexagonalGrid( float edge_size, float y_scaler )
 
 void mx_Texture::GenNormalMap()
 {
+	PrepareWrite();
+
 	unsigned int size_x1= size_[0] - 1;
 	unsigned int size_y1= size_[1] - 1;
 
@@ -281,6 +355,8 @@ void mx_Texture::GenNormalMap()
 
 void mx_Texture::Gradient( unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, const float* color0, const float* color1 )
 {
+	PrepareWrite( true );
+
 	float plane_normal[]= { float(x1-x0), float(y1-y0), 0.0f };
 	mxVec3Normalize( plane_normal );
 
@@ -305,6 +381,8 @@ void mx_Texture::Gradient( unsigned int x0, unsigned int y0, unsigned int x1, un
 
 void mx_Texture::RadialGradient( int center_x, int center_y, int radius, const float* color0, const float* color1 )
 {
+	PrepareWrite();
+
 	int size_x1= size_[0] - 1;
 	int size_y1= size_[1] - 1;
 	float inv_radius_f= 1.0f / float(radius);
@@ -330,11 +408,14 @@ void mx_Texture::RadialGradient( int center_x, int center_y, int radius, const f
 
 void mx_Texture::Fill( const float* color )
 {
+	PrepareWrite( true );
 	FillRect( 0, 0, size_[0], size_[1], color );
 }
 
 void mx_Texture::FillRect( unsigned int x, unsigned int y, unsigned int width, unsigned int height, const float* color )
 {
+	PrepareWrite();
+
 	for( unsigned int j= y; j< y + height; j++ )
 	{
 		float* d= data_ + (x + (j<<size_log2_[0])) * 4;
@@ -350,6 +431,8 @@ void mx_Texture::FillRect( unsigned int x, unsigned int y, unsigned int width, u
 
 void mx_Texture::FillEllipse( int center_x, int center_y, int radius, const float* color, float scale_x, float scale_y )
 {
+	PrepareWrite();
+
 	int size_x1= size_[0] - 1;
 	int size_y1= size_[1] - 1;
 	float radius2= float(radius * radius);
@@ -378,6 +461,8 @@ void mx_Texture::FillEllipse( int center_x, int center_y, int radius, const floa
 
 void mx_Texture::DrawLine( unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, const float* color )
 {
+	PrepareWrite();
+
 	unsigned int size_x1= size_[0] - 1;
 	unsigned int size_y1= size_[1] - 1;
 
@@ -461,17 +546,13 @@ void mx_Texture::DrawLine( unsigned int x0, unsigned int y0, unsigned int x1, un
 
 void mx_Texture::Grayscale()
 {
-	float* d= data_;
-	float* d_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d< d_end; d+= 4 )
-	{
-		float g= ( d[0] + d[1] + d[2] ) * 0.3333333f;
-		d[0]= d[1]= d[2]= g;
-	}
+	AddPointOp( OpGrayscale, NULL );
 }
 
 void mx_Texture::Smooth()
 {
+	PrepareWrite();
+
 	float* new_data= new float[ size_[0] * size_[1] * 4 ];
 	float* out_data= new_data;
 
@@ -498,21 +579,30 @@ void mx_Texture::Smooth()
 	data_= new_data;
 }
 
+void mx_Texture::Blur( unsigned int radius )
+{
+	PrepareWrite();
+
+	BlurJobData job_data;
+	job_data.texture= this;
+	job_data.tmp_data= new float[ 1<<( size_log2_[0] + size_log2_[1] + 2) ];
+	job_data.radius= radius;
+
+	mxParallelFor( BlurRowsJob, &job_data, ( size_[1] + MX_BLUR_ROWS_PER_JOB - 1 ) / MX_BLUR_ROWS_PER_JOB );
+	mxParallelFor( BlurColumnsJob, &job_data, ( size_[0] + MX_BLUR_COLUMNS_PER_JOB - 1 ) / MX_BLUR_COLUMNS_PER_JOB );
+
+	delete[] job_data.tmp_data;
+}
+
 void mx_Texture::Abs()
 {
-	float* d= data_;
-	float* d_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d< d_end; d+= 4 )
-	{
-		d[0]= fabsf(d[0]);
-		d[1]= fabsf(d[1]);
-		d[2]= fabsf(d[2]);
-		d[3]= fabsf(d[3]);
-	}
+	AddPointOp( OpAbs, NULL );
 }
 
 void mx_Texture::SinWaveDeformX( float amplitude, float freq, float phase )
 {
+	PrepareWrite();
+
 	float* new_data= new float[ 1<<( size_log2_[0] + size_log2_[1] + 2) ];
 
 	unsigned int size_y1= size_[1] - 1;
@@ -539,6 +629,8 @@ void mx_Texture::SinWaveDeformX( float amplitude, float freq, float phase )
 
 void mx_Texture::SinWaveDeformY( float amplitude, float freq, float phase )
 {
+	PrepareWrite();
+
 	float* new_data= new float[ 1<<( size_log2_[0] + size_log2_[1] + 2) ];
 	float* dst= new_data;
 
@@ -564,6 +656,8 @@ void mx_Texture::SinWaveDeformY( float amplitude, float freq, float phase )
 
 void mx_Texture::DownscaleX()
 {
+	PrepareWrite();
+
 	unsigned int size_x_minus_1= size_[0] - 1;
 	float* new_data= new float[ size_[0] * size_[1] * 4 ];
 
@@ -586,6 +680,8 @@ void mx_Texture::DownscaleX()
 
 void mx_Texture::DownscaleY()
 {
+	PrepareWrite();
+
 	unsigned int size_y_minus_1= size_[1] - 1;
 	float* new_data= new float[ size_[0] * size_[1] * 4 ];
 
@@ -610,6 +706,8 @@ void mx_Texture::DownscaleY()
 
 void mx_Texture::FlipX()
 {
+	PrepareWrite();
+
 	for( unsigned int y= 0; y< size_[1]; y++ )
 	{
 		float* data0= data_ + (y<<size_log2_[0]) * 4;
@@ -626,6 +724,8 @@ void mx_Texture::FlipX()
 
 void mx_Texture::FlipY()
 {
+	PrepareWrite();
+
 	for( unsigned int y= 0; y< size_[1]/2; y++ )
 	{
 		float* data0= data_ + (y<<size_log2_[0]) * 4;
@@ -642,6 +742,8 @@ void mx_Texture::FlipY()
 
 void mx_Texture::FillTriangle( const float* xy_coords, const float* color )
 {
+	PrepareWrite();
+
 	unsigned int upper_vertex, bottom_vertex, middle_vertex;
 
 	upper_vertex= ( xy_coords[0+1] > xy_coords[2+1] ) ? 0 : 2;
@@ -686,11 +788,16 @@ void mx_Texture::FillTriangle( const float* xy_coords, const float* color )
 
 void mx_Texture::Copy( const mx_Texture* t )
 {
+	PrepareWrite( true );
+	t->Flush();
+
 	memcpy( data_, t->data_, ( 1<<( size_log2_[0] + size_log2_[1] + 2 ) ) * sizeof(float) );
 }
 
 void mx_Texture::CopyRect( const mx_Texture* src, unsigned int width, unsigned int height, unsigned int x_dst, unsigned int y_dst, unsigned int x_src, unsigned int y_src )
 {
+	PrepareWrite();
+
 	for( unsigned int v= 0; v< height; v++ )
 	{
 		const float* src_data= src->GetData() + ( x_src + ((v + y_src) << src->SizeXLog2()) ) * 4;
@@ -701,6 +808,8 @@ void mx_Texture::CopyRect( const mx_Texture* src, unsigned int width, unsigned i
 
 void mx_Texture::Rotate( float deg )
 {
+	PrepareWrite();
+
 	float* new_data= new float[ 1<<(size_log2_[0] + size_log2_[1] + 2) ];
 	float* d= new_data;
 	unsigned int size_x1= (1 << size_log2_[0]) - 1;
@@ -730,6 +839,8 @@ void mx_Texture::Rotate( float deg )
 
 void mx_Texture::Shift( unsigned int dx, unsigned int dy )
 {
+	PrepareWrite();
+
 	unsigned int size_x1= size_[0] - 1;
 	unsigned int size_y1= size_[1] - 1;
 	
@@ -754,94 +865,37 @@ void mx_Texture::Shift( unsigned int dx, unsigned int dy )
 
 void mx_Texture::Invert( const float* add_color )
 {
-	float* d= data_;
-	float* d_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d< d_end; d+= 4 )
-	{
-		d[0]= add_color[0] - d[0];
-		d[1]= add_color[1] - d[1];
-		d[2]= add_color[2] - d[2];
-		d[3]= add_color[3] - d[3];
-	}
+	AddPointOp( OpInvert, NULL, add_color );
 }
 
 void mx_Texture::Add( const mx_Texture* t )
 {
-	const float* d1= t->data_;
-	float* d0= data_;
-	float* d0_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d0< d0_end; d0+= 4, d1+= 4 )
-	{
-		d0[0]+= d1[0];
-		d0[1]+= d1[1];
-		d0[2]+= d1[2];
-		d0[3]+= d1[3];
-	}
+	AddPointOp( OpAddTexture, t );
 }
 
 void mx_Texture::Sub( const mx_Texture* t )
 {
-	const float* d1= t->data_;
-	float* d0= data_;
-	float* d0_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d0< d0_end; d0+= 4, d1+= 4 )
-	{
-		d0[0]-= d1[0];
-		d0[1]-= d1[1];
-		d0[2]-= d1[2];
-		d0[3]-= d1[3];
-	}
+	AddPointOp( OpSubTexture, t );
 }
 
 void mx_Texture::Mul( const mx_Texture* t )
 {
-	const float* d1= t->data_;
-	float* d0= data_;
-	float* d0_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d0< d0_end; d0+= 4, d1+= 4 )
-	{
-		d0[0]*= d1[0];
-		d0[1]*= d1[1];
-		d0[2]*= d1[2];
-		d0[3]*= d1[3];
-	}
+	AddPointOp( OpMulTexture, t );
 }
 
 void mx_Texture::Max( const mx_Texture* t )
 {
-	const float* d1= t->data_;
-	float* d0= data_;
-	float* d0_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d0< d0_end; d0+= 4, d1+= 4 )
-	{
-		for( unsigned int j= 0; j< 4; j++ )
-			d0[j]= (d0[j] > d1[j]) ? d0[j] : d1[j];
-	}
+	AddPointOp( OpMaxTexture, t );
 }
 
 void mx_Texture::Min( const mx_Texture* t )
 {
-	const float* d1= t->data_;
-	float* d0= data_;
-	float* d0_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d0< d0_end; d0+= 4, d1+= 4 )
-	{
-		for( unsigned int j= 0; j< 4; j++ )
-			d0[j]= (d0[j] < d1[j]) ? d0[j] : d1[j];
-	}
+	AddPointOp( OpMinTexture, t );
 }
 
 void mx_Texture::Add( const float* color )
 {
-	float* d= data_;
-	float* d_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d< d_end; d+= 4 )
-	{
-		d[0]+= color[0];
-		d[1]+= color[1];
-		d[2]+= color[2];
-		d[3]+= color[3];
-	}
+	AddPointOp( OpAdd, NULL, color );
 }
 
 void mx_Texture::Sub( const float* color )
@@ -852,125 +906,54 @@ void mx_Texture::Sub( const float* color )
 
 void mx_Texture::Mul( const float* color )
 {
-	float* d= data_;
-	float* d_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d< d_end; d+= 4 )
-	{
-		d[0]*= color[0];
-		d[1]*= color[1];
-		d[2]*= color[2];
-		d[3]*= color[3];
-	}
+	AddPointOp( OpMul, NULL, color );
 }
 
 void mx_Texture::Max( const float* color )
 {
-	float* d= data_;
-	float* d_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d< d_end; d+= 4 )
-	{
-		for( unsigned int j= 0; j< 4; j++ )
-			d[j]= (d[j] > color[j]) ? d[j] : color[j];
-	}
+	AddPointOp( OpMax, NULL, color );
 }
 
 void mx_Texture::Min( const float* color )
 {
-	float* d= data_;
-	float* d_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d< d_end; d+= 4 )
-	{
-		for( unsigned int j= 0; j< 4; j++ )
-			d[j]= (d[j] < color[j]) ? d[j] : color[j];
-	}
+	AddPointOp( OpMin, NULL, color );
 }
 
 void mx_Texture::Pow( float p )
 {
-	float* d= data_;
-	float* d_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d< d_end; d+= 4 )
-	{
-		d[0]= std::powf( d[0], p );
-		d[1]= std::powf( d[1], p );
-		d[2]= std::powf( d[2], p );
-		d[3]= std::powf( d[3], p );
-	}
+	float p4[4]= { p, p, p, p };
+	AddPointOp( OpPow, NULL, p4 );
 }
 
 void mx_Texture::Mod( const float* mod_color )
 {
-	float* d= data_;
-	float* d_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-
 	float mod_inv_color[4]= { 1.0f / mod_color[0], 1.0f / mod_color[1],  1.0f / mod_color[2],  1.0f / mod_color[3] };
-	for( ; d< d_end; d+=4 )
-	{
-		for( unsigned int j= 0; j< 4; j++ )
-		{
-			float tmp= d[j] * mod_inv_color[j];
-			d[j]= (tmp - std::floorf(tmp)) * mod_color[j];
-		}
-	}
+	AddPointOp( OpMod, NULL, mod_color, mod_inv_color );
 }
 
 void mx_Texture::Mix( const float* color0, const float* color1, const float* sub_color )
 {
-	float* d= data_;
-	float* d_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d< d_end; d+= 4 )
-	{
-		for( unsigned int j= 0; j< 4; j++ )
-			d[j]= color0[j] * d[j] + color1[j] * (sub_color[j] - d[j]);
-	}
+	AddPointOp( OpMix, NULL, color0, color1, sub_color );
 }
 
 void mx_Texture::AlphaBlendSrc( const mx_Texture* t )
 {
-	float* d= data_;
-	const float* src_d_= t->data_;
-	float* d_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d< d_end; d+= 4, src_d_+= 4 )
-	{
-		for( unsigned int j= 0; j< 4; j++ )
-			d[j]= d[j] * d[3] + src_d_[j] * (1.0f - d[3]);
-	}
+	AddPointOp( OpAlphaBlendSrc, t );
 }
 
 void mx_Texture::AlphaBlendDst( const mx_Texture* t )
 {
-	float* d= data_;
-	const float* src_d_= t->data_;
-	float* d_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d< d_end; d+= 4, src_d_+= 4 )
-	{
-		for( unsigned int j= 0; j< 4; j++ )
-			d[j]= d[j] * src_d_[3] + src_d_[j] * (1.0f - src_d_[3]);
-	}
+	AddPointOp( OpAlphaBlendDst, t );
 }
 
 void mx_Texture::AlphaBlendOneMinusSrc( const mx_Texture* t )
 {
-	float* d= data_;
-	const float* src_d_= t->data_;
-	float* d_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d< d_end; d+= 4, src_d_+= 4 )
-	{
-		for( unsigned int j= 0; j< 4; j++ )
-			d[j]= src_d_[j] * d[3] + d[j] * (1.0f - d[3]);
-	}
+	AddPointOp( OpAlphaBlendOneMinusSrc, t );
 }
 
 void mx_Texture::AlphaBlendOneMinusDst( const mx_Texture* t )
 {
-	float* d= data_;
-	const float* src_d_= t->data_;
-	float* d_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	for( ; d< d_end; d+= 4, src_d_+= 4 )
-	{
-		for( unsigned int j= 0; j< 4; j++ )
-			d[j]= src_d_[j] * src_d_[3] + d[j] * (1.0f - src_d_[3]);
-	}
+	AddPointOp( OpAlphaBlendOneMinusDst, t );
 }
 
 /*
@@ -1013,41 +996,294 @@ void mx_Texture::LinearNormalization( float k )
 {
 	AllocateNormalizedData();
 
-	float* d0= data_;
-	float* d0_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	unsigned char* d1= normalized_data_;
+	float mk[4]= { 255.0f * k, 0.0f, 0.0f, 0.0f };
+	AddPointOp( OpLinearNormalization, NULL, mk );
+	Flush();
+}
+
+void mx_Texture::ExpNormalization( float k )
+{
+	AllocateNormalizedData();
+
+	float mk[4]= { -k, 0.0f, 0.0f, 0.0f };
+	AddPointOp( OpExpNormalization, NULL, mk );
+	Flush();
+}
+
+void mx_Texture::SetDeferred( bool deferred )
+{
+	if( !deferred )
+		Flush();
+	deferred_= deferred;
+}
+
+void mx_Texture::Flush() const
+{
+	if( deferred_op_count_ == 0 )
+		return;
+
+	unsigned int pixel_count= 1 << ( size_log2_[0] + size_log2_[1] );
+	mxParallelFor(
+		DeferredOpsJob, const_cast<mx_Texture*>(this),
+		( pixel_count + MX_DEFERRED_TILE_PIXELS - 1 ) / MX_DEFERRED_TILE_PIXELS );
+
+	ReleaseDeferredOps();
+}
+
+void mx_Texture::PrepareWrite( bool overwrite )
+{
+	if( deferred_user_ != NULL )
+		deferred_user_->Flush();
 
-	float mk= 255.0f * k;
-	for( ; d0< d0_end; d0+= 4, d1+= 4 )
+	if( overwrite )
+		ReleaseDeferredOps();
+	else
+		Flush();
+}
+
+void mx_Texture::ReleaseDeferredOps() const
+{
+	for( unsigned int i= 0; i < deferred_op_count_; i++ )
 	{
-		for( unsigned int j= 0; j< 4; j++ )
-		{
-			int c= int( d0[j] * mk );
-			if( c < 0 ) c= 0;
-			else if ( c > 255 ) c= 255;
-			d1[j]= (unsigned char)c;
-		}
+		const mx_Texture* t= deferred_ops_[i].texture;
+		if( t != NULL && t->deferred_user_ == this )
+			t->deferred_user_= NULL;
 	}
+	deferred_op_count_= 0;
 }
 
-void mx_Texture::ExpNormalization( float k )
+void mx_Texture::AddPointOp( PointOpType type, const mx_Texture* t, const float* color0, const float* color1, const float* color2 )
 {
-	AllocateNormalizedData();
+	// Somebody reads this texture later, evaluate him now.
+	if( deferred_user_ != NULL )
+		deferred_user_->Flush();
+
+	PointOp op;
+	op.type= type;
+	op.texture= t;
+	const float* colors[3]= { color0, color1, color2 };
+	for( unsigned int i= 0; i < 3; i++ )
+		if( colors[i] != NULL )
+			for( unsigned int j= 0; j < 4; j++ )
+				op.color[i][j]= colors[i][j];
+
+	if( t != NULL && t != this )
+		t->Flush();
+
+	if( !deferred_ )
+	{
+		ApplyPointOp( op, data_, data_ + (1<<( size_log2_[0] + size_log2_[1] + 2)), 0, normalized_data_ );
+		return;
+	}
+
+	if( t != NULL && t != this )
+	{
+		if( t->deferred_user_ != NULL && t->deferred_user_ != this )
+			t->deferred_user_->Flush();
+		t->deferred_user_= this;
+	}
 
-	float* d0= data_;
-	float* d0_end= data_ + (1<<( size_log2_[0] + size_log2_[1] + 2));
-	unsigned char* d1= normalized_data_;
+	if( deferred_op_count_ == MX_MAX_DEFERRED_OPS )
+		Flush();
+	deferred_ops_[ deferred_op_count_++ ]= op;
+}
+
+void mx_Texture::DeferredOpsJob( void* data, unsigned int job_index )
+{
+	const mx_Texture* tex= (const mx_Texture*)data;
+
+	unsigned int offset= job_index * MX_DEFERRED_TILE_PIXELS * 4;
+	unsigned int end= offset + MX_DEFERRED_TILE_PIXELS * 4;
+	unsigned int size= 1 << ( tex->size_log2_[0] + tex->size_log2_[1] + 2 );
+	if( end > size ) end= size;
+
+	for( unsigned int i= 0; i < tex->deferred_op_count_; i++ )
+		ApplyPointOp( tex->deferred_ops_[i], tex->data_ + offset, tex->data_ + end, offset, tex->normalized_data_ );
+}
+
+void mx_Texture::ApplyPointOp( const PointOp& op, float* d, float* d_end, unsigned int offset, unsigned char* normalized_data )
+{
+	const float* s= op.texture != NULL ? op.texture->data_ + offset : NULL;
+	const float* c0= op.color[0];
+	const float* c1= op.color[1];
+	const float* c2= op.color[2];
 
-	float mk= -k;
-	for( ; d0< d0_end; d0+= 4, d1+= 4 )
+#ifdef MX_TEXTURE_SSE2
+	if( g_use_sse2 )
 	{
-		for( unsigned int j= 0; j< 4; j++ )
+		__m128 v0= _mm_loadu_ps( c0 );
+		__m128 one= _mm_set1_ps( 1.0f );
+
+		switch( op.type )
 		{
-			int c= int( 255.0f * ( 1.0f - std::expf( d0[j] * mk ) ) );
-			if( c < 0 ) c= 0; else if ( c > 255 ) c= 255;
-			d1[j]= (unsigned char)c;
+		case OpInvert:
+			for( ; d < d_end; d+= 4 )
+				_mm_storeu_ps( d, _mm_sub_ps( v0, _mm_loadu_ps(d) ) );
+			return;
+		case OpAddTexture:
+			for( ; d < d_end; d+= 4, s+= 4 )
+				_mm_storeu_ps( d, _mm_add_ps( _mm_loadu_ps(d), _mm_loadu_ps(s) ) );
+			return;
+		case OpSubTexture:
+			for( ; d < d_end; d+= 4, s+= 4 )
+				_mm_storeu_ps( d, _mm_sub_ps( _mm_loadu_ps(d), _mm_loadu_ps(s) ) );
+			return;
+		case OpMulTexture:
+			for( ; d < d_end; d+= 4, s+= 4 )
+				_mm_storeu_ps( d, _mm_mul_ps( _mm_loadu_ps(d), _mm_loadu_ps(s) ) );
+			return;
+		case OpMaxTexture:
+			for( ; d < d_end; d+= 4, s+= 4 )
+				_mm_storeu_ps( d, _mm_max_ps( _mm_loadu_ps(d), _mm_loadu_ps(s) ) );
+			return;
+		case OpMinTexture:
+			for( ; d < d_end; d+= 4, s+= 4 )
+				_mm_storeu_ps( d, _mm_min_ps( _mm_loadu_ps(d), _mm_loadu_ps(s) ) );
+			return;
+		case OpAdd:
+			for( ; d < d_end; d+= 4 )
+				_mm_storeu_ps( d, _mm_add_ps( _mm_loadu_ps(d), v0 ) );
+			return;
+		case OpMul:
+			for( ; d < d_end; d+= 4 )
+				_mm_storeu_ps( d, _mm_mul_ps( _mm_loadu_ps(d), v0 ) );
+			return;
+		case OpMax:
+			for( ; d < d_end; d+= 4 )
+				_mm_storeu_ps( d, _mm_max_ps( _mm_loadu_ps(d), v0 ) );
+			return;
+		case OpMin:
+			for( ; d < d_end; d+= 4 )
+				_mm_storeu_ps( d, _mm_min_ps( _mm_loadu_ps(d), v0 ) );
+			return;
+		case OpAbs:
+			v0= _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) );
+			for( ; d < d_end; d+= 4 )
+				_mm_storeu_ps( d, _mm_and_ps( _mm_loadu_ps(d), v0 ) );
+			return;
+		case OpMix:
+			{
+				__m128 v1= _mm_loadu_ps( c1 );
+				__m128 v2= _mm_loadu_ps( c2 );
+				for( ; d < d_end; d+= 4 )
+				{
+					__m128 v= _mm_loadu_ps(d);
+					_mm_storeu_ps( d, _mm_add_ps( _mm_mul_ps( v0, v ), _mm_mul_ps( v1, _mm_sub_ps( v2, v ) ) ) );
+				}
+			}
+			return;
+		case OpAlphaBlendSrc:
+		case OpAlphaBlendDst:
+		case OpAlphaBlendOneMinusSrc:
+		case OpAlphaBlendOneMinusDst:
+			{
+				bool alpha_from_dst= op.type == OpAlphaBlendSrc || op.type == OpAlphaBlendOneMinusSrc;
+				bool one_minus= op.type == OpAlphaBlendOneMinusSrc || op.type == OpAlphaBlendOneMinusDst;
+				for( ; d < d_end; d+= 4, s+= 4 )
+				{
+					__m128 v= _mm_loadu_ps(d);
+					__m128 vs= _mm_loadu_ps(s);
+					__m128 a= alpha_from_dst ? v : vs;
+					a= _mm_shuffle_ps( a, a, _MM_SHUFFLE(3,3,3,3) );
+					if( one_minus )
+						_mm_storeu_ps( d, _mm_add_ps( _mm_mul_ps( vs, a ), _mm_mul_ps( v, _mm_sub_ps( one, a ) ) ) );
+					else
+						_mm_storeu_ps( d, _mm_add_ps( _mm_mul_ps( v, a ), _mm_mul_ps( vs, _mm_sub_ps( one, a ) ) ) );
+				}
+			}
+			return;
+		default:
+			break;
 		}
 	}
+#endif
+
+	if( op.type == OpLinearNormalization || op.type == OpExpNormalization )
+	{
+		unsigned char* n= normalized_data + offset;
+		for( ; d < d_end; d+= 4, n+= 4 )
+			for( unsigned int j= 0; j < 4; j++ )
+			{
+				int c= op.type == OpLinearNormalization
+					? int( d[j] * c0[0] )
+					: int( 255.0f * ( 1.0f - std::expf( d[j] * c0[0] ) ) );
+				if( c < 0 ) c= 0;
+				else if ( c > 255 ) c= 255;
+				n[j]= (unsigned char)c;
+			}
+		return;
+	}
+
+	for( ; d < d_end; d+= 4 )
+	{
+		switch( op.type )
+		{
+		case OpInvert:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]= c0[j] - d[j];
+			break;
+		case OpAddTexture:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]+= s[j];
+			break;
+		case OpSubTexture:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]-= s[j];
+			break;
+		case OpMulTexture:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]*= s[j];
+			break;
+		case OpMaxTexture:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]= (d[j] > s[j]) ? d[j] : s[j];
+			break;
+		case OpMinTexture:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]= (d[j] < s[j]) ? d[j] : s[j];
+			break;
+		case OpAdd:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]+= c0[j];
+			break;
+		case OpMul:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]*= c0[j];
+			break;
+		case OpMax:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]= (d[j] > c0[j]) ? d[j] : c0[j];
+			break;
+		case OpMin:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]= (d[j] < c0[j]) ? d[j] : c0[j];
+			break;
+		case OpAbs:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]= fabsf(d[j]);
+			break;
+		case OpGrayscale:
+			d[0]= d[1]= d[2]= ( d[0] + d[1] + d[2] ) * 0.3333333f;
+			break;
+		case OpPow:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]= std::powf( d[j], c0[j] );
+			break;
+		case OpMod:
+			for( unsigned int j= 0; j < 4; j++ )
+			{
+				float tmp= d[j] * c1[j];
+				d[j]= (tmp - std::floorf(tmp)) * c0[j];
+			}
+			break;
+		case OpMix:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]= c0[j] * d[j] + c1[j] * (c2[j] - d[j]);
+			break;
+		case OpAlphaBlendSrc:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]= d[j] * d[3] + s[j] * (1.0f - d[3]);
+			break;
+		case OpAlphaBlendDst:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]= d[j] * s[3] + s[j] * (1.0f - s[3]);
+			break;
+		case OpAlphaBlendOneMinusSrc:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]= s[j] * d[3] + d[j] * (1.0f - d[3]);
+			break;
+		case OpAlphaBlendOneMinusDst:
+			for( unsigned int j= 0; j < 4; j++ ) d[j]= s[j] * s[3] + d[j] * (1.0f - s[3]);
+			break;
+		default:
+			break;
+		};
+		if( s != NULL ) s+= 4;
+	}
 }
 
 unsigned int mx_Texture::Noise2( unsigned int x, unsigned int y, unsigned int seed, unsigned int mask )
@@ -1071,48 +1307,236 @@ unsigned int mx_Texture::Noise2( unsigned int x, unsigned int y, unsigned int se
 	return ( ( n * ( n * n * 60493u + 19990303u ) + 1376312589u ) & 0x7fffffff ) >> 16;
 }
 
-unsigned int mx_Texture::InterpolatedNoise( unsigned int x, unsigned int y, unsigned int seed, unsigned int k )
+// Adds one noise octave to row sums. v - lattice values, interpolated by y.
+// Interpolation by x is incremental - v0 * step + (v1 - v0) * dx, result is same, as v1 * dx + v0 * (step - dx).
+static void AddNoiseOctaveRow( unsigned int* row_sum, const unsigned int* v, unsigned int size_x, unsigned int k, unsigned int octave )
 {
-	unsigned int step= 1<<k;
-	unsigned int mask= ((1<<size_log2_[1])>>k)-1;//DO NOT TOUCH! This value make noise tilebale!
+	unsigned int step= 1 << k;
+	unsigned int x= 0;
 
-	unsigned int X= x >> k;
-	unsigned int Y= y >> k;
+#ifdef MX_TEXTURE_SSE2
+	if( g_use_sse2 && step >= 4 && step <= size_x )
+	{
+		__m128i shift= _mm_cvtsi32_si128( k + k );
+		__m128i octave_shift= _mm_cvtsi32_si128( octave );
+		for( unsigned int X= 0; x < size_x; X++ )
+		{
+			unsigned int acc= v[X] << k;
+			unsigned int delta= v[X+1] - v[X];
+			__m128i acc4= _mm_set_epi32( acc + delta * 3, acc + delta * 2, acc + delta, acc );
+			__m128i delta4= _mm_set1_epi32( delta * 4 );
+			for( unsigned int x_end= x + step; x < x_end; x+= 4, acc4= _mm_add_epi32( acc4, delta4 ) )
+			{
+				__m128i r= _mm_srl_epi32( _mm_srl_epi32( acc4, shift ), octave_shift );
+				_mm_storeu_si128( (__m128i*)(row_sum + x), _mm_add_epi32( _mm_loadu_si128( (__m128i*)(row_sum + x) ), r ) );
+			}
+		}
+		return;
+	}
+#endif
 
-	unsigned int noise[4]=
+	for( unsigned int X= 0; x < size_x; X++ )
 	{
-		Noise2( X    , Y    , seed, mask ),
-		Noise2( X + 1, Y    , seed, mask ),
-		Noise2( X + 1, Y + 1, seed, mask ),
-		Noise2( X    , Y + 1, seed, mask )
-	};
+		unsigned int acc= v[X] << k;
+		unsigned int delta= v[X+1] - v[X];
+		for( unsigned int dx= 0; dx < step && x < size_x; dx++, x++, acc+= delta )
+			row_sum[x]+= ( acc >> (k+k) ) >> octave;
+	}
+}
 
-	unsigned int dx= x - ( X << k );
-	unsigned int dy= y - ( Y << k );
+void mx_Texture::NoiseRowsJob( void* data, unsigned int job_index )
+{
+	static const float c_mul= 1.0f / 65535.0f;
+
+	const NoiseJobData& job= *(const NoiseJobData*)data;
+	mx_Texture* tex= job.texture;
+	unsigned int size_x= tex->size_[0];
+
+	unsigned int y_begin= job_index * MX_NOISE_ROWS_PER_JOB;
+	unsigned int y_end= y_begin + MX_NOISE_ROWS_PER_JOB;
+	if( y_end > tex->size_[1] ) y_end= tex->size_[1];
 
-	unsigned int interp_x[2]=
+	// For each octave - hashes of lower lattice row, lattice values, interpolated by y, and their y increments.
+	unsigned int lattice_width= size_x + 1;
+	unsigned int* buffer= new unsigned int[ lattice_width * 3 * job.octave_count + size_x ];
+	unsigned int* row_sum= buffer + lattice_width * 3 * job.octave_count;
+
+	for( unsigned int y= y_begin; y < y_end; y++ )
 	{
-		dy * noise[3] + (step - dy) * noise[0],
-		dy * noise[2] + (step - dy) * noise[1],
-	};
+		for( unsigned int x= 0; x < size_x; x++ )
+			row_sum[x]= 0;
+
+		for( unsigned int i= 0; i < job.octave_count; i++ )
+		{
+			unsigned int k= job.octave_count - i - 1;
+			unsigned int step= 1<<k;
+			unsigned int mask= ((1<<tex->size_log2_[1])>>k)-1;//DO NOT TOUCH! This value make noise tilebale!
+
+			unsigned int Y= y >> k;
+			unsigned int dy= y - ( Y << k );
+			unsigned int w= ( (size_x - 1) >> k ) + 2;
+
+			unsigned int* h= buffer + lattice_width * 3 * i;
+			unsigned int* v= h + lattice_width;
+			unsigned int* dv= v + lattice_width;
+
+			if( y == y_begin )
+			{
+				for( unsigned int X= 0; X < w; X++ )
+				{
+					unsigned int h0= Noise2( X, Y    , job.seed, mask );
+					h[X]=            Noise2( X, Y + 1, job.seed, mask );
+					v[X]= dy * h[X] + (step - dy) * h0;
+					dv[X]= h[X] - h0;
+				}
+			}
+			else if( dy == 0 )
+			{
+				// Upper lattice row is previous lower row.
+				for( unsigned int X= 0; X < w; X++ )
+				{
+					unsigned int h0= h[X];
+					h[X]= Noise2( X, Y + 1, job.seed, mask );
+					v[X]= step * h0;
+					dv[X]= h[X] - h0;
+				}
+			}
+			else
+			{
+				for( unsigned int X= 0; X < w; X++ )
+					v[X]+= dv[X];
+			}
+
+			AddNoiseOctaveRow( row_sum, v, size_x, k, i );
+		} // for octaves
+
+		float* d= tex->data_ + ( y << tex->size_log2_[0] ) * 4;
+		unsigned int x= 0;
+#ifdef MX_TEXTURE_SSE2
+		if( g_use_sse2 )
+		{
+			__m128 mul= _mm_set1_ps( c_mul );
+			for( ; x + 4 <= size_x; x+= 4, d+= 16 )
+			{
+				__m128 f= _mm_mul_ps( _mm_cvtepi32_ps( _mm_loadu_si128( (__m128i*)(row_sum + x) ) ), mul );
+				_mm_storeu_ps( d     , _mm_shuffle_ps( f, f, _MM_SHUFFLE(0,0,0,0) ) );
+				_mm_storeu_ps( d +  4, _mm_shuffle_ps( f, f, _MM_SHUFFLE(1,1,1,1) ) );
+				_mm_storeu_ps( d +  8, _mm_shuffle_ps( f, f, _MM_SHUFFLE(2,2,2,2) ) );
+				_mm_storeu_ps( d + 12, _mm_shuffle_ps( f, f, _MM_SHUFFLE(3,3,3,3) ) );
+			}
+		}
+#endif
+		for( ; x < size_x; x++, d+= 4 )
+			d[0]= d[1]= d[2]= d[3]= float( row_sum[x] ) * c_mul;
+	} // for y
 
-	return (interp_x[1] * dx + interp_x[0] * (step - dx) ) >>(k+k);
+	delete[] buffer;
 }
 
-unsigned int mx_Texture::FinalNoise( unsigned int x, unsigned int y, unsigned int seed, unsigned int octave_count )
-{/*
-	unsigned int r=0;
+// Running sums. Sum of window starts in each row or column from zero, so float error does not accumulate.
+void mx_Texture::BlurRowsJob( void* data, unsigned int job_index )
+{
+	const BlurJobData& job= *(const BlurJobData*)data;
+	const mx_Texture* tex= job.texture;
+	unsigned int size_x= tex->size_[0];
+	unsigned int mask= size_x - 1;
+	unsigned int radius= job.radius;
+	float k= 1.0f / float( radius * 2 + 1 );
+
+	unsigned int y_begin= job_index * MX_BLUR_ROWS_PER_JOB;
+	unsigned int y_end= y_begin + MX_BLUR_ROWS_PER_JOB;
+	if( y_end > tex->size_[1] ) y_end= tex->size_[1];
+
+	for( unsigned int y= y_begin; y < y_end; y++ )
+	{
+		const float* src= tex->data_ + ( y << tex->size_log2_[0] ) * 4;
+		float* dst= job.tmp_data + ( y << tex->size_log2_[0] ) * 4;
 
-	int od= 8 - octave_count;
-	for( int i= 1 + od, j= 7 - od; i< 8; i++, j-- )
-		r+= InterpolatedNoise( x ,y ,seed, i )>>j;
-	return r;*/
+#ifdef MX_TEXTURE_SSE2
+		if( g_use_sse2 )
+		{
+			__m128 sum= _mm_setzero_ps();
+			for( unsigned int i= 0; i < radius * 2 + 1; i++ )
+				sum= _mm_add_ps( sum, _mm_loadu_ps( src + ( ( i - radius ) & mask ) * 4 ) );
 
-	unsigned int r= 0;
-	for( unsigned int i= 0; i < octave_count; i++ )
-		r += InterpolatedNoise( x, y, seed, octave_count - i - 1 ) >> i;
+			__m128 k4= _mm_set1_ps( k );
+			for( unsigned int x= 0; x < size_x; x++ )
+			{
+				_mm_storeu_ps( dst + x * 4, _mm_mul_ps( sum, k4 ) );
+				sum= _mm_add_ps( sum, _mm_sub_ps(
+					_mm_loadu_ps( src + ( ( x + radius + 1 ) & mask ) * 4 ),
+					_mm_loadu_ps( src + ( ( x - radius ) & mask ) * 4 ) ) );
+			}
+			continue;
+		}
+#endif
+		float sum[4]= { 0.0f, 0.0f, 0.0f, 0.0f };
+		for( unsigned int i= 0; i < radius * 2 + 1; i++ )
+			for( unsigned int j= 0; j < 4; j++ )
+				sum[j]+= src[ ( ( i - radius ) & mask ) * 4 + j ];
 
-	return r;
+		for( unsigned int x= 0; x < size_x; x++ )
+			for( unsigned int j= 0; j < 4; j++ )
+			{
+				dst[ x * 4 + j ]= sum[j] * k;
+				sum[j]+= src[ ( ( x + radius + 1 ) & mask ) * 4 + j ] - src[ ( ( x - radius ) & mask ) * 4 + j ];
+			}
+	}
+}
+
+void mx_Texture::BlurColumnsJob( void* data, unsigned int job_index )
+{
+	const BlurJobData& job= *(const BlurJobData*)data;
+	const mx_Texture* tex= job.texture;
+	unsigned int mask= tex->size_[1] - 1;
+	unsigned int radius= job.radius;
+	float k= 1.0f / float( radius * 2 + 1 );
+
+	unsigned int x_begin= job_index * MX_BLUR_COLUMNS_PER_JOB;
+	unsigned int width= tex->size_[0] - x_begin;
+	if( width > MX_BLUR_COLUMNS_PER_JOB ) width= MX_BLUR_COLUMNS_PER_JOB;
+
+	// Sums for all columns of job, rows are processed sequentially.
+	float sum[ MX_BLUR_COLUMNS_PER_JOB * 4 ];
+	for( unsigned int i= 0; i < width * 4; i++ )
+		sum[i]= 0.0f;
+
+	const float* src= job.tmp_data + x_begin * 4;
+	float* dst= tex->data_ + x_begin * 4;
+	unsigned int row_shift= tex->size_log2_[0] + 2;
+
+	for( unsigned int i= 0; i < radius * 2 + 1; i++ )
+	{
+		const float* s= src + ( ( ( i - radius ) & mask ) << row_shift );
+		for( unsigned int j= 0; j < width * 4; j++ )
+			sum[j]+= s[j];
+	}
+
+	for( unsigned int y= 0; y < tex->size_[1]; y++ )
+	{
+		float* d= dst + ( y << row_shift );
+		const float* s_add= src + ( ( ( y + radius + 1 ) & mask ) << row_shift );
+		const float* s_sub= src + ( ( ( y - radius ) & mask ) << row_shift );
+		unsigned int j= 0;
+
+#ifdef MX_TEXTURE_SSE2
+		if( g_use_sse2 )
+		{
+			__m128 k4= _mm_set1_ps( k );
+			for( ; j < width * 4; j+= 4 )
+			{
+				__m128 s4= _mm_loadu_ps( sum + j );
+				_mm_storeu_ps( d + j, _mm_mul_ps( s4, k4 ) );
+				_mm_storeu_ps( sum + j, _mm_add_ps( s4, _mm_sub_ps( _mm_loadu_ps( s_add + j ), _mm_loadu_ps( s_sub + j ) ) ) );
+			}
+		}
+#endif
+		for( ; j < width * 4; j++ )
+		{
+			d[j]= sum[j] * k;
+			sum[j]+= s_add[j] - s_sub[j];
+		}
+	}
 }
 
 void mx_Texture::AllocateNormalizedData()
@@ -1,4 +1,7 @@
 #pragma once
+#include <cstddef>
+
+#define MX_MAX_DEFERRED_OPS 16
 
 void mxMonochromeImageTo8Bit( const unsigned char* in_data, unsigned char* out_data, unsigned int out_data_size );
 void mx8BitImageToWhiteWithAlpha( const unsigned char* in_data, unsigned char* out_data, unsigned int out_data_size );
@@ -9,6 +12,12 @@ public:
 	mx_Texture( unsigned int size_x_log2, unsigned int size_y_log2 );
 	~mx_Texture();
 
+	// Deferred mode. Point-wise operations are recorded and evaluated later in one pass by tiles.
+	// Evaluation happens in GetData(), in non point-wise operations and in Flush().
+	// Textures, passed into deferred operations, are evaluated first and evaluate this texture before its own change.
+	void SetDeferred( bool deferred );
+	void Flush() const;
+
 	const float* GetData() const;
 	float* GetData();
 	const unsigned char* GetNormalizedData() const;
@@ -39,6 +48,8 @@ public:
 	void DrawLine( unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, const float* color );
 	void Grayscale();
 	void Smooth();
+	// Box filter with window 2 * radius + 1. Cost does not depend on radius.
+	void Blur( unsigned int radius );
 	void Abs();
 	void SinWaveDeformX( float amplitude, float freq, float phase );
 	void SinWaveDeformY( float amplitude, float freq, float phase );
@@ -85,9 +96,78 @@ private:
 	//mx_Texture( const mx_Texture& );
 	//mx_Texture& operator=( const mx_Texture& );
 
-	unsigned int Noise2( unsigned int x, unsigned int y, unsigned int seed, unsigned int mask );
-	unsigned int InterpolatedNoise( unsigned int x, unsigned int y, unsigned int seed, unsigned int k );
-	unsigned int FinalNoise( unsigned int x, unsigned int y, unsigned int seed, unsigned int octave_count );
+	struct NoiseJobData
+	{
+		mx_Texture* texture;
+		unsigned int seed;
+		unsigned int octave_count;
+	};
+
+	static unsigned int Noise2( unsigned int x, unsigned int y, unsigned int seed, unsigned int mask );
+	// Generates noise for group of rows. Each lattice point of octave hashed once per rows group.
+	static void NoiseRowsJob( void* data, unsigned int job_index );
+
+	struct PoissonJobData
+	{
+		mx_Texture* texture;
+		const int* grid; // point coordinates for each cell, -1 if cell is empty
+		int grid_size[2];
+		int cell_size;
+		float intencity_multipler;
+	};
+
+	// Writes distances for pixels of one row of grid cells. Neighbor points searched once per cell.
+	static void PoissonDistancesJob( void* data, unsigned int job_index );
+
+	struct BlurJobData
+	{
+		mx_Texture* texture;
+		float* tmp_data;
+		unsigned int radius;
+	};
+
+	// Horizontal pass - from texture data to tmp data, vertical pass - back.
+	static void BlurRowsJob( void* data, unsigned int job_index );
+	static void BlurColumnsJob( void* data, unsigned int job_index );
+
+	enum PointOpType
+	{
+		OpInvert,
+		OpAddTexture,
+		OpSubTexture,
+		OpMulTexture,
+		OpMaxTexture,
+		OpMinTexture,
+		OpAdd,
+		OpMul,
+		OpMax,
+		OpMin,
+		OpAbs,
+		OpGrayscale,
+		OpPow,
+		OpMod,
+		OpMix,
+		OpAlphaBlendSrc,
+		OpAlphaBlendDst,
+		OpAlphaBlendOneMinusSrc,
+		OpAlphaBlendOneMinusDst,
+		OpLinearNormalization,
+		OpExpNormalization,
+	};
+
+	struct PointOp
+	{
+		PointOpType type;
+		const mx_Texture* texture;
+		float color[3][4];
+	};
+
+	// Call it before non point-wise change of data. If overwrite is true, deferred operations are dropped.
+	void PrepareWrite( bool overwrite= false );
+	void ReleaseDeferredOps() const;
+	void AddPointOp( PointOpType type, const mx_Texture* t, const float* color0= NULL, const float* color1= NULL, const float* color2= NULL );
+	static void DeferredOpsJob( void* data, unsigned int job_index );
+	static void ApplyPointOp( const PointOp& op, float* d, float* d_end, unsigned int offset, unsigned char* normalized_data );
 
 	void AllocateNormalizedData();
 
@@ -98,15 +178,23 @@ private:
 	unsigned char* normalized_data_;
 	unsigned int size_[2];
 	unsigned int size_log2_[2];
+
+	PointOp deferred_ops_[ MX_MAX_DEFERRED_OPS ];
+	mutable unsigned int deferred_op_count_;
+	bool deferred_;
+	// Texture, whose deferred operations read this texture.
+	mutable const mx_Texture* deferred_user_;
 };
 
 inline const float* mx_Texture::GetData() const
 {
+	Flush();
 	return data_;
 }
 
 inline float* mx_Texture::GetData()
 {
+	PrepareWrite();
 	return data_;
 }
 
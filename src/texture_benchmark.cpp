@@ -0,0 +1,285 @@
+// Headless benchmark of procedural textures generators. No OpenGL, no sound.
+// Usage: texture_benchmark [size_log2 ...] [-single] [-immediate] [-json file_name]
+// Default sizes - 9 and 10, as in game. Textures generated, as in renderer - deferred mode, multithreaded.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <windows.h>
+
+#include "texture.h"
+#include "textures_generation.h"
+#include "thread_pool.h"
+
+#define MX_MAX_BENCHMARK_SIZES 8
+// Steel plates generator needs texture size not less, than 128.
+#define MX_MIN_BENCHMARK_SIZE_LOG2 7
+#define MX_MAX_BENCHMARK_SIZE_LOG2 12
+// Models textures are drawn in pixel coordinates of 512x512 texture. Smaller sizes are skipped for them.
+#define MX_MIN_MODEL_TEXTURE_SIZE_LOG2 9
+#define MX_MAX_BENCHMARK_RESULTS ( ( LastLevelTexture * 2 + LastModelTexture ) * MX_MAX_BENCHMARK_SIZES )
+
+static const char* const g_level_textures_names[ LastLevelTexture ]=
+{
+	"granite",
+	"steel_plate",
+	"map_screen",
+};
+
+static const char* const g_model_textures_names[ LastModelTexture ]=
+{
+	"octo_robot",
+	"pyramid_robot",
+	"bullet_ammo",
+	"rocket_ammo",
+	"plasma_ammo",
+	"icosahedron",
+	"health_pack",
+};
+
+/*
+---------Heap usage counting---------
+All heap allocations of textures go through operator new.
+Header before each block stores its size. Counters changed from worker threads too.
+*/
+
+#define MX_ALLOCATION_HEADER_SIZE 16
+
+static volatile LONG g_heap_size= 0;
+static volatile LONG g_heap_peak_size= 0;
+
+static void* CountedAlloc( size_t size )
+{
+	unsigned char* p= (unsigned char*) std::malloc( size + MX_ALLOCATION_HEADER_SIZE );
+	if( p == NULL )
+	{
+		std::printf( "out of memory\n" );
+		std::exit(1);
+	}
+	*(size_t*)p= size;
+
+	LONG heap_size= InterlockedExchangeAdd( &g_heap_size, LONG(size) ) + LONG(size);
+	LONG peak_size= g_heap_peak_size;
+	while( heap_size > peak_size )
+	{
+		LONG prev_peak_size= InterlockedCompareExchange( &g_heap_peak_size, heap_size, peak_size );
+		if( prev_peak_size == peak_size ) break;
+		peak_size= prev_peak_size;
+	}
+
+	return p + MX_ALLOCATION_HEADER_SIZE;
+}
+
+static void CountedFree( void* ptr )
+{
+	if( ptr == NULL ) return;
+
+	unsigned char* p= (unsigned char*)ptr - MX_ALLOCATION_HEADER_SIZE;
+	InterlockedExchangeAdd( &g_heap_size, -LONG( *(size_t*)p ) );
+	std::free( p );
+}
+
+void* operator new( size_t size ) { return CountedAlloc( size ); }
+void* operator new[]( size_t size ) { return CountedAlloc( size ); }
+void operator delete( void* ptr ) { CountedFree( ptr ); }
+void operator delete[]( void* ptr ) { CountedFree( ptr ); }
+
+/*
+---------Benchmark---------
+*/
+
+enum GeneratorTable
+{
+	TableLevelTextures,
+	TableLevelHeightMaps,
+	TableModelTextures,
+	LastGeneratorTable,
+};
+
+static const char* const g_tables_names[ LastGeneratorTable ]=
+{
+	"level",
+	"level_height_map",
+	"model",
+};
+
+struct BenchmarkResult
+{
+	GeneratorTable table;
+	unsigned int generator;
+	unsigned int size_log2;
+	double time_ms;
+	double megapixels_per_second;
+	unsigned int peak_memory; // bytes
+};
+
+static double GetTimeMs()
+{
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency( &frequency );
+	QueryPerformanceCounter( &counter );
+	return double(counter.QuadPart) * 1000.0 / double(frequency.QuadPart);
+}
+
+static const char* GeneratorName( GeneratorTable table, unsigned int generator )
+{
+	return table == TableModelTextures ? g_model_textures_names[ generator ] : g_level_textures_names[ generator ];
+}
+
+static void RunGenerator( GeneratorTable table, unsigned int generator, unsigned int size_log2, bool deferred, BenchmarkResult* out_result )
+{
+	// Peak is measured relative to heap size before generation.
+	LONG heap_size_before= g_heap_size;
+	InterlockedExchange( &g_heap_peak_size, heap_size_before );
+	double time_before= GetTimeMs();
+
+	mx_Texture* tex= new mx_Texture( size_log2, size_log2 );
+	tex->SetDeferred( deferred );
+	if( table == TableLevelTextures )
+		gen_level_textures_func_table[ generator ]( tex );
+	else if( table == TableLevelHeightMaps )
+	{
+		gen_level_textures_height_map_func_table[ generator ]( tex );
+		tex->GenNormalMap();
+
+		// map from range [-1; 1] to range [0; 1], as in renderer
+		static const float k[4]= { 0.5f, 0.5f, 0.5f, 0.5f };
+		tex->Mul(k);
+		tex->Add(k);
+	}
+	else
+		gen_models_textures_func_table[ generator ]( tex );
+	tex->LinearNormalization( 1.0f );
+	delete tex;
+
+	double time= GetTimeMs() - time_before;
+
+	out_result->table= table;
+	out_result->generator= generator;
+	out_result->size_log2= size_log2;
+	out_result->time_ms= time;
+	out_result->megapixels_per_second= double( 1 << ( size_log2 * 2 ) ) / ( time * 1000.0 );
+	out_result->peak_memory= (unsigned int)( g_heap_peak_size - heap_size_before );
+}
+
+static void PrintTable( const BenchmarkResult* results, unsigned int result_count )
+{
+	std::printf( "%-34s %6s %10s %8s %10s\n", "generator", "size", "time ms", "MP/s", "peak MB" );
+	for( unsigned int i= 0; i < result_count; i++ )
+	{
+		const BenchmarkResult& r= results[i];
+		char name[64];
+		std::sprintf( name, "%s/%s", g_tables_names[ r.table ], GeneratorName( r.table, r.generator ) );
+		std::printf(
+			"%-34s %6u %10.2f %8.2f %10.2f\n",
+			name, 1 << r.size_log2, r.time_ms, r.megapixels_per_second,
+			double(r.peak_memory) / ( 1024.0 * 1024.0 ) );
+	}
+}
+
+static bool WriteJson( const char* file_name, const BenchmarkResult* results, unsigned int result_count, unsigned int thread_count, bool deferred )
+{
+	FILE* f= std::fopen( file_name, "w" );
+	if( f == NULL )
+		return false;
+
+	std::fprintf( f, "{\n\t\"threads\": %u,\n\t\"deferred\": %s,\n\t\"results\":\n\t[\n", thread_count, deferred ? "true" : "false" );
+	for( unsigned int i= 0; i < result_count; i++ )
+	{
+		const BenchmarkResult& r= results[i];
+		std::fprintf(
+			f,
+			"\t\t{ \"table\": \"%s\", \"generator\": \"%s\", \"size\": %u, \"time_ms\": %.3f, \"megapixels_per_second\": %.3f, \"peak_memory_bytes\": %u }%s\n",
+			g_tables_names[ r.table ], GeneratorName( r.table, r.generator ), 1 << r.size_log2,
+			r.time_ms, r.megapixels_per_second, r.peak_memory,
+			i + 1 < result_count ? "," : "" );
+	}
+	std::fprintf( f, "\t]\n}\n" );
+
+	std::fclose( f );
+	return true;
+}
+
+int main( int argc, const char* argv[] )
+{
+	unsigned int sizes_log2[ MX_MAX_BENCHMARK_SIZES ];
+	unsigned int size_count= 0;
+	bool single_thread= false;
+	bool deferred= true;
+	const char* json_file_name= NULL;
+
+	for( int i= 1; i < argc; i++ )
+	{
+		if( !std::strcmp( argv[i], "-single" ) )
+			single_thread= true;
+		else if( !std::strcmp( argv[i], "-immediate" ) )
+			deferred= false;
+		else if( !std::strcmp( argv[i], "-json" ) )
+		{
+			if( i + 1 >= argc )
+			{
+				std::printf( "error, missing file name after -json\n" );
+				return 1;
+			}
+			json_file_name= argv[++i];
+		}
+		else
+		{
+			int size_log2= std::atoi( argv[i] );
+			if( size_log2 < MX_MIN_BENCHMARK_SIZE_LOG2 || size_log2 > MX_MAX_BENCHMARK_SIZE_LOG2 )
+			{
+				std::printf(
+					"error, size_log2 must be in range [%d; %d], got \"%s\"\n",
+					MX_MIN_BENCHMARK_SIZE_LOG2, MX_MAX_BENCHMARK_SIZE_LOG2, argv[i] );
+				return 1;
+			}
+			if( size_count == MX_MAX_BENCHMARK_SIZES )
+			{
+				std::printf( "error, too many sizes\n" );
+				return 1;
+			}
+			sizes_log2[ size_count++ ]= size_log2;
+		}
+	}
+
+	if( size_count == 0 )
+	{
+		sizes_log2[0]= 9;
+		sizes_log2[1]= 10;
+		size_count= 2;
+	}
+
+	if( !single_thread )
+		mx_ThreadPool::CreateInstance();
+	unsigned int thread_count= single_thread ? 1 : mx_ThreadPool::Instance()->ThreadCount();
+
+	static BenchmarkResult results[ MX_MAX_BENCHMARK_RESULTS ];
+	unsigned int result_count= 0;
+
+	for( unsigned int s= 0; s < size_count; s++ )
+	{
+		for( unsigned int i= 0; i < LastLevelTexture; i++ )
+			RunGenerator( TableLevelTextures, i, sizes_log2[s], deferred, &results[ result_count++ ] );
+		for( unsigned int i= 0; i < LastLevelTexture; i++ )
+			RunGenerator( TableLevelHeightMaps, i, sizes_log2[s], deferred, &results[ result_count++ ] );
+		if( sizes_log2[s] < MX_MIN_MODEL_TEXTURE_SIZE_LOG2 )
+			continue;
+		for( unsigned int i= 0; i < LastModelTexture; i++ )
+			RunGenerator( TableModelTextures, i, sizes_log2[s], deferred, &results[ result_count++ ] );
+	}
+
+	PrintTable( results, result_count );
+
+	if( json_file_name != NULL && !WriteJson( json_file_name, results, result_count, thread_count, deferred ) )
+	{
+		std::printf( "error, can not write \"%s\"\n", json_file_name );
+		return 1;
+	}
+
+	if( !single_thread )
+		mx_ThreadPool::DeleteInstance();
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include <cstring>
+
+#include "mx_assert.h"
+
+#include "texture_cache.h"
+
+#define MX_TEXTURE_CACHE_VERSION 2
+#define MX_TEXTURE_CACHE_ALIGNMENT 16
+
+mx_TextureCache::mx_TextureCache( const char* file_name )
+	: file_name_(file_name)
+	, file_(INVALID_HANDLE_VALUE)
+	, mapping_(NULL)
+	, mapped_data_(NULL)
+	, entries_(NULL)
+	, entry_count_(0)
+	, new_entry_count_(0)
+{
+	file_= CreateFile( file_name_, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file_ == INVALID_HANDLE_VALUE )
+		return;
+
+	DWORD file_size= GetFileSize( file_, NULL );
+	if( file_size == INVALID_FILE_SIZE || file_size < sizeof(Header) )
+		return;
+
+	mapping_= CreateFileMapping( file_, NULL, PAGE_READONLY, 0, 0, NULL );
+	if( mapping_ == NULL )
+		return;
+	mapped_data_= (const unsigned char*) MapViewOfFile( mapping_, FILE_MAP_READ, 0, 0, 0 );
+	if( mapped_data_ == NULL )
+		return;
+
+	const Header* header= (const Header*) mapped_data_;
+	if( std::memcmp( header->format_code, "MXTC", 4 ) != 0 ||
+		header->version != MX_TEXTURE_CACHE_VERSION ||
+		header->entry_count > MX_MAX_CACHED_TEXTURES ||
+		sizeof(Header) + header->entry_count * sizeof(Entry) > file_size )
+		return;
+
+	entries_= (const Entry*)( mapped_data_ + sizeof(Header) );
+	for( unsigned int i= 0; i < header->entry_count; i++ )
+		if( entries_[i].offset > file_size || entries_[i].size > file_size - entries_[i].offset )
+		{
+			entries_= NULL;
+			return;
+		}
+	entry_count_= header->entry_count;
+}
+
+mx_TextureCache::~mx_TextureCache()
+{
+	Close();
+	for( unsigned int i= 0; i < new_entry_count_; i++ )
+		delete[] new_entries_data_[i];
+}
+
+const unsigned char* mx_TextureCache::Find( unsigned int key, unsigned int version, unsigned int data_size ) const
+{
+	for( unsigned int i= 0; i < entry_count_; i++ )
+		if( entries_[i].key == key && entries_[i].version == version && entries_[i].size == data_size )
+			return mapped_data_ + entries_[i].offset;
+
+	return NULL;
+}
+
+void mx_TextureCache::Add( unsigned int key, unsigned int version, const unsigned char* data, unsigned int data_size )
+{
+	MX_ASSERT( new_entry_count_ < MX_MAX_CACHED_TEXTURES );
+
+	Entry& entry= new_entries_[ new_entry_count_ ];
+	entry.key= key;
+	entry.version= version;
+	entry.size= data_size;
+	new_entries_data_[ new_entry_count_ ]= new unsigned char[ data_size ];
+	std::memcpy( new_entries_data_[ new_entry_count_ ], data, data_size );
+	new_entry_count_++;
+}
+
+void mx_TextureCache::Save()
+{
+	if( new_entry_count_ == 0 )
+		return;
+
+	// Keep old entries, which are not replaced by new.
+	Entry entries[ MX_MAX_CACHED_TEXTURES ];
+	const unsigned char* entries_data[ MX_MAX_CACHED_TEXTURES ];
+	unsigned int entry_count= 0;
+
+	for( unsigned int i= 0; i < entry_count_ && entry_count < MX_MAX_CACHED_TEXTURES; i++ )
+	{
+		bool replaced= false;
+		for( unsigned int j= 0; j < new_entry_count_; j++ )
+			if( new_entries_[j].key == entries_[i].key )
+				replaced= true;
+		if( replaced ) continue;
+
+		entries[ entry_count ]= entries_[i];
+		entries_data[ entry_count ]= mapped_data_ + entries_[i].offset;
+		entry_count++;
+	}
+	for( unsigned int i= 0; i < new_entry_count_ && entry_count < MX_MAX_CACHED_TEXTURES; i++ )
+	{
+		entries[ entry_count ]= new_entries_[i];
+		entries_data[ entry_count ]= new_entries_data_[i];
+		entry_count++;
+	}
+
+	unsigned int offset= sizeof(Header) + entry_count * sizeof(Entry);
+	for( unsigned int i= 0; i < entry_count; i++ )
+	{
+		offset= ( offset + MX_TEXTURE_CACHE_ALIGNMENT - 1 ) & ~( MX_TEXTURE_CACHE_ALIGNMENT - 1 );
+		entries[i].offset= offset;
+		offset+= entries[i].size;
+	}
+
+	// Build file in memory, because old data is in file, which we rewrite.
+	unsigned int file_size= offset;
+	unsigned char* file_data= new unsigned char[ file_size ];
+	std::memset( file_data, 0, file_size );
+
+	Header* header= (Header*) file_data;
+	std::memcpy( header->format_code, "MXTC", 4 );
+	header->version= MX_TEXTURE_CACHE_VERSION;
+	header->entry_count= entry_count;
+	std::memcpy( file_data + sizeof(Header), entries, entry_count * sizeof(Entry) );
+	for( unsigned int i= 0; i < entry_count; i++ )
+		std::memcpy( file_data + entries[i].offset, entries_data[i], entries[i].size );
+
+	Close();
+
+	HANDLE file= CreateFile( file_name_, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file != INVALID_HANDLE_VALUE )
+	{
+		DWORD written;
+		WriteFile( file, file_data, file_size, &written, NULL );
+		CloseHandle( file );
+	}
+
+	delete[] file_data;
+}
+
+void mx_TextureCache::Close()
+{
+	if( mapped_data_ != NULL )
+		UnmapViewOfFile( mapped_data_ );
+	if( mapping_ != NULL )
+		CloseHandle( mapping_ );
+	if( file_ != INVALID_HANDLE_VALUE )
+		CloseHandle( file_ );
+
+	mapped_data_= NULL;
+	mapping_= NULL;
+	file_= INVALID_HANDLE_VALUE;
+	entries_= NULL;
+	entry_count_= 0;
+}
\ No newline at end of file
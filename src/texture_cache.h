@@ -0,0 +1,55 @@
+#pragma once
+#include <windows.h>
+
+#define MX_MAX_CACHED_TEXTURES 64
+
+// Persistent cache of generated textures data. Cache file mapped into memory.
+// Entry key - generator and texture size. Entry also stores version of its generator,
+// so entry of changed generator becomes invalid, but other entries stay valid.
+class mx_TextureCache
+{
+public:
+	mx_TextureCache( const char* file_name );
+	~mx_TextureCache();
+
+	// Returns NULL, if there is no data with this key, version and size.
+	const unsigned char* Find( unsigned int key, unsigned int version, unsigned int data_size ) const;
+	// Data copied. New data written in Save(). Replaces old entry with same key.
+	void Add( unsigned int key, unsigned int version, const unsigned char* data, unsigned int data_size );
+	void Save();
+
+private:
+	mx_TextureCache(const mx_TextureCache&);
+	mx_TextureCache& operator=(const mx_TextureCache&);
+
+	struct Header
+	{
+		char format_code[4]; // must be "MXTC" - "Micro-X Texture Cache"
+		unsigned int version;
+		unsigned int entry_count;
+	};
+
+	struct Entry
+	{
+		unsigned int key;
+		unsigned int version;
+		unsigned int offset; // from file begin
+		unsigned int size;
+	};
+
+	void Close();
+
+private:
+	const char* file_name_;
+
+	HANDLE file_;
+	HANDLE mapping_;
+	const unsigned char* mapped_data_;
+	// NULL, if file not exist or invalid
+	const Entry* entries_;
+	unsigned int entry_count_;
+
+	Entry new_entries_[ MX_MAX_CACHED_TEXTURES ];
+	unsigned char* new_entries_data_[ MX_MAX_CACHED_TEXTURES ];
+	unsigned int new_entry_count_;
+};
\ No newline at end of file
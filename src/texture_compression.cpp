@@ -0,0 +1,407 @@
+#include <cmath>
+#include <cstring>
+
+#include "mx_assert.h"
+
+#include "texture_compression.h"
+
+// Lanczos2 filter weights for 2:1 downscale. Distances to source pixels - 0.5, 1.5, 2.5.
+static const float g_mip_filter[3]= { 0.42673862f, 0.11447091f, -0.04120953f };
+
+unsigned int mxCompressedMipSize( unsigned int size_log2, unsigned int level )
+{
+	unsigned int block_count= ( ( ( 1 << size_log2 ) >> level ) + 3 ) >> 2;
+	return block_count * block_count * 16;
+}
+
+unsigned int mxCompressedMipChainSize( unsigned int size_log2 )
+{
+	unsigned int size= 0;
+	for( unsigned int level= 0; level <= size_log2; level++ )
+		size+= mxCompressedMipSize( size_log2, level );
+	return size;
+}
+
+void mxBuildMip( const unsigned char* in_data, unsigned char* out_data, unsigned int in_size_log2, bool normal_map )
+{
+	MX_ASSERT( in_size_log2 > 0 );
+
+	unsigned int in_size= 1 << in_size_log2;
+	unsigned int out_size= in_size >> 1;
+	unsigned int mask= in_size - 1;
+
+	// Horizontal pass
+	float* tmp= new float[ out_size * in_size * 4 ];
+	for( unsigned int y= 0; y < in_size; y++ )
+	{
+		const unsigned char* src= in_data + ( y << in_size_log2 ) * 4;
+		float* dst= tmp + y * out_size * 4;
+		for( unsigned int x= 0; x < out_size; x++, dst+= 4 )
+			for( unsigned int j= 0; j < 4; j++ )
+			{
+				float c= 0.0f;
+				for( unsigned int t= 0; t < 3; t++ )
+					c+= g_mip_filter[t] * float(
+						src[ ( ( x * 2 - t ) & mask ) * 4 + j ] +
+						src[ ( ( x * 2 + 1 + t ) & mask ) * 4 + j ] );
+				dst[j]= c;
+			}
+	}
+
+	// Vertical pass
+	for( unsigned int y= 0; y < out_size; y++ )
+	{
+		unsigned char* dst= out_data + y * out_size * 4;
+		for( unsigned int x= 0; x < out_size; x++, dst+= 4 )
+		{
+			float c[4];
+			for( unsigned int j= 0; j < 4; j++ )
+			{
+				c[j]= 0.0f;
+				for( unsigned int t= 0; t < 3; t++ )
+					c[j]+= g_mip_filter[t] * (
+						tmp[ ( ( ( y * 2 - t ) & mask ) * out_size + x ) * 4 + j ] +
+						tmp[ ( ( ( y * 2 + 1 + t ) & mask ) * out_size + x ) * 4 + j ] );
+			}
+
+			if( normal_map )
+			{
+				float n[3];
+				for( unsigned int j= 0; j < 3; j++ )
+					n[j]= c[j] * ( 2.0f / 255.0f ) - 1.0f;
+				float len2= n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+				if( len2 > 0.000001f )
+				{
+					float k= 1.0f / std::sqrt( len2 );
+					for( unsigned int j= 0; j < 3; j++ )
+						c[j]= ( n[j] * k * 0.5f + 0.5f ) * 255.0f;
+				}
+			}
+
+			for( unsigned int j= 0; j < 4; j++ )
+			{
+				int i= int( c[j] + 0.5f );
+				if( i < 0 ) i= 0;
+				else if( i > 255 ) i= 255;
+				dst[j]= (unsigned char)i;
+			}
+		}
+	}
+
+	delete[] tmp;
+}
+
+static void FetchBlock( const unsigned char* in_data, unsigned int size_log2, unsigned int block_x, unsigned int block_y, unsigned char (*block)[4] )
+{
+	// Mips smaller, than block, are repeated.
+	unsigned int mask= ( 1 << size_log2 ) - 1;
+	for( unsigned int y= 0; y < 4; y++ )
+		for( unsigned int x= 0; x < 4; x++ )
+		{
+			unsigned int src_x= ( block_x * 4 + x ) & mask;
+			unsigned int src_y= ( block_y * 4 + y ) & mask;
+			memcpy( block[ x + y * 4 ], in_data + ( src_x + ( src_y << size_log2 ) ) * 4, 4 );
+		}
+}
+
+// BC4 block - 2 endpoints and 16 3-bit indices. Also used for alpha in BC3.
+static void EncodeAlphaBlock( const unsigned char (*block)[4], unsigned int channel, unsigned char* out )
+{
+	int min_a= 255, max_a= 0;
+	for( unsigned int i= 0; i < 16; i++ )
+	{
+		int a= block[i][channel];
+		if( a < min_a ) min_a= a;
+		if( a > max_a ) max_a= a;
+	}
+
+	// a0 > a1 - 8 values mode. If a0 == a1, all indices are 0.
+	int palette[8];
+	palette[0]= max_a;
+	palette[1]= min_a;
+	for( int i= 2; i < 8; i++ )
+		palette[i]= ( ( 8 - i ) * max_a + ( i - 1 ) * min_a ) / 7;
+
+	out[0]= (unsigned char)max_a;
+	out[1]= (unsigned char)min_a;
+	for( unsigned int half= 0; half < 2; half++ )
+	{
+		unsigned int bits= 0;
+		for( unsigned int i= 0; i < 8; i++ )
+		{
+			int a= block[ half * 8 + i ][channel];
+			unsigned int best_index= 0;
+			int best_dist= 256;
+			for( unsigned int j= 0; j < 8; j++ )
+			{
+				int dist= a > palette[j] ? a - palette[j] : palette[j] - a;
+				if( dist < best_dist )
+				{
+					best_dist= dist;
+					best_index= j;
+				}
+			}
+			bits|= best_index << ( i * 3 );
+		}
+		out[ 2 + half * 3 ]= (unsigned char)( bits       );
+		out[ 3 + half * 3 ]= (unsigned char)( bits >>  8 );
+		out[ 4 + half * 3 ]= (unsigned char)( bits >> 16 );
+	}
+}
+
+static unsigned int PackColor565( const float* c )
+{
+	static const float c_scale[3]= { 31.0f / 255.0f, 63.0f / 255.0f, 31.0f / 255.0f };
+	static const int c_max[3]= { 31, 63, 31 };
+
+	int rgb[3];
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		rgb[j]= int( c[j] * c_scale[j] + 0.5f );
+		if( rgb[j] < 0 ) rgb[j]= 0;
+		else if( rgb[j] > c_max[j] ) rgb[j]= c_max[j];
+	}
+	return ( rgb[0] << 11 ) | ( rgb[1] << 5 ) | rgb[2];
+}
+
+static void UnpackColor565( unsigned int c, int* out_rgb )
+{
+	int r= ( c >> 11 ) & 31;
+	int g= ( c >> 5 ) & 63;
+	int b= c & 31;
+	out_rgb[0]= ( r << 3 ) | ( r >> 2 );
+	out_rgb[1]= ( g << 2 ) | ( g >> 4 );
+	out_rgb[2]= ( b << 3 ) | ( b >> 2 );
+}
+
+// Finds nearest palette colors for endpoints c0 > c1. Returns squared error.
+static unsigned int ColorBlockIndices( const unsigned char (*block)[4], unsigned int c0, unsigned int c1, unsigned int* out_indices )
+{
+	int palette[4][3];
+	UnpackColor565( c0, palette[0] );
+	UnpackColor565( c1, palette[1] );
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		palette[2][j]= ( 2 * palette[0][j] + palette[1][j] ) / 3;
+		palette[3][j]= ( palette[0][j] + 2 * palette[1][j] ) / 3;
+	}
+
+	unsigned int error= 0;
+	unsigned int indices= 0;
+	for( unsigned int i= 0; i < 16; i++ )
+	{
+		unsigned int best_index= 0;
+		unsigned int best_dist= 0xffffffff;
+		for( unsigned int k= 0; k < 4; k++ )
+		{
+			unsigned int dist= 0;
+			for( unsigned int j= 0; j < 3; j++ )
+			{
+				int d= int(block[i][j]) - palette[k][j];
+				dist+= d * d;
+			}
+			if( dist < best_dist )
+			{
+				best_dist= dist;
+				best_index= k;
+			}
+		}
+		indices|= best_index << ( i * 2 );
+		error+= best_dist;
+	}
+
+	*out_indices= indices;
+	return error;
+}
+
+// Least squares fit of endpoints for given indices. Returns false, if all pixels use same weight.
+static bool RefineColorEndpoints( const unsigned char (*block)[4], unsigned int indices, float* out_c0, float* out_c1 )
+{
+	static const float c_index_weight[4]= { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+	float alpha2= 0.0f, beta2= 0.0f, alpha_beta= 0.0f;
+	float alpha_x[3]= { 0.0f, 0.0f, 0.0f };
+	float beta_x[3]= { 0.0f, 0.0f, 0.0f };
+	for( unsigned int i= 0; i < 16; i++ )
+	{
+		float a= c_index_weight[ ( indices >> ( i * 2 ) ) & 3 ];
+		float b= 1.0f - a;
+		alpha2+= a * a;
+		beta2+= b * b;
+		alpha_beta+= a * b;
+		for( unsigned int j= 0; j < 3; j++ )
+		{
+			alpha_x[j]+= a * float(block[i][j]);
+			beta_x[j]+= b * float(block[i][j]);
+		}
+	}
+
+	float det= alpha2 * beta2 - alpha_beta * alpha_beta;
+	if( std::fabs( det ) < 0.0001f )
+		return false;
+
+	float inv_det= 1.0f / det;
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		out_c0[j]= ( alpha_x[j] * beta2 - beta_x[j] * alpha_beta ) * inv_det;
+		out_c1[j]= ( beta_x[j] * alpha2 - alpha_x[j] * alpha_beta ) * inv_det;
+	}
+	return true;
+}
+
+static unsigned int FitColorEndpoints( const unsigned char (*block)[4], const float* c0_f, const float* c1_f, unsigned int* out_c0, unsigned int* out_c1, unsigned int* out_indices )
+{
+	unsigned int c0= PackColor565( c0_f );
+	unsigned int c1= PackColor565( c1_f );
+	// c0 > c1 - 4 colors mode. If c0 == c1 all indices are 0, which is correct in 3 colors mode too.
+	if( c0 < c1 )
+	{
+		unsigned int tmp= c0;
+		c0= c1;
+		c1= tmp;
+	}
+
+	*out_c0= c0;
+	*out_c1= c1;
+	return ColorBlockIndices( block, c0, c1, out_indices );
+}
+
+// BC1 block in 4 colors mode. Endpoints - extremums along principal axis, refined by least squares.
+static void EncodeColorBlock( const unsigned char (*block)[4], unsigned char* out )
+{
+	float mean[3]= { 0.0f, 0.0f, 0.0f };
+	for( unsigned int i= 0; i < 16; i++ )
+		for( unsigned int j= 0; j < 3; j++ )
+			mean[j]+= float(block[i][j]);
+	for( unsigned int j= 0; j < 3; j++ )
+		mean[j]*= 1.0f / 16.0f;
+
+	float cov[3][3];
+	for( unsigned int j= 0; j < 3; j++ )
+		for( unsigned int k= 0; k < 3; k++ )
+			cov[j][k]= 0.0f;
+	for( unsigned int i= 0; i < 16; i++ )
+	{
+		float d[3];
+		for( unsigned int j= 0; j < 3; j++ )
+			d[j]= float(block[i][j]) - mean[j];
+		for( unsigned int j= 0; j < 3; j++ )
+			for( unsigned int k= 0; k < 3; k++ )
+				cov[j][k]+= d[j] * d[k];
+	}
+
+	// Power iteration
+	float axis[3]= { 1.0f, 1.0f, 1.0f };
+	for( unsigned int iteration= 0; iteration < 8; iteration++ )
+	{
+		float a[3];
+		for( unsigned int j= 0; j < 3; j++ )
+			a[j]= cov[j][0] * axis[0] + cov[j][1] * axis[1] + cov[j][2] * axis[2];
+		float len2= a[0] * a[0] + a[1] * a[1] + a[2] * a[2];
+		if( len2 < 0.000001f )
+			break;
+		float k= 1.0f / std::sqrt( len2 );
+		for( unsigned int j= 0; j < 3; j++ )
+			axis[j]= a[j] * k;
+	}
+
+	float min_t= 1e30f, max_t= -1e30f;
+	for( unsigned int i= 0; i < 16; i++ )
+	{
+		float t= 0.0f;
+		for( unsigned int j= 0; j < 3; j++ )
+			t+= ( float(block[i][j]) - mean[j] ) * axis[j];
+		if( t < min_t ) min_t= t;
+		if( t > max_t ) max_t= t;
+	}
+
+	float c0_f[3], c1_f[3];
+	for( unsigned int j= 0; j < 3; j++ )
+	{
+		c0_f[j]= mean[j] + axis[j] * max_t;
+		c1_f[j]= mean[j] + axis[j] * min_t;
+	}
+
+	unsigned int c0, c1, indices;
+	unsigned int error= FitColorEndpoints( block, c0_f, c1_f, &c0, &c1, &indices );
+
+	for( unsigned int iteration= 0; iteration < 2 && error > 0 && c0 != c1; iteration++ )
+	{
+		if( !RefineColorEndpoints( block, indices, c0_f, c1_f ) )
+			break;
+
+		unsigned int new_c0, new_c1, new_indices;
+		unsigned int new_error= FitColorEndpoints( block, c0_f, c1_f, &new_c0, &new_c1, &new_indices );
+		if( new_error >= error )
+			break;
+
+		error= new_error;
+		c0= new_c0;
+		c1= new_c1;
+		indices= new_indices;
+	}
+
+	out[0]= (unsigned char)( c0      );
+	out[1]= (unsigned char)( c0 >> 8 );
+	out[2]= (unsigned char)( c1      );
+	out[3]= (unsigned char)( c1 >> 8 );
+	for( unsigned int i= 0; i < 4; i++ )
+		out[ 4 + i ]= (unsigned char)( indices >> ( i * 8 ) );
+}
+
+void mxCompressBC3( const unsigned char* in_data, unsigned char* out_data, unsigned int size_log2 )
+{
+	unsigned int block_count= ( ( 1 << size_log2 ) + 3 ) >> 2;
+	unsigned char block[16][4];
+
+	for( unsigned int y= 0; y < block_count; y++ )
+		for( unsigned int x= 0; x < block_count; x++, out_data+= 16 )
+		{
+			FetchBlock( in_data, size_log2, x, y, block );
+			EncodeAlphaBlock( block, 3, out_data );
+			EncodeColorBlock( block, out_data + 8 );
+		}
+}
+
+void mxCompressBC5( const unsigned char* in_data, unsigned char* out_data, unsigned int size_log2 )
+{
+	unsigned int block_count= ( ( 1 << size_log2 ) + 3 ) >> 2;
+	unsigned char block[16][4];
+
+	for( unsigned int y= 0; y < block_count; y++ )
+		for( unsigned int x= 0; x < block_count; x++, out_data+= 16 )
+		{
+			FetchBlock( in_data, size_log2, x, y, block );
+			EncodeAlphaBlock( block, 0, out_data );
+			EncodeAlphaBlock( block, 1, out_data + 8 );
+		}
+}
+
+void mxCompressMipChain( const unsigned char* in_data, unsigned char* out_data, unsigned int size_log2, mx_TextureCompression compression )
+{
+	// Each mip built from previous mip. Largest mip - quarter of texture.
+	unsigned int mip_data_size= size_log2 > 0 ? ( 1 << ( size_log2 * 2 ) ) : 4;
+	unsigned char* mips[2];
+	mips[0]= new unsigned char[ mip_data_size ];
+	mips[1]= new unsigned char[ mip_data_size ];
+
+	const unsigned char* level_data= in_data;
+	for( unsigned int level= 0; level <= size_log2; level++ )
+	{
+		if( level > 0 )
+		{
+			unsigned char* mip= mips[ level & 1 ];
+			mxBuildMip( level_data, mip, size_log2 - level + 1, compression == TextureCompressionBC5 );
+			level_data= mip;
+		}
+
+		if( compression == TextureCompressionBC3 )
+			mxCompressBC3( level_data, out_data, size_log2 - level );
+		else
+			mxCompressBC5( level_data, out_data, size_log2 - level );
+		out_data+= mxCompressedMipSize( size_log2, level );
+	}
+
+	delete[] mips[0];
+	delete[] mips[1];
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+// All textures are square, RGBA8, with power of two size.
+
+enum mx_TextureCompression
+{
+	TextureCompressionBC3, // rgb + alpha
+	TextureCompressionBC5, // normal map, only r and g channels stored
+};
+
+// Size of one compressed mip level. BC3 and BC5 both use 16 bytes per 4x4 block.
+unsigned int mxCompressedMipSize( unsigned int size_log2, unsigned int level );
+// Size of whole mip chain, down to 1x1.
+unsigned int mxCompressedMipChainSize( unsigned int size_log2 );
+
+// Builds mip level with half size. Filter - windowed sinc, texture wrapped.
+// For normal maps filtered normals are renormalized.
+void mxBuildMip( const unsigned char* in_data, unsigned char* out_data, unsigned int in_size_log2, bool normal_map );
+
+void mxCompressBC3( const unsigned char* in_data, unsigned char* out_data, unsigned int size_log2 );
+void mxCompressBC5( const unsigned char* in_data, unsigned char* out_data, unsigned int size_log2 );
+
+// Builds mip chain and compresses each level. out_data size must be mxCompressedMipChainSize( size_log2 ).
+void mxCompressMipChain( const unsigned char* in_data, unsigned char* out_data, unsigned int size_log2, mx_TextureCompression compression );
\ No newline at end of file
@@ -455,6 +455,21 @@ void mxGenHealthPackTextire( mx_Texture* texture )
 	}
 }
 
+const unsigned int gen_models_textures_versions[LastModelTexture]=
+{
+	1, 1, 1, 1, 1, 1, 1,
+};
+
+const unsigned int gen_level_textures_versions[LastLevelTexture]=
+{
+	1, 1, 1,
+};
+
+const unsigned int gen_level_textures_height_map_versions[LastLevelTexture]=
+{
+	1, 1, 1,
+};
+
 void (* const gen_models_textures_func_table[LastModelTexture])( mx_Texture* texture )=
 {
 	GenOctoRobotTexture,
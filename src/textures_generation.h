@@ -22,6 +22,14 @@ enum ModelTexture
 	LastModelTexture,
 };
 
+// Version of shared texture operations - mx_Texture methods, normal maps, compression. Increase it after their change.
+#define MX_TEXTURES_GENERATION_VERSION 1
+
+// Versions of generators, for textures cache. Increase version after change of generator code or its seeds.
+extern const unsigned int gen_models_textures_versions[LastModelTexture];
+extern const unsigned int gen_level_textures_versions[LastLevelTexture];
+extern const unsigned int gen_level_textures_height_map_versions[LastLevelTexture];
+
 extern void (* const gen_models_textures_func_table[LastModelTexture])( mx_Texture* texture );
 
 extern void (* const gen_level_textures_func_table[LastLevelTexture])( mx_Texture* texture );
@@ -0,0 +1,184 @@
+#include "mx_assert.h"
+
+#include "thread_pool.h"
+
+void mxParallelFor( mx_JobFunc func, void* data, unsigned int job_count )
+{
+	mx_ThreadPool* pool= mx_ThreadPool::Instance();
+	if( pool != NULL )
+		pool->ParallelFor( func, data, job_count );
+	else
+		for( unsigned int i= 0; i < job_count; i++ )
+			func( data, i );
+}
+
+mx_ThreadPool* mx_ThreadPool::instance_= NULL;
+
+void mx_ThreadPool::CreateInstance()
+{
+	MX_ASSERT( instance_ == NULL );
+	instance_= new mx_ThreadPool();
+}
+
+void mx_ThreadPool::DeleteInstance()
+{
+	MX_ASSERT( instance_ );
+	delete instance_;
+	instance_= NULL;
+}
+
+mx_ThreadPool::mx_ThreadPool()
+	: quit_(false)
+	, func_(NULL), data_(NULL)
+	, job_count_(0), next_job_(0), reported_job_count_(0)
+	, done_jobs_(NULL), done_jobs_capacity_(0)
+	, done_jobs_write_pos_(0), done_jobs_read_pos_(0)
+{
+	SYSTEM_INFO system_info;
+	GetSystemInfo( &system_info );
+	thread_count_= system_info.dwNumberOfProcessors;
+	if( thread_count_ < 1 ) thread_count_= 1;
+	else if( thread_count_ > MX_MAX_THREADS ) thread_count_= MX_MAX_THREADS;
+
+	InitializeCriticalSection( &cs_ );
+	start_semaphore_= CreateSemaphore( NULL, 0, 0x7fffffff, NULL );
+	done_semaphore_= CreateSemaphore( NULL, 0, 0x7fffffff, NULL );
+
+	for( unsigned int i= 0; i < thread_count_; i++ )
+		threads_[i]= CreateThread( NULL, 0, ThreadFunc, this, 0, NULL );
+}
+
+mx_ThreadPool::~mx_ThreadPool()
+{
+	EnterCriticalSection( &cs_ );
+	quit_= true;
+	LeaveCriticalSection( &cs_ );
+
+	ReleaseSemaphore( start_semaphore_, thread_count_, NULL );
+	WaitForMultipleObjects( thread_count_, threads_, TRUE, INFINITE );
+
+	for( unsigned int i= 0; i < thread_count_; i++ )
+		CloseHandle( threads_[i] );
+	CloseHandle( start_semaphore_ );
+	CloseHandle( done_semaphore_ );
+	DeleteCriticalSection( &cs_ );
+
+	delete[] done_jobs_;
+}
+
+void mx_ThreadPool::Start( mx_JobFunc func, void* data, unsigned int job_count )
+{
+	bool started= TryStart( func, data, job_count );
+	MX_ASSERT( started );
+	(void)started;
+}
+
+bool mx_ThreadPool::WaitJob( unsigned int* out_job_index )
+{
+	// reported_job_count_ and job_count_ changed only by batch owner thread
+	if( reported_job_count_ == job_count_ )
+		return false;
+
+	WaitForSingleObject( done_semaphore_, INFINITE );
+
+	EnterCriticalSection( &cs_ );
+	*out_job_index= done_jobs_[ done_jobs_read_pos_++ ];
+	reported_job_count_++;
+	LeaveCriticalSection( &cs_ );
+
+	return true;
+}
+
+void mx_ThreadPool::Wait()
+{
+	unsigned int job_index;
+	while( WaitJob( &job_index ) ){}
+}
+
+void mx_ThreadPool::ParallelFor( mx_JobFunc func, void* data, unsigned int job_count )
+{
+	if( !TryStart( func, data, job_count ) )
+	{
+		for( unsigned int i= 0; i < job_count; i++ )
+			func( data, i );
+		return;
+	}
+
+	while( DoJob() ){}
+	Wait();
+}
+
+DWORD WINAPI mx_ThreadPool::ThreadFunc( LPVOID param )
+{
+	mx_ThreadPool* pool= (mx_ThreadPool*) param;
+
+	while(1)
+	{
+		WaitForSingleObject( pool->start_semaphore_, INFINITE );
+
+		EnterCriticalSection( &pool->cs_ );
+		bool quit= pool->quit_;
+		LeaveCriticalSection( &pool->cs_ );
+		if( quit ) break;
+
+		while( pool->DoJob() ){}
+	}
+
+	return 0;
+}
+
+bool mx_ThreadPool::TryStart( mx_JobFunc func, void* data, unsigned int job_count )
+{
+	EnterCriticalSection( &cs_ );
+	if( reported_job_count_ != job_count_ )
+	{
+		// Other batch is active.
+		LeaveCriticalSection( &cs_ );
+		return false;
+	}
+
+	if( job_count > done_jobs_capacity_ )
+	{
+		delete[] done_jobs_;
+		done_jobs_= new unsigned int[ job_count ];
+		done_jobs_capacity_= job_count;
+	}
+
+	func_= func;
+	data_= data;
+	job_count_= job_count;
+	next_job_= 0;
+	reported_job_count_= 0;
+	done_jobs_write_pos_= done_jobs_read_pos_= 0;
+	LeaveCriticalSection( &cs_ );
+
+	// Empty batch is already done. ReleaseSemaphore fails for zero count.
+	if( job_count == 0 )
+		return true;
+
+	ReleaseSemaphore( start_semaphore_, job_count < thread_count_ ? job_count : thread_count_, NULL );
+	return true;
+}
+
+bool mx_ThreadPool::DoJob()
+{
+	EnterCriticalSection( &cs_ );
+	if( next_job_ >= job_count_ )
+	{
+		LeaveCriticalSection( &cs_ );
+		return false;
+	}
+	unsigned int job_index= next_job_++;
+	mx_JobFunc func= func_;
+	void* data= data_;
+	LeaveCriticalSection( &cs_ );
+
+	func( data, job_index );
+
+	EnterCriticalSection( &cs_ );
+	done_jobs_[ done_jobs_write_pos_++ ]= job_index;
+	LeaveCriticalSection( &cs_ );
+
+	ReleaseSemaphore( done_semaphore_, 1, NULL );
+	return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <windows.h>
+
+#define MX_MAX_THREADS 32
+
+// job_index - in range [0; job_count)
+typedef void (*mx_JobFunc)( void* data, unsigned int job_index );
+
+// Runs func for each job index in thread pool, if it exists, or in current thread.
+// Returns after all jobs done.
+void mxParallelFor( mx_JobFunc func, void* data, unsigned int job_count );
+
+class mx_ThreadPool
+{
+public:
+	static void CreateInstance();
+	static mx_ThreadPool* Instance();
+	static void DeleteInstance();
+
+	unsigned int ThreadCount() const;
+
+	// Starts jobs in worker threads and returns immediately.
+	// Only one jobs batch can be active.
+	void Start( mx_JobFunc func, void* data, unsigned int job_count );
+	// Waits for next finished job of current batch.
+	// Returns false, if all jobs of batch already reported.
+	bool WaitJob( unsigned int* out_job_index );
+	void Wait();
+
+	// Calling thread helps workers. If other batch is active ( nested call from job ), runs jobs in calling thread.
+	void ParallelFor( mx_JobFunc func, void* data, unsigned int job_count );
+
+private:
+	mx_ThreadPool();
+	~mx_ThreadPool();
+
+	mx_ThreadPool(const mx_ThreadPool&);
+	mx_ThreadPool& operator=(const mx_ThreadPool&);
+
+	static DWORD WINAPI ThreadFunc( LPVOID param );
+	// Returns false, if other batch is active.
+	bool TryStart( mx_JobFunc func, void* data, unsigned int job_count );
+	// Returns false, if no jobs left.
+	bool DoJob();
+
+private:
+	static mx_ThreadPool* instance_;
+
+	HANDLE threads_[ MX_MAX_THREADS ];
+	unsigned int thread_count_;
+
+	CRITICAL_SECTION cs_;
+	HANDLE start_semaphore_;
+	HANDLE done_semaphore_;
+	bool quit_;
+
+	// Current batch. Guarded by cs_.
+	mx_JobFunc func_;
+	void* data_;
+	unsigned int job_count_;
+	unsigned int next_job_;
+	unsigned int reported_job_count_;
+
+	// Indeces of finished, but not reported jobs.
+	unsigned int* done_jobs_;
+	unsigned int done_jobs_capacity_;
+	unsigned int done_jobs_write_pos_;
+	unsigned int done_jobs_read_pos_;
+};
+
+inline mx_ThreadPool* mx_ThreadPool::Instance()
+{
+	return instance_;
+}
+
+inline unsigned int mx_ThreadPool::ThreadCount() const
+{
+	return thread_count_;
+}